@@ -3,61 +3,225 @@
 #include <ctype.h>
 
 #include "akinator.h"
+#include "guess_matrix.h"
+#include "rebuild.h"
+#include "node_stats.h"
+#include "description_cache.h"
+#include "catalog.h"
+#include "question_index.h"
+#include "nearest.h"
+#include "similarity.h"
+#include "fuzzy_index.h"
+#include "word_index.h"
+#include "prefix_index.h"
+#include "tree_diff.h"
+#include "tree/traversal.h"
 #include "common/errors.h"
 #include "common/colorlib.h"
 #include "common/input_and_output.h"
 #include "stack/stack.h"
+#include "stack/hash.h"
+#include "common/trace.h"
+#include "common/metrics.h"
+#include "common/memory.h"
+
+// is only printed, say would read star as shell syntax
+static const char* const COMPLETION_HINT = "Name with * at the end shows its completions\n";
 
 static AkinatorErrors AskUserAboutNode(Node* node, bool* answer, error_t* error);
-static AkinatorErrors GuessingLastNodeCase(tree_t* tree, Node* node,
-                                            const bool answer, const char* data_file, error_t* error);
-static AkinatorErrors AddNewNode(Node* node, const node_data_t guessed_object,
-                                             const node_data_t difference, error_t* error);
-static AkinatorErrors UpdateAkinatorData(tree_t* tree, Node* node, const char* data_file, error_t* error);
+static AkinatorErrors GuessingLastNodeCase(tree_t* tree, Node* node, ancestors_t* ancestors, DescriptionCache* cache,
+                                            WordIndex* words, PrefixIndex* names, const bool answer,
+                                            const char* data_file, error_t* error);
+static AkinatorErrors AddNewNode(tree_t* tree, Node* node, ancestors_t* ancestors, DescriptionCache* cache,
+                                 WordIndex* words, PrefixIndex* names, const node_data_t guessed_object,
+                                 const node_data_t difference, error_t* error);
+static AkinatorErrors UpdateAkinatorData(tree_t* tree, Node* node, ancestors_t* ancestors, DescriptionCache* cache,
+                                         WordIndex* words, PrefixIndex* names, const char* data_file, error_t* error);
 static AkinatorErrors SaveNewTreeInData(const tree_t* tree, const char* data_file, error_t* error);
 
+static AkinatorErrors AskAdaptiveQuestions(GuessMatrix* matrix, size_t* asked_amt, error_t* error);
+
+static AkinatorErrors SayFoundObjects(const QuestionIndex* index, const ObjectSet* found, error_t* error);
+
+static AkinatorErrors SelectSimilarityObjects(SimilarityObjects* objects, error_t* error);
+
+static AkinatorErrors SayFoundQuestions(const tree_t* tree, const WordIndex* words, const size_t* found,
+                                        const size_t found_amt, error_t* error);
 
-static char*          GetObjectInTree(const tree_t* tree, Stack_t* stk, error_t* error);
-static AkinatorErrors FindObjectInTree(Stack_t* stk, Node* node,
+
+static bool           ReadOtherTree(const char* other_file, tree_t* other, error_t* error);
+static AkinatorErrors SayTreeDiff(const tree_t* tree, const TreeDiff* diff, error_t* error);
+static void           PrintLearnedObjects(const TreeDiffEntry* entry);
+
+static char*          GetObjectName(const PrefixIndex* names, error_t* error);
+static AkinatorErrors SayObjectsText(tree_t* tree, DescriptionCache* cache, FuzzyIndex* fuzzy,
+                                     const char* object_1, const char* object_2, error_t* error);
+static const char*    GetTreeObjectName(const tree_t* tree, FuzzyIndex* fuzzy, const char* object, error_t* error);
+static bool           PrintDescription(FILE* fp, const tree_t* tree, FuzzyIndex* fuzzy,
+                                       const char** object, error_t* error);
+static bool           PrintComparison(FILE* fp, const tree_t* tree, FuzzyIndex* fuzzy,
+                                      const char** object_1, const char** object_2, error_t* error);
+
+static bool           GetObjectInTree(const tree_t* tree, FuzzyIndex* fuzzy, path_t* stk,
+                                      const char** object, error_t* error);
+static bool           GetCloseObjectInTree(const tree_t* tree, FuzzyIndex* fuzzy, path_t* stk,
+                                           const char** object, error_t* error);
+static void           SayCloseObjects(const char* object, const FuzzyMatch* matches, const size_t matches_amt);
+static AkinatorErrors FindObjectInTree(path_t* stk, Node* node,
                                 const char* object, bool* found_flag, error_t* error);
 static AkinatorErrors CompareObjectWithLastNode(Node* node, const char* object,
                                                 bool* found_flag, error_t* error);
-static AkinatorErrors PrintObjectPropertiesBasedOnStack(const Stack_t* stk, const int start_stk_index,
+static AkinatorErrors PrintObjectPropertiesBasedOnStack(FILE* fp, const path_t* stk, const int start_stk_index,
                                                         Node* node, error_t* error);
 
 
-static AkinatorErrors CompareObjectsDescription(const Stack_t* stk_1, const Stack_t* stk_2,
+static AkinatorErrors CompareObjectsDescription(FILE* fp, const path_t* stk_1, const path_t* stk_2,
                                                 const char* object_1, const char* object_2,
                                                 Node* node, error_t* error);
-static AkinatorErrors WriteSimilarProperties(const Stack_t* stk_1, const Stack_t* stk_2,
+static AkinatorErrors WriteSimilarProperties(FILE* fp, const path_t* stk_1, const path_t* stk_2,
                                              int* stk_index, Node** curr_node, error_t* error);
 
+static size_t         AskNearestObjectsAmt();
+static AkinatorErrors SayNearestObjects(const tree_t* tree, FuzzyIndex* fuzzy, const char* object, const size_t k,
+                                        error_t* error);
+
 
 //---------------------------------------------------------------------------------------
 
-AkinatorErrors GuessMode(tree_t* tree, Node* node, const char* data_file, error_t* error)
+AkinatorErrors GuessMode(tree_t* tree, Node* node, DescriptionCache* cache, WordIndex* words, PrefixIndex* names,
+                         const char* data_file, error_t* error)
 {
     assert(tree);
     assert(node);
+    assert(cache);
+    assert(words);
+    assert(names);
     assert(data_file);
     assert(error);
 
     bool answer = false;
 
+    NodeStats stats = {};
+    // prefix place of node for stats, node is root of tree
+    size_t    place = 0;
+
+    NodeStatsCtor(&stats, tree, error);
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+    ancestors_t ancestors = {};
+    ancestors.init();
+
     while (true)
     {
+        TRACE_SPAN("GuessMode step");
+
         AskUserAboutNode(node, &answer, error);
-        RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+        if (error->code != (int) AkinatorErrors::NONE)
+            break;
+
+        NodeStatsAnswer(&stats, place, answer);
 
         if (!node->left || !node->right)
             break;
 
-        node = (answer == true)? node->left : node->right;
+        if (ancestors.push(node) != (int) ERRORS::NONE)
+        {
+            error->code = (int) AkinatorErrors::INVALID_STACK;
+            break;
+        }
+
+        place = NodeStatsChildPlace(node, place, answer);
+        node  = (answer == true)? node->left : node->right;
+    }
+
+    // answers are saved before tree learns new object, so they match nodes of data file
+    if (error->code == (int) AkinatorErrors::NONE)
+        NodeStatsSave(&stats, tree, data_file, error);
+
+    NodeStatsDtor(&stats);
+
+    if (error->code == (int) AkinatorErrors::NONE)
+    {
+        TRACE_SPAN("GuessMode last node");
+
+        GuessingLastNodeCase(tree, node, &ancestors, cache, words, names, answer, data_file, error);
     }
 
-    GuessingLastNodeCase(tree, node, answer, data_file, error);
+    ancestors.destroy();
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors AdaptiveGuessMode(const tree_t* tree, error_t* error)
+{
+    assert(tree);
+    assert(error);
+
+    GuessMatrix matrix = {};
+
+    GuessMatrixCtor(&matrix, tree, error);
     RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
 
+    size_t asked_amt = 0;
+
+    AskAdaptiveQuestions(&matrix, &asked_amt, error);
+
+    PrintLog("ADAPTIVE GUESS: %zu objects, %zu questions, %zu asked<br>\n",
+             matrix.objects_amt, matrix.questions_amt, asked_amt);
+
+    GuessMatrixDtor(&matrix);
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors AskAdaptiveQuestions(GuessMatrix* matrix, size_t* asked_amt, error_t* error)
+{
+    assert(matrix);
+    assert(asked_amt);
+    assert(error);
+
+    bool answer = false;
+
+    while (matrix->candidates_amt > 0)
+    {
+        TRACE_SPAN("AdaptiveGuessMode step");
+
+        GuessQuestion* question = GuessMatrixBestQuestion(matrix);
+
+        if (question != nullptr)
+        {
+            AskUserAboutNode(question->node, &answer, error);
+            RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+            GuessMatrixAnswer(matrix, question, answer);
+            (*asked_amt)++;
+            continue;
+        }
+
+        // questions do not split candidates any more, so they are named one by one
+        size_t object = GuessMatrixFirstObject(matrix);
+
+        AskUserAboutNode(matrix->objects[object], &answer, error);
+        RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+        (*asked_amt)++;
+        MetricAdd(GUESSES);
+
+        if (answer)
+        {
+            SayPhrase("EZ PZ LEMON SQUIZE\n");
+            return AkinatorErrors::NONE;
+        }
+
+        GuessMatrixDropObject(matrix, object);
+    }
+
+    SayPhrase("I give up. Teach me in guess mode\n");
+
     return AkinatorErrors::NONE;
 }
 
@@ -74,8 +238,15 @@ static AkinatorErrors AskUserAboutNode(Node* node, bool* answer, error_t* error)
         SayPhrase("Is it %s?\n", node->data);
 
         char ans[MAX_STRING_LEN] = {};
-        scanf("%s", ans);
-        ClearInput(stdin);
+
+        {
+            METRIC_TIMER(ANSWER_TIME);
+
+            scanf("%s", ans);
+            ClearInput(stdin);
+        }
+
+        MetricAdd(QUESTIONS_ASKED);
 
         if (!strncasecmp(ans, "yes", MAX_STRING_LEN))       { *answer = true;  break; }
         else if (!strncasecmp(ans, "no", MAX_STRING_LEN))   { *answer = false; break; }
@@ -138,12 +309,17 @@ int PrintAkinatorError(FILE* fp, const void* err, const char* func, const char*
 
 //---------------------------------------------------------------------------------------
 
-static AkinatorErrors GuessingLastNodeCase(tree_t* tree, Node* node,
-                                        const bool answer, const char* data_file, error_t* error)
+static AkinatorErrors GuessingLastNodeCase(tree_t* tree, Node* node, ancestors_t* ancestors, DescriptionCache* cache,
+                                        WordIndex* words, PrefixIndex* names, const bool answer,
+                                        const char* data_file, error_t* error)
 {
     assert(tree);
     assert(data_file);
     assert(node);
+    assert(ancestors);
+    assert(cache);
+    assert(words);
+    assert(names);
     assert(error);
 
     if (node->left != nullptr || node->right != nullptr)
@@ -153,6 +329,8 @@ static AkinatorErrors GuessingLastNodeCase(tree_t* tree, Node* node,
         return AkinatorErrors::UNEXPECTED_NODE;
     }
 
+    MetricAdd(GUESSES);
+
     if (answer == true)
     {
         SayPhrase("EZ PZ LEMON SQUIZE\n");
@@ -160,7 +338,7 @@ static AkinatorErrors GuessingLastNodeCase(tree_t* tree, Node* node,
     }
     else
     {
-        UpdateAkinatorData(tree, node, data_file, error);
+        UpdateAkinatorData(tree, node, ancestors, cache, words, names, data_file, error);
         RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
 
         return AkinatorErrors::NONE;
@@ -171,11 +349,16 @@ static AkinatorErrors GuessingLastNodeCase(tree_t* tree, Node* node,
 
 //---------------------------------------------------------------------------------------
 
-static AkinatorErrors UpdateAkinatorData(tree_t* tree, Node* node, const char* data_file, error_t* error)
+static AkinatorErrors UpdateAkinatorData(tree_t* tree, Node* node, ancestors_t* ancestors, DescriptionCache* cache,
+                                         WordIndex* words, PrefixIndex* names, const char* data_file, error_t* error)
 {
     assert(tree);
     assert(data_file);
     assert(node);
+    assert(ancestors);
+    assert(cache);
+    assert(words);
+    assert(names);
     assert(error);
 
     SayPhrase("What did you guess?\n");
@@ -190,9 +373,14 @@ static AkinatorErrors UpdateAkinatorData(tree_t* tree, Node* node, const char* d
     if (error->code != (int) ERRORS::NONE)
         return AkinatorErrors::INVALID_SYNTAX;
 
-    AddNewNode(node, guessed_object, difference, error);
+    AddNewNode(tree, node, ancestors, cache, words, names, guessed_object, difference, error);
     RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
 
+    // cached texts of other objects stay right both for this tree and for saved one
+    DescriptionCacheExpectTree(cache, tree);
+    WordIndexExpectTree(words, tree);
+    PrefixIndexExpectTree(names, tree);
+
     SaveNewTreeInData(tree, data_file, error);
     RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
 
@@ -201,13 +389,23 @@ static AkinatorErrors UpdateAkinatorData(tree_t* tree, Node* node, const char* d
 
 //---------------------------------------------------------------------------------------
 
-static AkinatorErrors AddNewNode(Node* node, const node_data_t guessed_object,
-                                             const node_data_t difference, error_t* error)
+static AkinatorErrors AddNewNode(tree_t* tree, Node* node, ancestors_t* ancestors, DescriptionCache* cache,
+                                 WordIndex* words, PrefixIndex* names, const node_data_t guessed_object,
+                                 const node_data_t difference, error_t* error)
 {
+    assert(tree);
     assert(node);
+    assert(ancestors);
+    assert(cache);
+    assert(words);
+    assert(names);
     assert(guessed_object);
     assert(difference);
 
+    // shared nodes of path are copied, so new object appears only in this place of tree
+    TreeUnsharePath(tree, ancestors->data, ancestors->size, &node, error);
+    if (error->code != (int) TreeErrors::NONE)  { return AkinatorErrors::TREE_ERROR; }
+
     Node* positive_ans_node = NodeCtor(guessed_object, 0, 0, error);
     if (error->code != (int) TreeErrors::NONE)  { return AkinatorErrors::TREE_ERROR; }
 
@@ -218,6 +416,41 @@ static AkinatorErrors AddNewNode(Node* node, const node_data_t guessed_object,
     node->right = negative_ans_node;
     node->left  = positive_ans_node;
 
+    tree->hashed = false;
+
+    // only subtrees on path to new node have changed
+    NodeUpdateStats(node);
+    for (size_t i = ancestors->size; i > 0; i--)
+        NodeUpdateStats(ancestors->data[i - 1]);
+
+    // old object got new question on its path, new one may shadow object with the same name
+    DescriptionCacheInvalidate(cache, positive_ans_node->data);
+    DescriptionCacheInvalidate(cache, negative_ans_node->data);
+
+    // new question is in place of old leaf, steps are restored from ancestors
+    path_t path = {};
+    path.init();
+
+    for (size_t i = 0; i < ancestors->size && error->code == (int) AkinatorErrors::NONE; i++)
+    {
+        const Node* child = (i + 1 < ancestors->size) ? ancestors->data[i + 1] : node;
+
+        if (path.push((ancestors->data[i]->left == child) ? LEFT_STEP : RIGHT_STEP) != (int) ERRORS::NONE)
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    if (error->code == (int) AkinatorErrors::NONE)
+        WordIndexAdd(words, difference, &path, error);
+
+    path.destroy();
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+    // old object keeps its name in the new leaf
+    PrefixIndexInsert(names, guessed_object, error);
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+    MetricAdd(LEARN_EVENTS);
+
     return AkinatorErrors::NONE;
 }
 
@@ -231,6 +464,9 @@ static AkinatorErrors SaveNewTreeInData(const tree_t* tree, const char* data_fil
 
     if (AskUserQuestion("Do you want to save edits in data base?"))
     {
+        TRACE_SPAN("SaveNewTreeInData");
+        METRIC_TIMER(SAVE_TIME);
+
         FILE* fp = fopen(data_file, "w");
         if (!fp)
         {
@@ -239,7 +475,28 @@ static AkinatorErrors SaveNewTreeInData(const tree_t* tree, const char* data_fil
             return AkinatorErrors::DATA_FILE;
         }
 
-        TreePrefixPrint(fp, tree);
+        // tree is printed in memory first, so checksum of snapshot is known
+        char*  text = nullptr;
+        size_t len  = 0;
+
+        FILE* snapshot = open_memstream(&text, &len);
+        if (snapshot != nullptr)
+        {
+            TreePrefixPrint(snapshot, tree);
+            fclose(snapshot);
+
+            fwrite(text, sizeof(char), len, fp);
+
+            PrintLog("DATA SAVED IN \"%s\": %zu bytes, CRC32C %08X<br>\n",
+                     data_file, len, Crc32c(text, len));
+            free(text);
+        }
+        else
+            TreePrefixPrint(fp, tree);
+
+        long written = ftell(fp);
+        if (written > 0)
+            MetricAdd(BYTES_WRITTEN, (unsigned long long) written);
 
         PrintGreenText(stdout, "DATA SUCCESFULLY UPDATED\n", nullptr);
         fclose(fp);
@@ -250,192 +507,1184 @@ static AkinatorErrors SaveNewTreeInData(const tree_t* tree, const char* data_fil
 
 //---------------------------------------------------------------------------------------
 
-AkinatorErrors DescriptionMode(tree_t* tree, error_t* error)
+AkinatorErrors RebuildMode(const tree_t* tree, const char* data_file, error_t* error)
 {
     assert(tree);
+    assert(data_file);
     assert(error);
 
-    Stack_t stk = {};
-    StackCtor(&stk);
+    NodeCounts* counts = nullptr;
 
-    SayPhrase("What do you want to describe?\n", nullptr);
+    NodeStatsLoad(tree, data_file, &counts, error);
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
 
-    char* object = GetObjectInTree(tree, &stk, error);
+    tree_t       rebuilt = {};
+    RebuildStats stats   = {};
+
+    RebuildTree(tree, counts, &rebuilt, &stats, error);
+    MemFree(counts);
     RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
 
-    if (object != nullptr)
-    {
-        SayPhrase("%s - ", object);
-        PrintObjectPropertiesBasedOnStack(&stk, 0, tree->root, error);
-        RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
-    }
+    PrintLog("REBUILD: %zu objects, %zu -> %zu nodes, %.3lf -> %.3lf expected questions, %zu lost<br>\n",
+             stats.objects, stats.old_nodes, stats.new_nodes,
+             stats.old_expected_questions, stats.new_expected_questions, stats.lost);
 
-    StackDtor(&stk);
-    return AkinatorErrors::NONE;
+    PrintCyanText(stdout, "Expected questions: %.3lf -> %.3lf\n"
+                          "Nodes:              %zu -> %zu\n",
+                          stats.old_expected_questions, stats.new_expected_questions,
+                          stats.old_nodes, stats.new_nodes);
+
+    if (stats.lost > 0)
+        PrintRedText(stdout, "%zu objects are reached only by contradictory answers and are dropped\n",
+                             stats.lost);
+
+    // greedy choice is not always better than tree built by people
+    if (stats.new_expected_questions < stats.old_expected_questions)
+        SaveNewTreeInData(&rebuilt, data_file, error);
+    else
+        PrintGreenText(stdout, "Tree is already optimal for known answers\n", nullptr);
+
+    TreeDtor(&rebuilt);
+
+    return (AkinatorErrors) error->code;
 }
 
 //---------------------------------------------------------------------------------------
 
-static AkinatorErrors FindObjectInTree(Stack_t* stk, Node* node,
-                                        const char* object, bool* found_flag, error_t* error)
+AkinatorErrors ExportMode(const tree_t* tree, const char* data_file, error_t* error)
 {
-    assert(stk);
-    assert(node);
-    assert(object);
+    assert(tree);
+    assert(data_file);
     assert(error);
-    assert(found_flag);
 
-    if (node->left == nullptr || node->right == nullptr)
-    {
-        CompareObjectWithLastNode(node, object, found_flag, error);
-        return (AkinatorErrors) error->code;
-    }
+    const CatalogFormat format = AskUserQuestion("Export catalog in JSONL (TSV otherwise)?") ? CATALOG_JSONL
+                                                                                              : CATALOG_TSV;
 
-    if (*found_flag == false)
+    char catalog_file[MAX_STRING_LEN + sizeof(CATALOG_JSONL_EXT)] = {};
+    snprintf(catalog_file, sizeof(catalog_file), "%s%s", data_file,
+             (format == CATALOG_JSONL) ? CATALOG_JSONL_EXT : CATALOG_TSV_EXT);
+
+    FILE* fp = fopen(catalog_file, "w");
+    if (fp == nullptr)
     {
-        StackPush(stk, LEFT_STEP);
-        FindObjectInTree(stk, node->left, object, found_flag, error);
-        if (*found_flag == false)
-            StackPop(stk);
+        error->code = (int) AkinatorErrors::DATA_FILE;
+        error->data = data_file;
+        return AkinatorErrors::DATA_FILE;
     }
 
-    if (*found_flag == false)
+    // catalog is much longer than tree, so it is written by big blocks
+    setvbuf(fp, nullptr, _IOFBF, CATALOG_BUFFER_SIZE);
+
+    size_t objects_amt = 0;
+
     {
-        StackPush(stk, RIGHT_STEP);
-        FindObjectInTree(stk, node->right, object, found_flag, error);
-        if (*found_flag == false)
-            StackPop(stk);
+        METRIC_TIMER(SAVE_TIME);
+        CatalogWrite(fp, tree, format, &objects_amt, error);
     }
 
+    long written = ftell(fp);
+    if (written > 0)
+        MetricAdd(BYTES_WRITTEN, (unsigned long long) written);
+
+    fclose(fp);
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+    PrintLog("CATALOG EXPORTED IN \"%s\": %zu objects, %ld bytes<br>\n", catalog_file, objects_amt, written);
+    PrintGreenText(stdout, "%zu objects exported in \"%s\"\n", objects_amt, catalog_file);
+
     return AkinatorErrors::NONE;
 }
 
 //---------------------------------------------------------------------------------------
 
-static AkinatorErrors CompareObjectWithLastNode(Node* node, const char* object,
-                                                bool* found_flag, error_t* error)
+AkinatorErrors SimilarityMode(const tree_t* tree, const char* data_file, error_t* error)
 {
-    if (node->left != nullptr || node->right != nullptr)
+    assert(tree);
+    assert(data_file);
+    assert(error);
+
+    SimilarityObjects objects = {};
+
+    SimilarityObjectsCtor(&objects, tree, error);
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+    if (!AskUserQuestion("Export similarity of all objects?"))
     {
-        error->code = (int) AkinatorErrors::UNEXPECTED_NODE;
-        error->data = node;
-        return AkinatorErrors::UNEXPECTED_NODE;
+        SelectSimilarityObjects(&objects, error);
+
+        if (error->code != (int) AkinatorErrors::NONE || objects.objects == nullptr)
+        {
+            SimilarityObjectsDtor(&objects);
+            return (AkinatorErrors) error->code;
+        }
     }
 
-    if (!strncasecmp(object, node->data, MAX_STRING_LEN))
-        *found_flag = true;
+    char matrix_file[MAX_STRING_LEN + sizeof(SIMILARITY_FILE_EXT)] = {};
+    snprintf(matrix_file, sizeof(matrix_file), "%s%s", data_file, SIMILARITY_FILE_EXT);
+
+    FILE* fp = fopen(matrix_file, "wb");
+    if (fp == nullptr)
+    {
+        SimilarityObjectsDtor(&objects);
+
+        error->code = (int) AkinatorErrors::DATA_FILE;
+        error->data = data_file;
+        return AkinatorErrors::DATA_FILE;
+    }
+
+    setvbuf(fp, nullptr, _IOFBF, SIMILARITY_BUFFER_SIZE);
+
+    {
+        METRIC_TIMER(SAVE_TIME);
+        SimilarityWrite(fp, &objects, error);
+    }
+
+    long written = ftell(fp);
+    if (written > 0)
+        MetricAdd(BYTES_WRITTEN, (unsigned long long) written);
+
+    fclose(fp);
+
+    const size_t objects_amt = objects.objects_amt;
+    SimilarityObjectsDtor(&objects);
+
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+    PrintLog("SIMILARITY EXPORTED IN \"%s\": %zu objects, %ld bytes<br>\n", matrix_file, objects_amt, written);
+    PrintGreenText(stdout, "%zu x %zu similarity matrix exported in \"%s\"\n", objects_amt, objects_amt, matrix_file);
 
     return AkinatorErrors::NONE;
 }
 
 //---------------------------------------------------------------------------------------
 
-static AkinatorErrors PrintObjectPropertiesBasedOnStack(const Stack_t* stk, const int start_stk_index,
-                                                        Node* node, error_t* error)
+// objects are dropped (objects->objects is nullptr), if user names unknown object
+static AkinatorErrors SelectSimilarityObjects(SimilarityObjects* objects, error_t* error)
 {
-    assert(node);
-    assert(stk);
+    assert(objects);
+    assert(error);
 
-    Node* current_node = node;
+    SayPhrase("Input objects one in a line, empty line ends them\n");
 
-    for (size_t i = start_stk_index; i < stk->size; i++)
+    Stack<char*> names;
+    names.init();
+
+    while (true)
     {
-        elem_t step = stk->data[i];
+        char* name = GetDataFromLine(stdin, error);
+        if (error->code != (int) ERRORS::NONE)
+        {
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            break;
+        }
 
-        if (current_node == nullptr && (step == RIGHT_STEP || step == LEFT_STEP))
+        if (*name == '\0' || names.push(name) != (int) ERRORS::NONE)
         {
-            error->code = (int) AkinatorErrors::UNEXPECTED_NODE;
-            return AkinatorErrors::UNEXPECTED_NODE;
+            MemFree(name);
+            break;
         }
+    }
 
-        if (step == RIGHT_STEP)
+    if (error->code == (int) AkinatorErrors::NONE)
+    {
+        const char* unknown = SimilarityObjectsSelect(objects, names.data, names.size, error);
+
+        if (unknown != nullptr)
         {
-            SayPhrase("not %s, ", current_node->data);
-            current_node = current_node->right;
+            PrintRedText(stdout, "Can't find \"%s\" in tree\n", unknown);
+            SimilarityObjectsDtor(objects);
         }
-        else if (step == LEFT_STEP)
+    }
+
+    for (size_t i = 0; i < names.size; i++)
+        MemFree(names.data[i]);
+
+    names.destroy();
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors SetQueryMode(tree_t* tree, QuestionIndex* questions, error_t* error)
+{
+    assert(tree);
+    assert(questions);
+    assert(error);
+
+    SayPhrase("Which objects do you want to find?\n");
+    // example is only printed, say would read quotes as shell syntax
+    PrintCyanText(stdout, "%s", "Like: \"hockey player\" and not \"from Krasnodar\" or sniper\n");
+
+    char* query = GetDataFromLine(stdin, error);
+    if (error->code != (int) ERRORS::NONE)
+    {
+        error->code = (int) AkinatorErrors::INVALID_SYNTAX;
+        return AkinatorErrors::INVALID_SYNTAX;
+    }
+
+    ObjectSet  found       = {};
+    QueryError query_error = {};
+
+    QuestionIndexQuery(questions, tree, query, &found, &query_error, error);
+
+    if (error->code == (int) AkinatorErrors::NONE)
+    {
+        switch (query_error.code)
         {
-            SayPhrase("%s, ", current_node->data);
-            current_node = current_node->left;
+            case QUERY_SYNTAX:
+                PrintRedText(stdout, "Can't understand query near \"%.*s\"\n", (int) query_error.len, query_error.text);
+                break;
+
+            case QUERY_UNKNOWN_PROPERTY:
+                PrintRedText(stdout, "Can't find property \"%.*s\" in tree\n", (int) query_error.len, query_error.text);
+                break;
+
+            case QUERY_NONE:
+            default:
+                SayFoundObjects(questions, &found, error);
+                PrintLog("SET QUERY \"%s\": %zu objects<br>\n", query, ObjectSetCount(&found));
+                break;
         }
-        else
+    }
+
+    ObjectSetDtor(&found);
+    MemFree(query);
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors SayFoundObjects(const QuestionIndex* index, const ObjectSet* found, error_t* error)
+{
+    assert(index);
+    assert(found);
+    assert(error);
+
+    const size_t found_amt = ObjectSetCount(found);
+
+    if (found_amt == 0)
+    {
+        SayPhrase("I don't know such objects\n");
+        return AkinatorErrors::NONE;
+    }
+
+    char*  text = nullptr;
+    size_t len  = 0;
+
+    FILE* fp = open_memstream(&text, &len);
+    if (fp == nullptr)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    fprintf(fp, "I know %zu such objects: ", found_amt);
+
+    const size_t named_amt = (found_amt < MAX_FOUND_OBJECTS_NAMED) ? found_amt : MAX_FOUND_OBJECTS_NAMED;
+    size_t       said_amt  = 0;
+
+    for (size_t i = 0; i < found->runs_amt && said_amt < named_amt; i++)
+    {
+        for (size_t object = found->runs[i].begin; object < found->runs[i].end && said_amt < named_amt; object++)
         {
-            error->code = (int) AkinatorErrors::INVALID_STACK;
-            return AkinatorErrors::INVALID_STACK;
+            fprintf(fp, (said_amt == 0) ? "%s" : ", %s", index->names[object]);
+            said_amt++;
         }
     }
-    putchar('\n');
+
+    if (found_amt > named_amt)
+        fprintf(fp, " and %zu more", found_amt - named_amt);
+
+    fputs("\n", fp);
+    fclose(fp);
+
+    SayText(text);
+    free(text);
 
     return AkinatorErrors::NONE;
 }
 
 //---------------------------------------------------------------------------------------
 
-static char* GetObjectInTree(const tree_t* tree, Stack_t* stk, error_t* error)
+AkinatorErrors WordSearchMode(const tree_t* tree, const WordIndex* words, error_t* error)
 {
-    assert(error);
-    assert(stk);
     assert(tree);
+    assert(words);
+    assert(error);
 
-    char* object = GetDataFromLine(stdin, error);
+    SayPhrase("Which words do you want to find in questions?\n");
+
+    char* query = GetDataFromLine(stdin, error);
     if (error->code != (int) ERRORS::NONE)
     {
         error->code = (int) AkinatorErrors::INVALID_SYNTAX;
-        return nullptr;
+        return AkinatorErrors::INVALID_SYNTAX;
     }
 
-    bool found_flag_1 = false;
-    FindObjectInTree(stk, tree->root, object, &found_flag_1, error);
+    size_t* found     = nullptr;
+    size_t  found_amt = 0;
+
+    WordIndexSearch(words, query, &found, &found_amt, error);
 
-    if (found_flag_1 == false)
+    if (error->code == (int) AkinatorErrors::NONE)
     {
-        PrintRedText(stdout, "Can't find \"%s\" in tree\n", object);
-        free(object);
-        return nullptr;
+        SayFoundQuestions(tree, words, found, found_amt, error);
+        PrintLog("WORD SEARCH \"%s\": %zu questions<br>\n", query, found_amt);
     }
 
-    return object;
+    MemFree(found);
+    MemFree(query);
+
+    return (AkinatorErrors) error->code;
 }
 
 //---------------------------------------------------------------------------------------
 
-AkinatorErrors CompareMode(tree_t* tree, error_t* error)
+// every question is printed with answers, that lead to it
+static AkinatorErrors SayFoundQuestions(const tree_t* tree, const WordIndex* words, const size_t* found,
+                                        const size_t found_amt, error_t* error)
 {
     assert(tree);
+    assert(words);
     assert(error);
 
-    Stack_t stk_1 = {};
-    Stack_t stk_2 = {};
-    StackCtor(&stk_1);
-    StackCtor(&stk_2);
-
-    SayPhrase("Input first object\n");
+    if (found_amt == 0)
+    {
+        SayPhrase("No questions have these words\n");
+        return AkinatorErrors::NONE;
+    }
 
-    char* object_1 = GetObjectInTree(tree, &stk_1, error);
-    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+    SayPhrase("I know %zu such questions\n", found_amt);
 
-    SayPhrase("Input second object\n");
+    const size_t named_amt = (found_amt < MAX_FOUND_QUESTIONS_NAMED) ? found_amt : MAX_FOUND_QUESTIONS_NAMED;
 
-    char* object_2 = GetObjectInTree(tree, &stk_2, error);
-    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+    path_t path = {};
+    path.init();
 
-    if (object_1 != nullptr && object_2 != nullptr)
+    for (size_t i = 0; i < named_amt && error->code == (int) AkinatorErrors::NONE; i++)
     {
-        CompareObjectsDescription(&stk_1, &stk_2, object_1, object_2, tree->root, error);
-        RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
-    }
+        const WordQuestion* question = &words->questions[found[i]];
 
-    StackDtor(&stk_1);
-    StackDtor(&stk_2);
-    return AkinatorErrors::NONE;
+        PrintCyanText(stdout, "%s: ", question->text);
+
+        if (question->depth == 0)
+        {
+            printf("first question\n");
+            continue;
+        }
+
+        while (path.size > 0)
+            path.pop();
+
+        for (size_t j = 0; j < question->depth && error->code == (int) AkinatorErrors::NONE; j++)
+            if (path.push(question->path[j]) != (int) ERRORS::NONE)
+                error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+
+        if (error->code == (int) AkinatorErrors::NONE)
+            PrintObjectPropertiesBasedOnStack(stdout, &path, 0, tree->root, error);
+    }
+
+    path.destroy();
+
+    if (found_amt > named_amt && error->code == (int) AkinatorErrors::NONE)
+        printf("and %zu more\n", found_amt - named_amt);
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors DiffMode(tree_t* tree, error_t* error)
+{
+    assert(tree);
+    assert(error);
+
+    SayPhrase("Which data file do you want to compare with?\n");
+
+    char* other_file = GetDataFromLine(stdin, error);
+    if (error->code != (int) ERRORS::NONE)
+    {
+        error->code = (int) AkinatorErrors::INVALID_SYNTAX;
+        return AkinatorErrors::INVALID_SYNTAX;
+    }
+
+    tree_t other = {};
+
+    if (!ReadOtherTree(other_file, &other, error))
+    {
+        MemFree(other_file);
+        return (AkinatorErrors) error->code;
+    }
+
+    TreeDiff diff = {};
+
+    TreeDiffFind(tree, &other, &diff, error);
+
+    if (error->code == (int) AkinatorErrors::NONE)
+    {
+        SayTreeDiff(tree, &diff, error);
+
+        PrintLog("TREE DIFF WITH \"%s\": %zu changes, %zu learned objects, %zu pairs of nodes compared<br>\n",
+                 other_file, diff.entries_amt, diff.learned_objects, diff.visited_pairs);
+    }
+
+    TreeDiffDtor(&diff);
+    TreeDtor(&other);
+    MemFree(other_file);
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+// file is named by user, so bad file is only reported
+static bool ReadOtherTree(const char* other_file, tree_t* other, error_t* error)
+{
+    assert(other_file);
+    assert(other);
+    assert(error);
+
+    FILE* fp = OpenInputFile(other_file, error);
+    if (fp == nullptr)
+    {
+        *error = {};
+        PrintRedText(stdout, "Can't open \"%s\"\n", other_file);
+        return false;
+    }
+
+    TreePrefixRead(fp, other, error);
+    fclose(fp);
+
+    if (error->code != (int) TreeErrors::NONE)
+    {
+        TreeDtor(other);
+
+        *error = {};
+        PrintRedText(stdout, "\"%s\" is not a valid data file\n", other_file);
+        return false;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+// every change is printed with answers, that lead to it in this tree
+static AkinatorErrors SayTreeDiff(const tree_t* tree, const TreeDiff* diff, error_t* error)
+{
+    assert(tree);
+    assert(diff);
+    assert(error);
+
+    if (diff->entries_amt == 0)
+    {
+        SayPhrase("Trees are the same\n");
+        return AkinatorErrors::NONE;
+    }
+
+    path_t path = {};
+    path.init();
+
+    size_t expansions_amt = 0;
+
+    for (size_t i = 0; i < diff->entries_amt && error->code == (int) AkinatorErrors::NONE; i++)
+    {
+        const TreeDiffEntry* entry = &diff->entries[i];
+
+        if (entry->kind == DIFF_EXPANSION)
+        {
+            expansions_amt++;
+            PrintLearnedObjects(entry);
+        }
+        else
+            PrintRedText(stdout, "\"%s\" became \"%s\" (%zu -> %zu objects)\n",
+                                 (entry->old_node != nullptr) ? entry->old_node->data : "nil",
+                                 (entry->new_node != nullptr) ? entry->new_node->data : "nil",
+                                 (entry->old_node != nullptr) ? entry->old_node->subtree.leaves : 0,
+                                 (entry->new_node != nullptr) ? entry->new_node->subtree.leaves : 0);
+
+        printf("    ");
+
+        if (entry->depth == 0)
+        {
+            printf("whole tree\n");
+            continue;
+        }
+
+        while (path.size > 0)
+            path.pop();
+
+        for (size_t j = 0; j < entry->depth && error->code == (int) AkinatorErrors::NONE; j++)
+            if (path.push(entry->path[j]) != (int) ERRORS::NONE)
+                error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+
+        if (error->code == (int) AkinatorErrors::NONE)
+            PrintObjectPropertiesBasedOnStack(stdout, &path, 0, tree->root, error);
+    }
+
+    path.destroy();
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+    SayPhrase("%zu new objects in %zu expanded leaves\n", diff->learned_objects, expansions_amt);
+
+    if (expansions_amt < diff->entries_amt)
+        SayPhrase("%zu changes are not new objects\n", diff->entries_amt - expansions_amt);
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct LearnedObjectsVisitor : TreeVisitor<const Node>
+{
+    const char* old_object = nullptr;
+    size_t      named_amt  = 0;
+
+    TraverseAction pre(const Node* node, const TraversePos*)
+    {
+        if (node->left != nullptr || node->right != nullptr)
+            return TRAVERSE_CONTINUE;
+
+        // old object is skipped once, other leaf with its name is learned again
+        if (old_object != nullptr && strcmp(node->data, old_object) == 0)
+        {
+            old_object = nullptr;
+            return TRAVERSE_CONTINUE;
+        }
+
+        if (named_amt == MAX_DIFF_OBJECTS_NAMED)
+            return TRAVERSE_STOP;
+
+        printf((named_amt == 0) ? "%s" : ", %s", node->data);
+        named_amt++;
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+static void PrintLearnedObjects(const TreeDiffEntry* entry)
+{
+    assert(entry);
+    assert(entry->old_node);
+    assert(entry->new_node);
+
+    const size_t learned_amt = entry->new_node->subtree.leaves - 1;
+
+    PrintCyanText(stdout, "%s: ", entry->old_node->data);
+    printf("%zu new objects: ", learned_amt);
+
+    LearnedObjectsVisitor visitor = {};
+    visitor.old_object = entry->old_node->data;
+
+    TraverseNodes(entry->new_node, &visitor);
+
+    if (learned_amt > visitor.named_amt)
+        printf(" and %zu more", learned_amt - visitor.named_amt);
+
+    printf("\n");
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors DescriptionMode(tree_t* tree, DescriptionCache* cache, FuzzyIndex* fuzzy, const PrefixIndex* names,
+                               error_t* error)
+{
+    assert(tree);
+    assert(cache);
+    assert(fuzzy);
+    assert(names);
+    assert(error);
+
+    SayPhrase("What do you want to describe?\n", nullptr);
+    PrintCyanText(stdout, "%s", COMPLETION_HINT);
+
+    MetricAdd(DESCRIBE_LOOKUPS);
+
+    char* object = GetObjectName(names, error);
+    if (error->code != (int) ERRORS::NONE)
+    {
+        error->code = (int) AkinatorErrors::INVALID_SYNTAX;
+        return AkinatorErrors::INVALID_SYNTAX;
+    }
+
+    SayObjectsText(tree, cache, fuzzy, object, nullptr, error);
+
+    MemFree(object);
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+// name with '*' at the end is prefix: the only completion is taken, several ones are listed and
+// name is asked again. Result is freed by MemFree
+static char* GetObjectName(const PrefixIndex* names, error_t* error)
+{
+    assert(names);
+    assert(error);
+
+    while (true)
+    {
+        char* name = GetDataFromLine(stdin, error);
+        if (error->code != (int) ERRORS::NONE)
+            return nullptr;
+
+        const size_t len = strlen(name);
+
+        if (len == 0 || name[len - 1] != '*')
+            return name;
+
+        name[len - 1] = '\0';
+
+        size_t first = 0;
+        size_t amt   = 0;
+
+        PrefixIndexComplete(names, name, &first, &amt);
+
+        if (amt == 1)
+        {
+            const char* completion = names->entries[first].name;
+            const size_t size      = strlen(completion) + 1;
+
+            // line has place only for MAX_STRING_LEN bytes
+            memcpy(name, completion, (size < MAX_STRING_LEN) ? size : MAX_STRING_LEN);
+            name[MAX_STRING_LEN - 1] = '\0';
+
+            PrintYellowText(stdout, "\"%s\" is taken\n", name);
+            return name;
+        }
+
+        if (amt == 0)
+        {
+            PrintRedText(stdout, "No objects start with \"%s\", input name again\n", name);
+        }
+        else
+        {
+            const size_t named_amt = (amt < MAX_COMPLETIONS_NAMED) ? amt : MAX_COMPLETIONS_NAMED;
+
+            for (size_t i = first; i < first + named_amt; i++)
+                PrintCyanText(stdout, "%s\n", names->entries[i].name);
+
+            if (amt > named_amt)
+                PrintCyanText(stdout, "and %zu more\n", amt - named_amt);
+
+            PrintYellowText(stdout, "%s", "Input name again\n");
+        }
+
+        MemFree(name);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors SayObjectsText(tree_t* tree, DescriptionCache* cache, FuzzyIndex* fuzzy,
+                                     const char* object_1, const char* object_2, error_t* error)
+{
+    assert(tree);
+    assert(cache);
+    assert(fuzzy);
+    assert(object_1);
+    assert(error);
+
+    // entries are kept under names from tree, so typo or other case of letters finds the same entry
+    object_1 = GetTreeObjectName(tree, fuzzy, object_1, error);
+    if (object_2 != nullptr && error->code == (int) AkinatorErrors::NONE)
+        object_2 = GetTreeObjectName(tree, fuzzy, object_2, error);
+
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+    const char* cached_text = DescriptionCacheFind(cache, object_1, object_2);
+    if (cached_text != nullptr)
+    {
+        SayText(cached_text);
+        return AkinatorErrors::NONE;
+    }
+
+    char*  text = nullptr;
+    size_t len  = 0;
+
+    FILE* fp = open_memstream(&text, &len);
+    if (fp == nullptr)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    // lookup can still replace names, text is cached for the ones it found
+    const char* found_1 = object_1;
+    const char* found_2 = object_2;
+
+    bool found = (object_2 == nullptr) ? PrintDescription(fp, tree, fuzzy, &found_1, error)
+                                       : PrintComparison(fp, tree, fuzzy, &found_1, &found_2, error);
+    fclose(fp);
+
+    if (found && error->code == (int) AkinatorErrors::NONE)
+    {
+        SayText(text);
+        DescriptionCacheAdd(cache, found_1, found_2, text);
+    }
+
+    free(text);
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+// the closest name from fuzzy index (same name if it is in tree), or object itself if nothing is close
+static const char* GetTreeObjectName(const tree_t* tree, FuzzyIndex* fuzzy, const char* object, error_t* error)
+{
+    assert(tree);
+    assert(fuzzy);
+    assert(object);
+    assert(error);
+
+    FuzzyMatch matches[FUZZY_MATCHES_MAX] = {};
+    size_t     matches_amt                = 0;
+
+    {
+        METRIC_TIMER(LOOKUP_TIME);
+        FuzzyIndexFind(fuzzy, tree, object, matches, &matches_amt, error);
+    }
+
+    if (error->code != (int) AkinatorErrors::NONE || matches_amt == 0)
+        return object;
+
+    if (matches[0].distance > 0)
+        SayCloseObjects(object, matches, matches_amt);
+
+    return matches[0].name;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool PrintDescription(FILE* fp, const tree_t* tree, FuzzyIndex* fuzzy,
+                             const char** object, error_t* error)
+{
+    assert(fp);
+    assert(tree);
+    assert(object);
+    assert(*object);
+    assert(error);
+
+    path_t stk = {};
+    stk.init();
+
+    bool found = GetObjectInTree(tree, fuzzy, &stk, object, error);
+
+    if (found)
+    {
+        fprintf(fp, "%s - ", *object);
+        PrintObjectPropertiesBasedOnStack(fp, &stk, 0, tree->root, error);
+    }
+
+    stk.destroy();
+
+    return found;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool PrintComparison(FILE* fp, const tree_t* tree, FuzzyIndex* fuzzy,
+                            const char** object_1, const char** object_2, error_t* error)
+{
+    assert(fp);
+    assert(tree);
+    assert(object_1);
+    assert(*object_1);
+    assert(object_2);
+    assert(*object_2);
+    assert(error);
+
+    path_t stk_1 = {};
+    path_t stk_2 = {};
+    stk_1.init();
+    stk_2.init();
+
+    bool found_1 = GetObjectInTree(tree, fuzzy, &stk_1, object_1, error);
+    bool found_2 = error->code == (int) AkinatorErrors::NONE && GetObjectInTree(tree, fuzzy, &stk_2, object_2, error);
+
+    if (found_1 && found_2)
+        CompareObjectsDescription(fp, &stk_1, &stk_2, *object_1, *object_2, tree->root, error);
+
+    stk_1.destroy();
+    stk_2.destroy();
+
+    return found_1 && found_2;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct FindObjectVisitor : TreeVisitor<Node>
+{
+    path_t*     stk        = nullptr;
+    const char* object     = nullptr;
+    bool*       found_flag = nullptr;
+    error_t*    error      = nullptr;
+
+    TraverseAction pre(Node* node, const TraversePos* pos)
+    {
+        // path keeps only steps to parent of this node, rest was left by visited subtrees
+        while (stk->size + 1 > pos->depth && stk->size > 0)
+            stk->pop();
+
+        if (pos->depth > 0 && stk->push(pos->is_left ? LEFT_STEP : RIGHT_STEP) != (int) ERRORS::NONE)
+        {
+            error->code = (int) AkinatorErrors::INVALID_STACK;
+            return TRAVERSE_STOP;
+        }
+
+        if (node->left == nullptr || node->right == nullptr)
+        {
+            CompareObjectWithLastNode(node, object, found_flag, error);
+
+            if (*found_flag || error->code != (int) AkinatorErrors::NONE)
+                return TRAVERSE_STOP;
+
+            return TRAVERSE_SKIP;
+        }
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors FindObjectInTree(path_t* stk, Node* node,
+                                        const char* object, bool* found_flag, error_t* error)
+{
+    assert(stk);
+    assert(node);
+    assert(object);
+    assert(error);
+    assert(found_flag);
+
+    FindObjectVisitor visitor = {};
+    visitor.stk        = stk;
+    visitor.object     = object;
+    visitor.found_flag = found_flag;
+    visitor.error      = error;
+
+    if (TraverseNodes(node, &visitor) != TreeErrors::NONE)
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+
+    if (*found_flag == false)
+        while (stk->size > 0)
+            stk->pop();
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors CompareObjectWithLastNode(Node* node, const char* object,
+                                                bool* found_flag, error_t* error)
+{
+    if (node->left != nullptr || node->right != nullptr)
+    {
+        error->code = (int) AkinatorErrors::UNEXPECTED_NODE;
+        error->data = node;
+        return AkinatorErrors::UNEXPECTED_NODE;
+    }
+
+    if (!strncasecmp(object, node->data, MAX_STRING_LEN))
+        *found_flag = true;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors PrintObjectPropertiesBasedOnStack(FILE* fp, const path_t* stk, const int start_stk_index,
+                                                        Node* node, error_t* error)
+{
+    assert(fp);
+    assert(node);
+    assert(stk);
+
+    Node* current_node = node;
+
+    for (size_t i = start_stk_index; i < stk->size; i++)
+    {
+        step_t step = stk->data[i];
+
+        if (current_node == nullptr && (step == RIGHT_STEP || step == LEFT_STEP))
+        {
+            error->code = (int) AkinatorErrors::UNEXPECTED_NODE;
+            return AkinatorErrors::UNEXPECTED_NODE;
+        }
+
+        if (step == RIGHT_STEP)
+        {
+            fprintf(fp, "not %s, ", current_node->data);
+            current_node = current_node->right;
+        }
+        else if (step == LEFT_STEP)
+        {
+            fprintf(fp, "%s, ", current_node->data);
+            current_node = current_node->left;
+        }
+        else
+        {
+            error->code = (int) AkinatorErrors::INVALID_STACK;
+            return AkinatorErrors::INVALID_STACK;
+        }
+    }
+    fputc('\n', fp);
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+// object is replaced by name from tree, if it is found with typos
+static bool GetObjectInTree(const tree_t* tree, FuzzyIndex* fuzzy, path_t* stk,
+                            const char** object, error_t* error)
+{
+    assert(error);
+    assert(stk);
+    assert(object);
+    assert(*object);
+    assert(tree);
+
+    bool found_flag_1 = false;
+
+    {
+        TRACE_SPAN("FindObjectInTree");
+        METRIC_TIMER(LOOKUP_TIME);
+        FindObjectInTree(stk, tree->root, *object, &found_flag_1, error);
+    }
+
+    if (found_flag_1 == false && error->code == (int) AkinatorErrors::NONE)
+        found_flag_1 = GetCloseObjectInTree(tree, fuzzy, stk, object, error);
+
+    return found_flag_1;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool GetCloseObjectInTree(const tree_t* tree, FuzzyIndex* fuzzy, path_t* stk,
+                                 const char** object, error_t* error)
+{
+    assert(tree);
+    assert(fuzzy);
+    assert(stk);
+    assert(object);
+    assert(error);
+
+    FuzzyMatch matches[FUZZY_MATCHES_MAX] = {};
+    size_t     matches_amt                = 0;
+
+    {
+        METRIC_TIMER(LOOKUP_TIME);
+        FuzzyIndexFind(fuzzy, tree, *object, matches, &matches_amt, error);
+    }
+
+    if (error->code != (int) AkinatorErrors::NONE)
+        return false;
+
+    if (matches_amt == 0)
+    {
+        PrintRedText(stdout, "Can't find \"%s\" in tree\n", *object);
+        return false;
+    }
+
+    SayCloseObjects(*object, matches, matches_amt);
+
+    GetPathToObject(tree, matches[0].object, stk, error);
+
+    *object = matches[0].name;
+
+    return error->code == (int) AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void SayCloseObjects(const char* object, const FuzzyMatch* matches, const size_t matches_amt)
+{
+    assert(object);
+    assert(matches);
+    assert(matches_amt > 0);
+
+    PrintYellowText(stdout, "Can't find \"%s\", so \"%s\" is taken\n", object, matches[0].name);
+
+    for (size_t i = 1; i < matches_amt; i++)
+        PrintYellowText(stdout, "Also close: \"%s\"\n", matches[i].name);
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors CompareMode(tree_t* tree, DescriptionCache* cache, FuzzyIndex* fuzzy, const PrefixIndex* names,
+                           error_t* error)
+{
+    assert(tree);
+    assert(cache);
+    assert(fuzzy);
+    assert(names);
+    assert(error);
+
+    SayPhrase("Input first object\n");
+    PrintCyanText(stdout, "%s", COMPLETION_HINT);
+
+    MetricAdd(COMPARE_LOOKUPS, 2);
+
+    char* object_1 = GetObjectName(names, error);
+    if (error->code != (int) ERRORS::NONE)
+    {
+        error->code = (int) AkinatorErrors::INVALID_SYNTAX;
+        return AkinatorErrors::INVALID_SYNTAX;
+    }
+
+    SayPhrase("Input second object\n");
+
+    char* object_2 = GetObjectName(names, error);
+    if (error->code != (int) ERRORS::NONE)
+    {
+        MemFree(object_1);
+        error->code = (int) AkinatorErrors::INVALID_SYNTAX;
+        return AkinatorErrors::INVALID_SYNTAX;
+    }
+
+    SayObjectsText(tree, cache, fuzzy, object_1, object_2, error);
+
+    MemFree(object_1);
+    MemFree(object_2);
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors NearestMode(const tree_t* tree, FuzzyIndex* fuzzy, const PrefixIndex* names, error_t* error)
+{
+    assert(tree);
+    assert(fuzzy);
+    assert(names);
+    assert(error);
+
+    SayPhrase("What object do you want to find neighbours of?\n");
+    PrintCyanText(stdout, "%s", COMPLETION_HINT);
+
+    MetricAdd(NEAREST_LOOKUPS);
+
+    char* object = GetObjectName(names, error);
+    if (error->code != (int) ERRORS::NONE)
+    {
+        error->code = (int) AkinatorErrors::INVALID_SYNTAX;
+        return AkinatorErrors::INVALID_SYNTAX;
+    }
+
+    const size_t k = AskNearestObjectsAmt();
+
+    if (k > 0)
+        SayNearestObjects(tree, fuzzy, object, k, error);
+
+    MemFree(object);
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+// 0 if amount is wrong, default amount for empty line
+static size_t AskNearestObjectsAmt()
+{
+    SayPhrase("How many neighbours do you want to see? Empty line means %zu\n", NEAREST_OBJECTS_DEFAULT_AMT);
+
+    char   line[MAX_STRING_LEN] = {};
+    size_t k                    = NEAREST_OBJECTS_DEFAULT_AMT;
+    char   extra                = 0;
+
+    if (fgets(line, sizeof(line), stdin) == nullptr)
+        return 0;
+
+    line[strcspn(line, "\n")] = '\0';
+
+    // amount is limited by tree anyway, so too big one is not a mistake
+    if (sscanf(line, " %c", &extra) == 1 && (sscanf(line, "%zu %c", &k, &extra) != 1 || k == 0))
+    {
+        PrintRedText(stdout, "Wrong amount of neighbours \"%s\"\n", line);
+        return 0;
+    }
+
+    return k;
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors SayNearestObjects(const tree_t* tree, FuzzyIndex* fuzzy, const char* object, const size_t k,
+                                        error_t* error)
+{
+    assert(tree);
+    assert(fuzzy);
+    assert(object);
+    assert(error);
+
+    if (tree->root == nullptr)
+        return AkinatorErrors::NONE;
+
+    path_t stk = {};
+    stk.init();
+
+    // name from tree, if object is typed with typos
+    const char* found = object;
+
+    if (!GetObjectInTree(tree, fuzzy, &stk, &found, error))
+    {
+        stk.destroy();
+        return (AkinatorErrors) error->code;
+    }
+
+    // other objects are fewer than k for small trees
+    const size_t   max_amt     = (k < tree->root->subtree.leaves) ? k : tree->root->subtree.leaves;
+    size_t         nearest_amt = 0;
+    NearestObject* nearest     = (NearestObject*) MemCalloc(MEM_INDEXES, max_amt + 1, sizeof(NearestObject));
+
+    char*  text = nullptr;
+    size_t len  = 0;
+    FILE*  fp   = nullptr;
+
+    if (nearest == nullptr || (fp = open_memstream(&text, &len)) == nullptr)
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+    else
+        FindNearestObjects(tree, &stk, max_amt, nearest, &nearest_amt, error);
+
+    if (fp != nullptr)
+    {
+        if (nearest_amt == 0)
+            fprintf(fp, "%s has no neighbours\n", found);
+        else
+            fprintf(fp, "Nearest to %s:\n", found);
+
+        // one line for each object, so say reads them one by one
+        for (size_t i = 0; i < nearest_amt; i++)
+            fprintf(fp, "%s - %zu same answers\n", nearest[i].node->data, nearest[i].same_answers);
+
+        fclose(fp);
+
+        if (error->code == (int) AkinatorErrors::NONE)
+            SayText(text);
+
+        free(text);
+    }
+
+    MemFree(nearest);
+    stk.destroy();
+
+    return (AkinatorErrors) error->code;
 }
 
 //---------------------------------------------------------------------------------------
 
-static AkinatorErrors CompareObjectsDescription(const Stack_t* stk_1, const Stack_t* stk_2,
+static AkinatorErrors CompareObjectsDescription(FILE* fp, const path_t* stk_1, const path_t* stk_2,
                                                 const char* object_1, const char* object_2,
                                                 Node* node, error_t* error)
 {
+    assert(fp);
     assert(stk_1);
     assert(stk_2);
     assert(object_1);
@@ -446,24 +1695,24 @@ static AkinatorErrors CompareObjectsDescription(const Stack_t* stk_1, const Stac
     Node* curr_node = node;
     int   stk_index = 0;
 
-    if (stk_1->data[stk_index] == stk_2->data[stk_index])
+    if (stk_1->size > 0 && stk_2->size > 0 && stk_1->data[stk_index] == stk_2->data[stk_index])
     {
-        SayPhrase("%s and %s are similar in that they both are: ", object_1, object_2);
+        fprintf(fp, "%s and %s are similar in that they both are: ", object_1, object_2);
 
-        WriteSimilarProperties(stk_1, stk_2, &stk_index, &curr_node, error);
+        WriteSimilarProperties(fp, stk_1, stk_2, &stk_index, &curr_node, error);
         RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
 
-        SayPhrase("But ");
+        fprintf(fp, "But ");
     }
 
-    SayPhrase("%s is: ", object_1);
+    fprintf(fp, "%s is: ", object_1);
 
-    PrintObjectPropertiesBasedOnStack(stk_1, stk_index, curr_node, error);
+    PrintObjectPropertiesBasedOnStack(fp, stk_1, stk_index, curr_node, error);
     RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
 
-    SayPhrase("And %s is: ", object_2);
+    fprintf(fp, "And %s is: ", object_2);
 
-    PrintObjectPropertiesBasedOnStack(stk_2, stk_index, curr_node, error);
+    PrintObjectPropertiesBasedOnStack(fp, stk_2, stk_index, curr_node, error);
     RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
 
     return AkinatorErrors::NONE;
@@ -471,18 +1720,20 @@ static AkinatorErrors CompareObjectsDescription(const Stack_t* stk_1, const Stac
 
 //---------------------------------------------------------------------------------------
 
-static AkinatorErrors WriteSimilarProperties(const Stack_t* stk_1, const Stack_t* stk_2,
+static AkinatorErrors WriteSimilarProperties(FILE* fp, const path_t* stk_1, const path_t* stk_2,
                                              int* stk_index, Node** curr_node, error_t* error)
 {
+    assert(fp);
     assert(stk_1);
     assert(stk_2);
     assert(stk_index);
     assert(curr_node);
     assert(error);
 
-    while (stk_1->data[*stk_index] == stk_2->data[*stk_index])
+    while ((size_t) *stk_index < stk_1->size && (size_t) *stk_index < stk_2->size &&
+           stk_1->data[*stk_index] == stk_2->data[*stk_index])
     {
-        elem_t step = stk_1->data[(*stk_index)++];
+        step_t step = stk_1->data[(*stk_index)++];
 
         if (*curr_node == nullptr && (step == RIGHT_STEP || step == LEFT_STEP))
         {
@@ -492,12 +1743,12 @@ static AkinatorErrors WriteSimilarProperties(const Stack_t* stk_1, const Stack_t
 
         if (step == RIGHT_STEP)
         {
-            SayPhrase("not %s, ", (*curr_node)->data);
+            fprintf(fp, "not %s, ", (*curr_node)->data);
             *curr_node = (*curr_node)->right;
         }
         else if (step == LEFT_STEP)
         {
-            SayPhrase("%s, ", (*curr_node)->data);
+            fprintf(fp, "%s, ", (*curr_node)->data);
             (*curr_node) = (*curr_node)->left;
         }
         else
@@ -506,7 +1757,7 @@ static AkinatorErrors WriteSimilarProperties(const Stack_t* stk_1, const Stack_t
             return AkinatorErrors::INVALID_STACK;
         }
     }
-    putchar('\n');
+    fputc('\n', fp);
 
     return AkinatorErrors::NONE;
 }
@@ -531,8 +1782,17 @@ AkinatorMode GetWorkingMode()
     {
         case AkinatorMode::COMPARE:     return AkinatorMode::COMPARE;
         case AkinatorMode::PRINT_TREE:  return AkinatorMode::PRINT_TREE;
+        case AkinatorMode::STATS:       return AkinatorMode::STATS;
         case AkinatorMode::DESCRIBE:    return AkinatorMode::DESCRIBE;
         case AkinatorMode::GUESS:       return AkinatorMode::GUESS;
+        case AkinatorMode::ADAPTIVE:    return AkinatorMode::ADAPTIVE;
+        case AkinatorMode::REBUILD:     return AkinatorMode::REBUILD;
+        case AkinatorMode::EXPORT:      return AkinatorMode::EXPORT;
+        case AkinatorMode::SET_QUERY:   return AkinatorMode::SET_QUERY;
+        case AkinatorMode::NEAREST:     return AkinatorMode::NEAREST;
+        case AkinatorMode::SIMILARITY:  return AkinatorMode::SIMILARITY;
+        case AkinatorMode::WORD_SEARCH: return AkinatorMode::WORD_SEARCH;
+        case AkinatorMode::DIFF:        return AkinatorMode::DIFF;
         case AkinatorMode::QUIT:
         // fall through
         default:                        return AkinatorMode::QUIT;
@@ -2,6 +2,7 @@
 #define __AKINATOR_H_
 
 #include "tree/tree.h"
+#include "stack/stack.h"
 
 enum class AkinatorErrors
 {
@@ -42,9 +43,36 @@ int PrintAkinatorError(FILE* fp, const void* err, const char* func, const char*
                                             } while(0)
 
 
-AkinatorErrors GuessMode(tree_t* tree, Node* node, const char* data_file, error_t* error);
-AkinatorErrors DescriptionMode(tree_t* tree, error_t* error);
-AkinatorErrors CompareMode(tree_t* tree, error_t* error);
+struct DescriptionCache;
+struct FuzzyIndex;
+struct WordIndex;
+struct PrefixIndex;
+struct QuestionIndex;
+
+// new questions and objects are added to word and prefix indexes, when tree learns new object
+AkinatorErrors GuessMode(tree_t* tree, Node* node, DescriptionCache* cache, WordIndex* words, PrefixIndex* names,
+                         const char* data_file, error_t* error);
+// asks questions with max information gain instead of walking tree
+AkinatorErrors AdaptiveGuessMode(const tree_t* tree, error_t* error);
+// texts are taken from cache, if these objects were asked before, names with typos are found by fuzzy index,
+// prefixes of names are completed by prefix index
+AkinatorErrors DescriptionMode(tree_t* tree, DescriptionCache* cache, FuzzyIndex* fuzzy, const PrefixIndex* names,
+                               error_t* error);
+AkinatorErrors CompareMode(tree_t* tree, DescriptionCache* cache, FuzzyIndex* fuzzy, const PrefixIndex* names,
+                           error_t* error);
+AkinatorErrors NearestMode(const tree_t* tree, FuzzyIndex* fuzzy, const PrefixIndex* names, error_t* error);
+// rebuilds tree with less expected questions and offers to save it in data file
+AkinatorErrors RebuildMode(const tree_t* tree, const char* data_file, error_t* error);
+// writes description of every object in catalog file next to data file
+AkinatorErrors ExportMode(const tree_t* tree, const char* data_file, error_t* error);
+AkinatorErrors SimilarityMode(const tree_t* tree, const char* data_file, error_t* error);
+
+// index of objects by answers is made on first query and made again only for other tree
+AkinatorErrors SetQueryMode(tree_t* tree, QuestionIndex* questions, error_t* error);
+// finds questions with words by index, that is synced with tree after every reading
+AkinatorErrors WordSearchMode(const tree_t* tree, const WordIndex* words, error_t* error);
+// prints objects, that were learned by other data file
+AkinatorErrors DiffMode(tree_t* tree, error_t* error);
 
 enum TreeSteps
 {
@@ -52,6 +80,15 @@ enum TreeSteps
     RIGHT_STEP = 1
 };
 
+/// one step of path from root (TreeSteps value)
+typedef unsigned char step_t;
+
+static const size_t PATH_INLINE_CAPACITY = 64;
+/// path from root to node, only very deep trees make it use heap
+typedef Stack<step_t, PATH_INLINE_CAPACITY> path_t;
+/// nodes from root to parent of current node, their stats are updated after tree learns new object
+typedef Stack<Node*, PATH_INLINE_CAPACITY> ancestors_t;
+
 enum AkinatorMode
 {
     QUIT       = -1,
@@ -59,7 +96,16 @@ enum AkinatorMode
     COMPARE    = 'C',
     GUESS      = 'G',
     DESCRIBE   = 'D',
-    PRINT_TREE = 'P'
+    PRINT_TREE = 'P',
+    STATS      = 'S',
+    ADAPTIVE   = 'A',
+    REBUILD    = 'R',
+    EXPORT     = 'E',
+    SET_QUERY  = 'F',
+    NEAREST    = 'N',
+    SIMILARITY = 'M',
+    WORD_SEARCH = 'W',
+    DIFF        = 'X'
 };
 
 AkinatorMode GetWorkingMode();
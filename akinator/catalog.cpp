@@ -0,0 +1,404 @@
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "catalog.h"
+#include "tree/traversal.h"
+#include "common/tasks.h"
+#include "common/trace.h"
+#include "common/memory.h"
+
+// subtrees for every thread, so threads with short subtrees steal from others
+static const size_t CHUNKS_PER_THREAD      = 64;
+// subtrees exported at once for every thread (only their texts are kept in memory)
+static const size_t WAVE_CHUNKS_PER_THREAD = 4;
+static const size_t MAX_SPLIT_DEPTH        = 16;
+
+// texts, that are escaped in JSON strings: quote, backslash and control characters
+static const char JSON_SPECIAL_CHARS[] = "\"\\\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+                                         "\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f";
+
+// question on path to object and answer of object to it
+struct CatalogStep
+{
+    const Node* node;
+    bool        answer;
+};
+
+struct CatalogContext
+{
+    CatalogFormat format;
+    // steps in the longest path
+    size_t        height;
+};
+
+struct CatalogChunk
+{
+    const CatalogContext* context;
+
+    const Node* subtree;
+    size_t      depth;
+    CatalogStep prefix[MAX_SPLIT_DEPTH];
+
+    char*  text;
+    size_t len;
+    size_t objects_amt;
+};
+
+static size_t CatalogSplitDepth(const Node* root);
+static bool   WriteChunked(FILE* fp, const Node* root, const CatalogContext* context,
+                           const size_t split_depth, size_t* objects_amt, error_t* error);
+static void   CatalogChunkTask(void* arg);
+static bool   WriteSubtree(FILE* fp, const CatalogContext* context, const Node* subtree,
+                           const size_t depth, const CatalogStep* prefix, size_t* objects_amt);
+
+static void   WriteObject(FILE* fp, const CatalogFormat format, const CatalogStep* path, const size_t depth);
+static void   WriteTsvText(FILE* fp, const char* text);
+static void   WriteJsonText(FILE* fp, const char* text);
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors CatalogWrite(FILE* fp, const tree_t* tree, const CatalogFormat format,
+                            size_t* objects_amt, error_t* error)
+{
+    assert(fp);
+    assert(tree);
+    assert(objects_amt);
+    assert(error);
+
+    TRACE_SPAN("CatalogWrite");
+
+    *objects_amt = 0;
+
+    if (tree->root == nullptr)
+        return AkinatorErrors::NONE;
+
+    CatalogContext context = {format, tree->root->subtree.height};
+
+    const size_t split_depth = CatalogSplitDepth(tree->root);
+
+    if (split_depth > 0 && WriteChunked(fp, tree->root, &context, split_depth, objects_amt, error))
+        return (AkinatorErrors) error->code;
+
+    if (!WriteSubtree(fp, &context, tree->root, 0, nullptr, objects_amt))
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+static size_t CatalogSplitDepth(const Node* root)
+{
+    assert(root);
+
+    const size_t threads_amt = TaskThreadsAmt();
+
+    if (threads_amt < 2 || root->subtree.nodes < PARALLEL_TREE_MIN_NODES)
+        return 0;
+
+    size_t split_depth = 0;
+    while (((size_t) 1 << split_depth) < CHUNKS_PER_THREAD * threads_amt && split_depth < MAX_SPLIT_DEPTH)
+        split_depth++;
+
+    return split_depth;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct CatalogVisitor : TreeVisitor<const Node>
+{
+    FILE*         fp          = nullptr;
+    CatalogFormat format      = CATALOG_TSV;
+    // path[depth] is node on depth, answers above base_depth are given by caller
+    CatalogStep*  path        = nullptr;
+    size_t        base_depth  = 0;
+    size_t        objects_amt = 0;
+
+    TraverseAction pre(const Node* node, const TraversePos* pos)
+    {
+        const size_t depth = base_depth + pos->depth;
+
+        if (pos->depth > 0)
+            path[depth - 1].answer = pos->is_left;
+
+        path[depth].node = node;
+
+        if (node->left == nullptr && node->right == nullptr)
+        {
+            WriteObject(fp, format, path, depth);
+            objects_amt++;
+        }
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+static bool WriteSubtree(FILE* fp, const CatalogContext* context, const Node* subtree,
+                         const size_t depth, const CatalogStep* prefix, size_t* objects_amt)
+{
+    assert(fp);
+    assert(context);
+    assert(subtree);
+    assert(objects_amt);
+
+    CatalogStep* path = (CatalogStep*) MemCalloc(MEM_INDEXES, context->height, sizeof(CatalogStep));
+    if (path == nullptr)
+        return false;
+
+    if (depth > 0)
+        memcpy(path, prefix, depth * sizeof(CatalogStep));
+
+    CatalogVisitor visitor = {};
+    visitor.fp         = fp;
+    visitor.format     = context->format;
+    visitor.path       = path;
+    visitor.base_depth = depth;
+
+    TreeErrors traverse_error = TraverseNodes(subtree, &visitor);
+
+    *objects_amt += visitor.objects_amt;
+
+    MemFree(path);
+
+    return traverse_error == TreeErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct CatalogSplitVisitor : TreeVisitor<const Node>
+{
+    const CatalogContext* context     = nullptr;
+    size_t                split_depth = 0;
+
+    CatalogStep   path[MAX_SPLIT_DEPTH + 1] = {};
+
+    CatalogChunk* chunks     = nullptr;
+    size_t        chunks_amt = 0;
+    size_t        capacity   = 0;
+    bool          failed     = false;
+
+    TraverseAction pre(const Node* node, const TraversePos* pos)
+    {
+        if (pos->depth > 0)
+            path[pos->depth - 1].answer = pos->is_left;
+
+        path[pos->depth].node = node;
+
+        if (pos->depth < split_depth && (node->left != nullptr || node->right != nullptr))
+            return TRAVERSE_CONTINUE;
+
+        if (chunks_amt == capacity)
+        {
+            size_t new_capacity = (capacity == 0) ? 64 : capacity * 2;
+
+            CatalogChunk* new_chunks = (CatalogChunk*) MemRealloc(MEM_TASKS,
+                                                                  chunks, new_capacity * sizeof(CatalogChunk));
+            if (new_chunks == nullptr)
+            {
+                failed = true;
+                return TRAVERSE_STOP;
+            }
+
+            chunks   = new_chunks;
+            capacity = new_capacity;
+        }
+
+        // leaves above split depth are chunks too, so objects keep prefix order
+        CatalogChunk* chunk = &chunks[chunks_amt++];
+        *chunk = {};
+
+        chunk->context = context;
+        chunk->subtree = node;
+        chunk->depth   = pos->depth;
+        memcpy(chunk->prefix, path, pos->depth * sizeof(CatalogStep));
+
+        return TRAVERSE_SKIP;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+// false if nothing is written and tree must be written by one thread
+static bool WriteChunked(FILE* fp, const Node* root, const CatalogContext* context,
+                         const size_t split_depth, size_t* objects_amt, error_t* error)
+{
+    assert(fp);
+    assert(root);
+    assert(context);
+    assert(objects_amt);
+    assert(error);
+
+    CatalogSplitVisitor visitor = {};
+    visitor.context     = context;
+    visitor.split_depth = split_depth;
+
+    TreeErrors traverse_error = TraverseNodes(root, &visitor);
+
+    if (traverse_error != TreeErrors::NONE || visitor.failed)
+    {
+        MemFree(visitor.chunks);
+        return false;
+    }
+
+    const size_t wave_amt = WAVE_CHUNKS_PER_THREAD * TaskThreadsAmt();
+
+    for (size_t wave_start = 0; wave_start < visitor.chunks_amt; wave_start += wave_amt)
+    {
+        const size_t wave_end = (wave_start + wave_amt < visitor.chunks_amt) ? wave_start + wave_amt
+                                                                             : visitor.chunks_amt;
+        TaskGroup group = {};
+
+        for (size_t i = wave_start; i < wave_end; i++)
+            TaskSpawn(&group, CatalogChunkTask, &visitor.chunks[i]);
+
+        TaskWait(&group);
+
+        // texts are written in order, so catalog is the same as one thread writes
+        for (size_t i = wave_start; i < wave_end; i++)
+        {
+            CatalogChunk* chunk = &visitor.chunks[i];
+
+            if (chunk->text != nullptr)
+            {
+                fwrite(chunk->text, sizeof(char), chunk->len, fp);
+                *objects_amt += chunk->objects_amt;
+            }
+            else if (!WriteSubtree(fp, context, chunk->subtree, chunk->depth, chunk->prefix, objects_amt))
+                error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+
+            free(chunk->text);
+        }
+    }
+
+    MemFree(visitor.chunks);
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void CatalogChunkTask(void* arg)
+{
+    assert(arg);
+
+    TRACE_SPAN("CatalogWrite chunk");
+
+    CatalogChunk* chunk = (CatalogChunk*) arg;
+
+    FILE* chunk_fp = open_memstream(&chunk->text, &chunk->len);
+    if (chunk_fp == nullptr)
+        return;
+
+    bool written = WriteSubtree(chunk_fp, chunk->context, chunk->subtree, chunk->depth, chunk->prefix,
+                                &chunk->objects_amt);
+    fclose(chunk_fp);
+
+    // chunk is written by main thread then
+    if (!written)
+    {
+        free(chunk->text);
+        chunk->text        = nullptr;
+        chunk->objects_amt = 0;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+static void WriteObject(FILE* fp, const CatalogFormat format, const CatalogStep* path, const size_t depth)
+{
+    assert(fp);
+    assert(path);
+
+    const char* object = path[depth].node->data;
+
+    if (format == CATALOG_TSV)
+    {
+        WriteTsvText(fp, object);
+
+        for (size_t i = 0; i < depth; i++)
+        {
+            fputs(path[i].answer ? "\t" : "\tnot ", fp);
+            WriteTsvText(fp, path[i].node->data);
+        }
+
+        putc('\n', fp);
+        return;
+    }
+
+    fputs("{\"object\":", fp);
+    WriteJsonText(fp, object);
+    fputs(",\"properties\":[", fp);
+
+    for (size_t i = 0; i < depth; i++)
+    {
+        fputs((i == 0) ? "{\"question\":" : ",{\"question\":", fp);
+        WriteJsonText(fp, path[i].node->data);
+        fputs(path[i].answer ? ",\"answer\":true}" : ",\"answer\":false}", fp);
+    }
+
+    fputs("]}\n", fp);
+}
+
+//---------------------------------------------------------------------------------------
+
+static void WriteTsvText(FILE* fp, const char* text)
+{
+    assert(fp);
+    assert(text);
+
+    while (*text != '\0')
+    {
+        const size_t plain_len = strcspn(text, "\t\n\r\\");
+
+        fwrite(text, sizeof(char), plain_len, fp);
+        text += plain_len;
+
+        switch (*text)
+        {
+            case '\0':  return;
+            case '\t':  fputs("\\t",  fp); break;
+            case '\n':  fputs("\\n",  fp); break;
+            case '\r':  fputs("\\r",  fp); break;
+            default:    fputs("\\\\", fp); break;
+        }
+
+        text++;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+static void WriteJsonText(FILE* fp, const char* text)
+{
+    assert(fp);
+    assert(text);
+
+    putc('"', fp);
+
+    while (*text != '\0')
+    {
+        const size_t plain_len = strcspn(text, JSON_SPECIAL_CHARS);
+
+        fwrite(text, sizeof(char), plain_len, fp);
+        text += plain_len;
+
+        switch (*text)
+        {
+            case '\0':  break;
+            case '"':   fputs("\\\"", fp); break;
+            case '\\':  fputs("\\\\", fp); break;
+            case '\t':  fputs("\\t",  fp); break;
+            case '\n':  fputs("\\n",  fp); break;
+            case '\r':  fputs("\\r",  fp); break;
+            default:    fprintf(fp, "\\u%04x", (unsigned) (unsigned char) *text); break;
+        }
+
+        if (*text != '\0')
+            text++;
+    }
+
+    putc('"', fp);
+}
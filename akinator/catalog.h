@@ -0,0 +1,28 @@
+#ifndef __CATALOG_H_
+#define __CATALOG_H_
+
+#include "akinator.h"
+
+// Catalog of all objects with their full property lists, made by one walk of tree (describe mode
+// searches the whole tree for every object).
+//
+// TSV line:   object<TAB>property<TAB>not property...  (tabs, newlines and \ in texts are escaped)
+// JSONL line: {"object":"...","properties":[{"question":"...","answer":true},...]}
+//
+// Objects go in prefix order of tree. Big trees are split by subtrees between threads, their
+// texts are glued in the same order.
+
+enum CatalogFormat
+{
+    CATALOG_TSV   = 0,
+    CATALOG_JSONL = 1
+};
+
+static const char* const CATALOG_TSV_EXT     = ".tsv";
+static const char* const CATALOG_JSONL_EXT   = ".jsonl";
+static const size_t      CATALOG_BUFFER_SIZE = 1 << 20;
+
+AkinatorErrors CatalogWrite(FILE* fp, const tree_t* tree, const CatalogFormat format,
+                            size_t* objects_amt, error_t* error);
+
+#endif
@@ -0,0 +1,343 @@
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "description_cache.h"
+#include "stack/hash.h"
+#include "common/metrics.h"
+#include "common/memory.h"
+
+static const size_t NO_ENTRY = SIZE_MAX;
+
+static hash_t HashKey(const char* object_1, const char* object_2);
+static void   HashName(HashState* state, const char* name);
+static size_t FindEntry(const DescriptionCache* cache, const char* object_1, const char* object_2,
+                        const hash_t key_hash);
+static void   RemoveEntry(DescriptionCache* cache, const size_t index);
+static void   FreeEntry(DescriptionCache* cache, const size_t index);
+
+static void   ListRemove(DescriptionCache* cache, const size_t index);
+static void   ListPushFront(DescriptionCache* cache, const size_t index);
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors DescriptionCacheCtor(DescriptionCache* cache, const size_t capacity, error_t* error)
+{
+    assert(cache);
+    assert(capacity > 0);
+    assert(error);
+
+    *cache = {};
+
+    // buckets are twice more than entries (power of two), so chains are short
+    size_t buckets_amt = 1;
+    while (buckets_amt < 2 * capacity)
+        buckets_amt *= 2;
+
+    cache->entries = (CacheEntry*) MemCalloc(MEM_CACHES, capacity,    sizeof(CacheEntry));
+    cache->buckets = (size_t*)     MemCalloc(MEM_CACHES, buckets_amt, sizeof(size_t));
+
+    if (cache->entries == nullptr || cache->buckets == nullptr)
+    {
+        MemFree(cache->entries);
+        MemFree(cache->buckets);
+        *cache = {};
+
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    cache->capacity    = capacity;
+    cache->buckets_amt = buckets_amt;
+    cache->head        = NO_ENTRY;
+    cache->tail        = NO_ENTRY;
+    cache->free_head   = 0;
+
+    for (size_t i = 0; i < buckets_amt; i++)
+        cache->buckets[i] = NO_ENTRY;
+
+    for (size_t i = 0; i < capacity; i++)
+        cache->entries[i].next = (i + 1 < capacity) ? i + 1 : NO_ENTRY;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+void DescriptionCacheDtor(DescriptionCache* cache)
+{
+    assert(cache);
+
+    while (cache->head != NO_ENTRY)
+        RemoveEntry(cache, cache->head);
+
+    MemFree(cache->entries);
+    MemFree(cache->buckets);
+
+    *cache = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+const char* DescriptionCacheFind(DescriptionCache* cache, const char* object_1, const char* object_2)
+{
+    assert(cache);
+    assert(object_1);
+
+    const size_t index = FindEntry(cache, object_1, object_2, HashKey(object_1, object_2));
+
+    if (index == NO_ENTRY)
+    {
+        MetricAdd(DESCRIBE_CACHE_MISSES);
+        return nullptr;
+    }
+
+    MetricAdd(DESCRIBE_CACHE_HITS);
+
+    ListRemove(cache, index);
+    ListPushFront(cache, index);
+
+    return cache->entries[index].text;
+}
+
+//---------------------------------------------------------------------------------------
+
+void DescriptionCacheAdd(DescriptionCache* cache, const char* object_1, const char* object_2,
+                         const char* text)
+{
+    assert(cache);
+    assert(object_1);
+    assert(text);
+
+    const hash_t key_hash = HashKey(object_1, object_2);
+
+    if (FindEntry(cache, object_1, object_2, key_hash) != NO_ENTRY)
+        return;
+
+    if (cache->free_head == NO_ENTRY)
+        RemoveEntry(cache, cache->tail);
+
+    const size_t index = cache->free_head;
+    CacheEntry*  entry = &cache->entries[index];
+
+    cache->free_head = entry->next;
+
+    entry->object_1 = MemStrdup(MEM_CACHES, object_1);
+    entry->object_2 = (object_2 != nullptr) ? MemStrdup(MEM_CACHES, object_2) : nullptr;
+    entry->text     = MemStrdup(MEM_CACHES, text);
+    entry->key_hash = key_hash;
+
+    // text is rendered again next time, cache is only lost time
+    if (entry->object_1 == nullptr || entry->text == nullptr || (object_2 != nullptr && entry->object_2 == nullptr))
+    {
+        FreeEntry(cache, index);
+        return;
+    }
+
+    const size_t bucket = key_hash & (cache->buckets_amt - 1);
+
+    entry->chain_next      = cache->buckets[bucket];
+    cache->buckets[bucket] = index;
+
+    ListPushFront(cache, index);
+    cache->entries_amt++;
+}
+
+//---------------------------------------------------------------------------------------
+
+void DescriptionCacheInvalidate(DescriptionCache* cache, const char* object)
+{
+    assert(cache);
+    assert(object);
+
+    size_t index = cache->head;
+
+    while (index != NO_ENTRY)
+    {
+        const CacheEntry* entry = &cache->entries[index];
+        const size_t      next  = entry->next;
+
+        if (!strcasecmp(entry->object_1, object) ||
+            (entry->object_2 != nullptr && !strcasecmp(entry->object_2, object)))
+        {
+            RemoveEntry(cache, index);
+            MetricAdd(DESCRIBE_CACHE_INVALIDATIONS);
+        }
+
+        index = next;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+void DescriptionCacheExpectTree(DescriptionCache* cache, tree_t* tree)
+{
+    assert(cache);
+    assert(tree);
+
+    cache->expected_hash = TreeRootHash(tree);
+}
+
+//---------------------------------------------------------------------------------------
+
+void DescriptionCacheSync(DescriptionCache* cache, tree_t* tree)
+{
+    assert(cache);
+    assert(tree);
+
+    const hash_t tree_hash = TreeRootHash(tree);
+
+    if (tree_hash != cache->tree_hash && tree_hash != cache->expected_hash)
+    {
+        MetricAdd(DESCRIBE_CACHE_INVALIDATIONS, cache->entries_amt);
+
+        while (cache->head != NO_ENTRY)
+            RemoveEntry(cache, cache->head);
+    }
+
+    cache->tree_hash     = tree_hash;
+    cache->expected_hash = tree_hash;
+}
+
+//---------------------------------------------------------------------------------------
+
+static hash_t HashKey(const char* object_1, const char* object_2)
+{
+    assert(object_1);
+
+    HashState state = {};
+    HashStart(&state);
+
+    HashName(&state, object_1);
+
+    if (object_2 != nullptr)
+        HashName(&state, object_2);
+
+    return HashFinish(&state);
+}
+
+//---------------------------------------------------------------------------------------
+
+// case is ignored like in search, terminator is hashed too, so ("ab", "c") and ("a", "bc") differ
+static void HashName(HashState* state, const char* name)
+{
+    assert(state);
+    assert(name);
+
+    char   folded[64] = {};
+    size_t len        = 0;
+
+    do
+    {
+        folded[len++] = (char) tolower((unsigned char) *name);
+
+        if (len == sizeof(folded) || *name == '\0')
+        {
+            HashUpdate(state, folded, len);
+            len = 0;
+        }
+    } while (*name++ != '\0');
+}
+
+//---------------------------------------------------------------------------------------
+
+static size_t FindEntry(const DescriptionCache* cache, const char* object_1, const char* object_2,
+                        const hash_t key_hash)
+{
+    assert(cache);
+    assert(object_1);
+
+    size_t index = cache->buckets[key_hash & (cache->buckets_amt - 1)];
+
+    while (index != NO_ENTRY)
+    {
+        const CacheEntry* entry = &cache->entries[index];
+
+        if (entry->key_hash == key_hash && !strcasecmp(entry->object_1, object_1) &&
+            (entry->object_2 == nullptr) == (object_2 == nullptr) &&
+            (object_2 == nullptr || !strcasecmp(entry->object_2, object_2)))
+            return index;
+
+        index = entry->chain_next;
+    }
+
+    return NO_ENTRY;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void RemoveEntry(DescriptionCache* cache, const size_t index)
+{
+    assert(cache);
+    assert(index < cache->capacity);
+
+    size_t* link = &cache->buckets[cache->entries[index].key_hash & (cache->buckets_amt - 1)];
+
+    while (*link != index)
+        link = &cache->entries[*link].chain_next;
+
+    *link = cache->entries[index].chain_next;
+
+    ListRemove(cache, index);
+    FreeEntry(cache, index);
+
+    cache->entries_amt--;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void FreeEntry(DescriptionCache* cache, const size_t index)
+{
+    assert(cache);
+
+    CacheEntry* entry = &cache->entries[index];
+
+    MemFree(entry->object_1);
+    MemFree(entry->object_2);
+    MemFree(entry->text);
+
+    *entry = {};
+
+    entry->next      = cache->free_head;
+    cache->free_head = index;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void ListRemove(DescriptionCache* cache, const size_t index)
+{
+    assert(cache);
+
+    CacheEntry* entry = &cache->entries[index];
+
+    if (entry->prev != NO_ENTRY)
+        cache->entries[entry->prev].next = entry->next;
+    else
+        cache->head = entry->next;
+
+    if (entry->next != NO_ENTRY)
+        cache->entries[entry->next].prev = entry->prev;
+    else
+        cache->tail = entry->prev;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void ListPushFront(DescriptionCache* cache, const size_t index)
+{
+    assert(cache);
+
+    CacheEntry* entry = &cache->entries[index];
+
+    entry->prev = NO_ENTRY;
+    entry->next = cache->head;
+
+    if (cache->head != NO_ENTRY)
+        cache->entries[cache->head].prev = index;
+    else
+        cache->tail = index;
+
+    cache->head = index;
+}
@@ -0,0 +1,66 @@
+#ifndef __DESCRIPTION_CACHE_H_
+#define __DESCRIPTION_CACHE_H_
+
+#include "akinator.h"
+
+// LRU cache of rendered texts of describe mode (key is one object) and compare mode (key is ordered
+// pair of objects), so popular objects are not searched in tree again.
+//
+// Text of object depends only on questions on path to its leaf, and guess mode changes only one leaf:
+// it becomes question above old object and new one. So learning drops only entries with these two
+// objects. Any other change of data file (rebuild, editing by hand) drops all entries.
+
+static const size_t DESCRIPTION_CACHE_CAPACITY = 256;
+
+struct CacheEntry
+{
+    // typed by user, second object is nullptr for describe mode
+    char*  object_1;
+    char*  object_2;
+    hash_t key_hash;
+
+    char*  text;
+
+    // LRU list, the most recent entry is head
+    size_t prev;
+    size_t next;
+    // next entry in the same bucket
+    size_t chain_next;
+};
+
+struct DescriptionCache
+{
+    CacheEntry* entries;
+    size_t      entries_amt;
+    size_t      capacity;
+
+    size_t*     buckets;
+    size_t      buckets_amt;
+
+    size_t      head;
+    size_t      tail;
+    // unused entries are chained by next
+    size_t      free_head;
+
+    // content hashes of tree, that entries match, and of tree after precise invalidation
+    hash_t      tree_hash;
+    hash_t      expected_hash;
+};
+
+AkinatorErrors DescriptionCacheCtor(DescriptionCache* cache, const size_t capacity, error_t* error);
+void           DescriptionCacheDtor(DescriptionCache* cache);
+
+// text is valid until next add (nullptr if there is no entry), case of names is ignored
+const char*    DescriptionCacheFind(DescriptionCache* cache, const char* object_1, const char* object_2);
+// copies key and text, the least recent entry is dropped if cache is full
+void           DescriptionCacheAdd(DescriptionCache* cache, const char* object_1, const char* object_2,
+                                   const char* text);
+
+// drops entries with object (case is ignored, like in search)
+void           DescriptionCacheInvalidate(DescriptionCache* cache, const char* object);
+// entries were invalidated for changes of tree already, so this tree does not drop them
+void           DescriptionCacheExpectTree(DescriptionCache* cache, tree_t* tree);
+// drops all entries, if tree is not the one entries were made for (called after every reading)
+void           DescriptionCacheSync(DescriptionCache* cache, tree_t* tree);
+
+#endif
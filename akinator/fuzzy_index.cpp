@@ -0,0 +1,475 @@
+#include <assert.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "fuzzy_index.h"
+#include "tree/traversal.h"
+#include "common/input_and_output.h"
+#include "common/trace.h"
+#include "common/memory.h"
+
+// name is padded by two spaces before and one after, so its first letters make trigrams too
+static const size_t MAX_NAME_TRIGRAMS = MAX_STRING_LEN + 2;
+
+static AkinatorErrors BuildIndex(FuzzyIndex* index, const tree_t* tree, error_t* error);
+static size_t         NameBuckets(const char* name, uint32_t* buckets);
+
+static size_t         CollectCandidates(FuzzyIndex* index, const uint32_t* buckets, const size_t buckets_amt,
+                                        const size_t min_score);
+static void           CheckCandidates(const FuzzyIndex* index, const char* name, const size_t candidates_amt,
+                                      const size_t buckets_amt, size_t limit,
+                                      FuzzyMatch* matches, size_t* matches_amt);
+static void           AddMatch(FuzzyMatch* matches, size_t* matches_amt, const FuzzyMatch match);
+
+static size_t         AllowedDistance(const char* name);
+static size_t         EditDistance(const char* text_1, const char* text_2);
+
+//---------------------------------------------------------------------------------------
+
+void FuzzyIndexCtor(FuzzyIndex* index)
+{
+    assert(index);
+
+    *index = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+void FuzzyIndexDtor(FuzzyIndex* index)
+{
+    assert(index);
+
+    MemFree(index->names);
+    MemFree(index->texts);
+    MemFree(index->first);
+    MemFree(index->postings);
+    MemFree(index->scores);
+    MemFree(index->candidates);
+    MemFree(index->sorted);
+
+    *index = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors FuzzyIndexFind(FuzzyIndex* index, const tree_t* tree, const char* name,
+                              FuzzyMatch* matches, size_t* matches_amt, error_t* error)
+{
+    assert(index);
+    assert(tree);
+    assert(name);
+    assert(matches);
+    assert(matches_amt);
+    assert(error);
+
+    TRACE_SPAN("FuzzyIndexFind");
+
+    *matches_amt = 0;
+
+    if (tree->root == nullptr)
+        return AkinatorErrors::NONE;
+
+    if (!index->built || index->tree_hash != tree->root->hash)
+    {
+        BuildIndex(index, tree, error);
+        RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+    }
+
+    uint32_t     buckets[MAX_NAME_TRIGRAMS] = {};
+    const size_t buckets_amt = NameBuckets(name, buckets);
+    const size_t limit       = AllowedDistance(name);
+
+    // names without enough shared trigrams are farther than limit
+    const size_t min_score = (buckets_amt > 3 * limit) ? buckets_amt - 3 * limit : 1;
+
+    const size_t candidates_amt = CollectCandidates(index, buckets, buckets_amt, min_score);
+
+    CheckCandidates(index, name, candidates_amt, buckets_amt, limit, matches, matches_amt);
+
+    return AkinatorErrors::NONE;
+}
+
+
+//---------------------------------------------------------------------------------------
+
+struct FuzzyNamesVisitor : TreeVisitor<const Node>
+{
+    FuzzyIndex* index      = nullptr;
+    // block for texts is allocated after the first walk, which only counts their size
+    size_t      texts_size = 0;
+
+    TraverseAction pre(const Node* node, const TraversePos*)
+    {
+        if (node->left != nullptr || node->right != nullptr)
+            return TRAVERSE_CONTINUE;
+
+        const size_t size = strlen(node->data) + 1;
+
+        if (index->texts != nullptr)
+        {
+            memcpy(index->texts + texts_size, node->data, size);
+            index->names[index->objects_amt++] = index->texts + texts_size;
+        }
+
+        texts_size += size;
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors BuildIndex(FuzzyIndex* index, const tree_t* tree, error_t* error)
+{
+    assert(index);
+    assert(tree);
+    assert(tree->root);
+    assert(error);
+
+    TRACE_SPAN("FuzzyIndex build");
+
+    FuzzyIndexDtor(index);
+
+    const size_t objects_amt = tree->root->subtree.leaves;
+
+    FuzzyNamesVisitor visitor = {};
+    visitor.index = index;
+
+    if (TraverseNodes(tree->root, &visitor) != TreeErrors::NONE)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    index->names      = (const char**)    MemCalloc(MEM_INDEXES, objects_amt + 1, sizeof(const char*));
+    index->texts      = (char*)           MemCalloc(MEM_STRINGS, visitor.texts_size + 1, sizeof(char));
+    index->first      = (size_t*)         MemCalloc(MEM_INDEXES, TRIGRAM_BUCKETS + 1, sizeof(size_t));
+    index->scores     = (uint8_t*)        MemCalloc(MEM_INDEXES, objects_amt + 1, sizeof(uint8_t));
+    index->candidates = (FuzzyCandidate*) MemCalloc(MEM_INDEXES, objects_amt + 1, sizeof(FuzzyCandidate));
+    index->sorted     = (FuzzyCandidate*) MemCalloc(MEM_INDEXES, objects_amt + 1, sizeof(FuzzyCandidate));
+
+    if (index->names == nullptr || index->texts      == nullptr || index->first  == nullptr ||
+        index->scores == nullptr || index->candidates == nullptr || index->sorted == nullptr)
+    {
+        FuzzyIndexDtor(index);
+
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    visitor.texts_size = 0;
+
+    if (TraverseNodes(tree->root, &visitor) != TreeErrors::NONE)
+    {
+        FuzzyIndexDtor(index);
+
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    uint32_t buckets[MAX_NAME_TRIGRAMS] = {};
+
+    // postings are laid out by counts of buckets, then filled in the same order
+    for (size_t i = 0; i < index->objects_amt; i++)
+    {
+        const size_t buckets_amt = NameBuckets(index->names[i], buckets);
+
+        for (size_t j = 0; j < buckets_amt; j++)
+            index->first[buckets[j] + 1]++;
+    }
+
+    for (size_t i = 0; i < TRIGRAM_BUCKETS; i++)
+        index->first[i + 1] += index->first[i];
+
+    index->postings = (uint32_t*) MemCalloc(MEM_INDEXES, index->first[TRIGRAM_BUCKETS] + 1, sizeof(uint32_t));
+    if (index->postings == nullptr)
+    {
+        FuzzyIndexDtor(index);
+
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    // first[b] is moved to the end of bucket b while filling, so it is shifted back after
+    for (size_t i = 0; i < index->objects_amt; i++)
+    {
+        const size_t buckets_amt = NameBuckets(index->names[i], buckets);
+
+        for (size_t j = 0; j < buckets_amt; j++)
+            index->postings[index->first[buckets[j]]++] = (uint32_t) i;
+    }
+
+    for (size_t i = TRIGRAM_BUCKETS; i > 0; i--)
+        index->first[i] = index->first[i - 1];
+
+    index->first[0]  = 0;
+    index->tree_hash = tree->root->hash;
+    index->built     = true;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+// different buckets of trigrams of name (sorted), returns their amount
+static size_t NameBuckets(const char* name, uint32_t* buckets)
+{
+    assert(name);
+    assert(buckets);
+
+    uint32_t trigram     = ((uint32_t) ' ' << 8) | (uint32_t) ' ';
+    size_t   buckets_amt = 0;
+
+    for (size_t i = 0; buckets_amt < MAX_NAME_TRIGRAMS; i++)
+    {
+        const char c = (name[i] == '\0') ? ' ' : (char) tolower((unsigned char) name[i]);
+
+        trigram = ((trigram << 8) | (unsigned char) c) & 0xFFFFFF;
+
+        // Fibonacci hashing, the highest bits are the most mixed
+        const uint32_t bucket = ((trigram * 2654435761u) >> 16) & (TRIGRAM_BUCKETS - 1);
+
+        // insertion sort, names are short
+        size_t j = buckets_amt;
+        while (j > 0 && buckets[j - 1] > bucket)
+        {
+            buckets[j] = buckets[j - 1];
+            j--;
+        }
+
+        if (j > 0 && buckets[j - 1] == bucket)
+        {
+            memmove(buckets + j, buckets + j + 1, (buckets_amt - j) * sizeof(uint32_t));
+        }
+        else
+        {
+            buckets[j] = bucket;
+            buckets_amt++;
+        }
+
+        if (name[i] == '\0')
+            break;
+    }
+
+    return buckets_amt;
+}
+
+//---------------------------------------------------------------------------------------
+
+// candidates are sorted by shared trigrams, the most similar names go first
+static size_t CollectCandidates(FuzzyIndex* index, const uint32_t* buckets, const size_t buckets_amt,
+                                const size_t min_score)
+{
+    assert(index);
+    assert(buckets);
+
+    for (size_t i = 0; i < buckets_amt; i++)
+        for (size_t j = index->first[buckets[i]]; j < index->first[buckets[i] + 1]; j++)
+            index->scores[index->postings[j]]++;
+
+    size_t candidates_amt                    = 0;
+    size_t score_starts[MAX_NAME_TRIGRAMS + 1] = {};
+
+    // scores are cleared by the same walk, so every object becomes candidate once
+    for (size_t i = 0; i < buckets_amt; i++)
+    {
+        for (size_t j = index->first[buckets[i]]; j < index->first[buckets[i] + 1]; j++)
+        {
+            const uint32_t object = index->postings[j];
+            const uint8_t  score  = index->scores[object];
+
+            if (score >= min_score)
+            {
+                index->candidates[candidates_amt++] = {object, score};
+                score_starts[score]++;
+            }
+
+            index->scores[object] = 0;
+        }
+    }
+
+    // counting sort by score, objects with equal scores keep order of postings
+    size_t position = 0;
+
+    for (size_t score = buckets_amt + 1; score-- > 0; )
+    {
+        const size_t amt    = score_starts[score];
+        score_starts[score] = position;
+        position           += amt;
+    }
+
+    for (size_t i = 0; i < candidates_amt; i++)
+        index->sorted[score_starts[index->candidates[i].score]++] = index->candidates[i];
+
+    return candidates_amt;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void CheckCandidates(const FuzzyIndex* index, const char* name, const size_t candidates_amt,
+                            const size_t buckets_amt, size_t limit,
+                            FuzzyMatch* matches, size_t* matches_amt)
+{
+    assert(index);
+    assert(name);
+    assert(matches);
+    assert(matches_amt);
+
+    const size_t name_len = strlen(name);
+
+    for (size_t i = 0; i < candidates_amt; i++)
+    {
+        // next candidates share less trigrams, so they are farther than limit
+        if (index->sorted[i].score + 3 * limit < buckets_amt)
+            break;
+
+        const size_t object     = index->sorted[i].object;
+        const size_t object_len = strlen(index->names[object]);
+
+        if (object_len > name_len + limit || name_len > object_len + limit)
+            continue;
+
+        const size_t distance = EditDistance(name, index->names[object]);
+        if (distance > limit)
+            continue;
+
+        AddMatch(matches, matches_amt, {index->names[object], object, distance});
+
+        // others are shown only if they are almost as close as the best one
+        if (matches[0].distance + 1 < limit)
+            limit = matches[0].distance + 1;
+
+        if (*matches_amt == FUZZY_MATCHES_MAX && matches[FUZZY_MATCHES_MAX - 1].distance < limit)
+            limit = matches[FUZZY_MATCHES_MAX - 1].distance;
+    }
+
+    while (*matches_amt > 0 && matches[*matches_amt - 1].distance > limit)
+        (*matches_amt)--;
+}
+
+//---------------------------------------------------------------------------------------
+
+// matches are sorted by distance, then by DFS order
+static void AddMatch(FuzzyMatch* matches, size_t* matches_amt, const FuzzyMatch match)
+{
+    assert(matches);
+    assert(matches_amt);
+
+    size_t i = *matches_amt;
+
+    while (i > 0 && (matches[i - 1].distance > match.distance ||
+                     (matches[i - 1].distance == match.distance && matches[i - 1].object > match.object)))
+    {
+        if (i < FUZZY_MATCHES_MAX)
+            matches[i] = matches[i - 1];
+        i--;
+    }
+
+    if (i >= FUZZY_MATCHES_MAX)
+        return;
+
+    matches[i] = match;
+
+    if (*matches_amt < FUZZY_MATCHES_MAX)
+        (*matches_amt)++;
+}
+
+//---------------------------------------------------------------------------------------
+
+// typos allowed in name: one for short names, about one in three letters for longer ones
+static size_t AllowedDistance(const char* name)
+{
+    assert(name);
+
+    return strlen(name) / 3 + 1;
+}
+
+//---------------------------------------------------------------------------------------
+
+// Levenshtein distance, case is ignored
+static size_t EditDistance(const char* text_1, const char* text_2)
+{
+    assert(text_1);
+    assert(text_2);
+
+    size_t len_2 = strlen(text_2);
+    if (len_2 > MAX_STRING_LEN)
+        len_2 = MAX_STRING_LEN;
+
+    size_t row_1[MAX_STRING_LEN + 1] = {};
+    size_t row_2[MAX_STRING_LEN + 1] = {};
+
+    size_t* prev = row_1;
+    size_t* cur  = row_2;
+
+    for (size_t j = 0; j <= len_2; j++)
+        prev[j] = j;
+
+    for (size_t i = 0; text_1[i] != '\0' && i < MAX_STRING_LEN; i++)
+    {
+        cur[0] = i + 1;
+
+        const int c_1 = tolower((unsigned char) text_1[i]);
+
+        for (size_t j = 1; j <= len_2; j++)
+        {
+            const size_t replace = prev[j - 1] + (c_1 != tolower((unsigned char) text_2[j - 1]));
+            const size_t remove  = prev[j] + 1;
+            const size_t insert  = cur[j - 1] + 1;
+
+            size_t best = (replace < remove) ? replace : remove;
+            cur[j] = (insert < best) ? insert : best;
+        }
+
+        size_t* tmp = prev;
+        prev = cur;
+        cur  = tmp;
+    }
+
+    return prev[len_2];
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors GetPathToObject(const tree_t* tree, const size_t object, path_t* stk, error_t* error)
+{
+    assert(tree);
+    assert(stk);
+    assert(error);
+
+    const Node* node   = tree->root;
+    size_t      number = object;
+
+    // objects of left subtree go first in DFS order
+    while (node != nullptr && (node->left != nullptr || node->right != nullptr))
+    {
+        const size_t left_leaves = (node->left != nullptr) ? node->left->subtree.leaves : 0;
+
+        step_t step = LEFT_STEP;
+
+        if (number < left_leaves)
+        {
+            node = node->left;
+        }
+        else
+        {
+            number -= left_leaves;
+            node    = node->right;
+            step    = RIGHT_STEP;
+        }
+
+        if (stk->push(step) != (int) ERRORS::NONE)
+        {
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            return AkinatorErrors::ALLOCATE_MEMORY;
+        }
+    }
+
+    if (node == nullptr)
+    {
+        error->code = (int) AkinatorErrors::INVALID_STACK;
+        return AkinatorErrors::INVALID_STACK;
+    }
+
+    return AkinatorErrors::NONE;
+}
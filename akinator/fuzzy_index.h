@@ -0,0 +1,66 @@
+#ifndef __FUZZY_INDEX_H_
+#define __FUZZY_INDEX_H_
+
+#include <stdint.h>
+
+#include "akinator.h"
+
+// Index of object names for lookup with typos: postings of trigrams (case is ignored).
+//
+// Every edit of name breaks at most 3 of its trigrams, so name within edit distance d from query
+// shares at least (query trigrams - 3 * d) trigrams with it. Lookup counts shared trigrams by
+// postings of query trigrams and counts edit distance only for names with the most shared ones,
+// until this bound cuts the rest. Index is made on first miss and made again only for other tree.
+
+static const size_t FUZZY_MATCHES_MAX = 3;
+// trigrams are hashed in buckets, collisions only add candidates, that are checked anyway
+static const size_t TRIGRAM_BUCKETS   = 1 << 16;
+
+struct FuzzyMatch
+{
+    const char* name;
+    // number of object in DFS order
+    size_t      object;
+    size_t      distance;
+};
+
+struct FuzzyCandidate
+{
+    uint32_t object;
+    // trigrams shared with query
+    uint32_t score;
+};
+
+struct FuzzyIndex
+{
+    // names[i] is name of i-th object in DFS order, texts are in one block
+    const char** names;
+    char*        texts;
+    size_t       objects_amt;
+
+    // objects with trigram in bucket b are postings[first[b] .. first[b + 1])
+    size_t*      first;
+    uint32_t*    postings;
+
+    // trigrams shared with query for every object (zeros between lookups) and candidates of lookup
+    uint8_t*        scores;
+    FuzzyCandidate* candidates;
+    FuzzyCandidate* sorted;
+
+    // merkle hash of tree, that index is made for
+    hash_t       tree_hash;
+    bool         built;
+};
+
+void           FuzzyIndexCtor(FuzzyIndex* index);
+void           FuzzyIndexDtor(FuzzyIndex* index);
+
+// up to FUZZY_MATCHES_MAX objects, the closest one is first. Merkle hash of tree must be counted
+// (it is done after every reading), index is made again if it is not for this tree
+AkinatorErrors FuzzyIndexFind(FuzzyIndex* index, const tree_t* tree, const char* name,
+                              FuzzyMatch* matches, size_t* matches_amt, error_t* error);
+
+// path to object with this DFS number, O(depth) by amounts of leaves in subtrees
+AkinatorErrors GetPathToObject(const tree_t* tree, const size_t object, path_t* stk, error_t* error);
+
+#endif
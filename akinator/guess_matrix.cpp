@@ -0,0 +1,676 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "guess_matrix.h"
+#include "tree/traversal.h"
+#include "stack/hash.h"
+#include "common/trace.h"
+#include "common/memory.h"
+#include "common/tasks.h"
+
+static const size_t WORD_BITS = 64;
+
+// smaller scans are not split in tasks
+static const size_t PARALLEL_SCAN_MIN_QUESTIONS = 1 << 15;
+static const size_t MAX_SCAN_CHUNKS             = 64;
+
+// part of active questions, that is scanned by one task
+struct ScanChunk
+{
+    GuessMatrix* matrix;
+    size_t       begin;
+    size_t       end;
+
+    // questions, that still split candidates, are moved to chunk start
+    size_t         kept_amt;
+    GuessQuestion* best;
+    double         best_entropy;
+};
+
+struct QuestionEntry
+{
+    hash_t      text_hash;
+    size_t      index;
+    Node*       node;
+    AnswerRange range;
+};
+
+static AkinatorErrors FillMatrix(GuessMatrix* matrix, QuestionEntry* entries, size_t* entries_amt,
+                                 const tree_t* tree, error_t* error);
+static AkinatorErrors GroupQuestions(GuessMatrix* matrix, QuestionEntry* entries,
+                                     const size_t entries_amt, error_t* error);
+static int CompareQuestionEntries(const void* first, const void* second);
+
+static void   ClearCandidatesInRange(GuessMatrix* matrix, const size_t begin, const size_t end);
+static double CountExpectedEntropy(const size_t yes_amt, const size_t no_amt, const size_t total);
+static GuessQuestion* FindBestQuestion(GuessMatrix* matrix);
+
+static void ScanChunkTask(void* arg);
+static bool IsBetterQuestion(const GuessQuestion* question, const double entropy,
+                             const GuessQuestion* best_question, const double best_entropy);
+
+// hot loops are compiled twice: for any CPU and with popcnt instruction
+static void CountRanks(GuessMatrix* matrix);
+static void ScanQuestions(ScanChunk* chunk);
+
+#if defined(__x86_64__)
+static void CountRanksPopcnt(GuessMatrix* matrix);
+static void ScanQuestionsPopcnt(ScanChunk* chunk);
+#endif
+
+static inline __attribute__((always_inline)) void   CountRanksBody(GuessMatrix* matrix);
+static inline __attribute__((always_inline)) size_t CountCandidatesBefore(const GuessMatrix* matrix,
+                                                                          const size_t pos);
+static inline __attribute__((always_inline)) void   ScanQuestionsBody(ScanChunk* chunk);
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors GuessMatrixCtor(GuessMatrix* matrix, const tree_t* tree, error_t* error)
+{
+    assert(matrix);
+    assert(tree);
+    assert(error);
+
+    TRACE_SPAN("GuessMatrixCtor");
+
+    *matrix = {};
+
+    TreeStats stats = {};
+    TreeCountStats(tree, &stats);
+
+    const size_t entries_amt = stats.nodes - stats.leaves;
+
+    matrix->words_amt  = (stats.leaves + WORD_BITS - 1) / WORD_BITS;
+    matrix->objects    = (Node**)    MemCalloc(MEM_INDEXES, stats.leaves + 1,     sizeof(Node*));
+    matrix->candidates = (uint64_t*) MemCalloc(MEM_INDEXES, matrix->words_amt + 1, sizeof(uint64_t));
+    matrix->ranks      = (size_t*)   MemCalloc(MEM_INDEXES, matrix->words_amt + 1, sizeof(size_t));
+
+    QuestionEntry* entries = (QuestionEntry*) MemCalloc(MEM_INDEXES, entries_amt + 1, sizeof(QuestionEntry));
+
+    if (matrix->objects == nullptr || matrix->candidates == nullptr || matrix->ranks == nullptr ||
+        entries == nullptr)
+    {
+        MemFree(entries);
+        GuessMatrixDtor(matrix);
+
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    size_t filled_amt = 0;
+
+    FillMatrix(matrix, entries, &filled_amt, tree, error);
+    if (error->code == (int) AkinatorErrors::NONE)
+        GroupQuestions(matrix, entries, filled_amt, error);
+
+    MemFree(entries);
+
+    if (error->code != (int) AkinatorErrors::NONE)
+    {
+        GuessMatrixDtor(matrix);
+        return (AkinatorErrors) error->code;
+    }
+
+    for (size_t i = 0; i < matrix->words_amt; i++)
+        matrix->candidates[i] = ~0ULL;
+
+    if (matrix->objects_amt % WORD_BITS != 0)
+        matrix->candidates[matrix->words_amt - 1] = (1ULL << (matrix->objects_amt % WORD_BITS)) - 1;
+
+    matrix->candidates_amt = matrix->objects_amt;
+
+    for (size_t i = 0; i < matrix->questions_amt; i++)
+    {
+        const GuessQuestion* question = &matrix->questions[i];
+
+        for (size_t j = 0; j < question->ranges_amt; j++)
+            matrix->active[matrix->active_amt++] = {matrix->ranges[question->first_range + j], i};
+    }
+
+    // opening question does not depend on answers, so first step of session costs nothing
+    matrix->best       = FindBestQuestion(matrix);
+    matrix->best_valid = true;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+void GuessMatrixDtor(GuessMatrix* matrix)
+{
+    assert(matrix);
+
+    MemFree(matrix->objects);
+    MemFree(matrix->questions);
+    MemFree(matrix->ranges);
+    MemFree(matrix->candidates);
+    MemFree(matrix->ranks);
+    MemFree(matrix->active);
+
+    *matrix = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+struct MatrixBuildVisitor : TreeVisitor<Node>
+{
+    static const bool VISIT_IN   = true;
+    static const bool VISIT_POST = true;
+
+    GuessMatrix*   matrix      = nullptr;
+    QuestionEntry* entries     = nullptr;
+    size_t         entries_amt = 0;
+    // entries of nodes, whose subtrees are being walked
+    Stack<size_t>* open        = nullptr;
+    bool           failed      = false;
+
+    TraverseAction pre(Node* node, const TraversePos*)
+    {
+        if (node->left == nullptr && node->right == nullptr)
+        {
+            matrix->objects[matrix->objects_amt++] = node;
+            return TRAVERSE_CONTINUE;
+        }
+
+        QuestionEntry* entry = &entries[entries_amt];
+
+        entry->text_hash   = Hash64(node->data, strlen(node->data));
+        entry->index       = entries_amt;
+        entry->node        = node;
+        entry->range.begin = matrix->objects_amt;
+
+        if (open->push(entries_amt++) != (int) ERRORS::NONE)
+        {
+            failed = true;
+            return TRAVERSE_STOP;
+        }
+
+        return TRAVERSE_CONTINUE;
+    }
+
+    TraverseAction in(Node* node, const TraversePos*)
+    {
+        if (node->left != nullptr || node->right != nullptr)
+            entries[(*open)[open->size - 1]].range.mid = matrix->objects_amt;
+
+        return TRAVERSE_CONTINUE;
+    }
+
+    TraverseAction post(Node* node, const TraversePos*)
+    {
+        if (node->left != nullptr || node->right != nullptr)
+        {
+            size_t entry_index = 0;
+            open->pop(&entry_index);
+
+            entries[entry_index].range.end = matrix->objects_amt;
+        }
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors FillMatrix(GuessMatrix* matrix, QuestionEntry* entries, size_t* entries_amt,
+                                 const tree_t* tree, error_t* error)
+{
+    assert(matrix);
+    assert(entries);
+    assert(entries_amt);
+    assert(tree);
+    assert(error);
+
+    Stack<size_t> open;
+    open.init();
+
+    MatrixBuildVisitor visitor = {};
+    visitor.matrix  = matrix;
+    visitor.entries = entries;
+    visitor.open    = &open;
+
+    TreeErrors traverse_error = TraverseNodes(tree->root, &visitor);
+
+    open.destroy();
+
+    if (traverse_error != TreeErrors::NONE || visitor.failed)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    *entries_amt = visitor.entries_amt;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors GroupQuestions(GuessMatrix* matrix, QuestionEntry* entries,
+                                     const size_t entries_amt, error_t* error)
+{
+    assert(matrix);
+    assert(entries);
+    assert(error);
+
+    // same questions become neighbours, first node of question stays first
+    qsort(entries, entries_amt, sizeof(QuestionEntry), CompareQuestionEntries);
+
+    matrix->ranges    = (AnswerRange*)   MemCalloc(MEM_INDEXES, entries_amt + 1, sizeof(AnswerRange));
+    matrix->questions = (GuessQuestion*) MemCalloc(MEM_INDEXES, entries_amt + 1, sizeof(GuessQuestion));
+    matrix->active    = (ActiveRange*)   MemCalloc(MEM_INDEXES, entries_amt + 1, sizeof(ActiveRange));
+
+    if (matrix->ranges == nullptr || matrix->questions == nullptr || matrix->active == nullptr)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    for (size_t i = 0; i < entries_amt; i++)
+    {
+        const bool same_question = (i > 0 && entries[i].text_hash == entries[i - 1].text_hash &&
+                                    strcmp(entries[i].node->data, entries[i - 1].node->data) == 0);
+
+        if (!same_question)
+            matrix->questions[matrix->questions_amt++] = {entries[i].node, i, 0};
+
+        matrix->questions[matrix->questions_amt - 1].ranges_amt++;
+        matrix->ranges[i] = entries[i].range;
+    }
+
+    matrix->ranges_amt = entries_amt;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+static int CompareQuestionEntries(const void* first, const void* second)
+{
+    assert(first);
+    assert(second);
+
+    const QuestionEntry* entry_1 = (const QuestionEntry*) first;
+    const QuestionEntry* entry_2 = (const QuestionEntry*) second;
+
+    if (entry_1->text_hash != entry_2->text_hash)
+        return (entry_1->text_hash < entry_2->text_hash) ? -1 : 1;
+
+    int text_cmp = strcmp(entry_1->node->data, entry_2->node->data);
+    if (text_cmp != 0)
+        return text_cmp;
+
+    return (entry_1->index < entry_2->index) ? -1 : (entry_1->index > entry_2->index);
+}
+
+//---------------------------------------------------------------------------------------
+
+GuessQuestion* GuessMatrixBestQuestion(GuessMatrix* matrix)
+{
+    assert(matrix);
+
+    if (!matrix->best_valid)
+    {
+        matrix->best       = FindBestQuestion(matrix);
+        matrix->best_valid = true;
+    }
+
+    return matrix->best;
+}
+
+//---------------------------------------------------------------------------------------
+
+static GuessQuestion* FindBestQuestion(GuessMatrix* matrix)
+{
+    assert(matrix);
+
+    TRACE_SPAN("GuessMatrixBestQuestion");
+
+    if (matrix->candidates_amt < 2)
+        return nullptr;
+
+    CountRanks(matrix);
+
+    size_t chunks_amt = 1;
+
+    if (matrix->active_amt >= PARALLEL_SCAN_MIN_QUESTIONS)
+        chunks_amt = (TaskThreadsAmt() * 4 < MAX_SCAN_CHUNKS) ? TaskThreadsAmt() * 4 : MAX_SCAN_CHUNKS;
+
+    ScanChunk chunks[MAX_SCAN_CHUNKS] = {};
+
+    size_t chunk_begin = 0;
+
+    for (size_t i = 0; i < chunks_amt; i++)
+    {
+        size_t chunk_end = matrix->active_amt * (i + 1) / chunks_amt;
+        if (chunk_end < chunk_begin)
+            chunk_end = chunk_begin;
+
+        // ranges of one question are never split between chunks
+        while (chunk_end > 0 && chunk_end < matrix->active_amt &&
+               matrix->active[chunk_end].question == matrix->active[chunk_end - 1].question)
+            chunk_end++;
+
+        chunks[i] = {matrix, chunk_begin, chunk_end, 0, nullptr, 0};
+        chunk_begin = chunk_end;
+    }
+
+    TaskGroup group = {};
+
+    for (size_t i = 1; i < chunks_amt; i++)
+        TaskSpawn(&group, ScanChunkTask, &chunks[i]);
+
+    ScanChunkTask(&chunks[0]);
+    TaskWait(&group);
+
+    // kept ranges of chunks are glued together, so next scan is shorter
+    GuessQuestion* best_question = chunks[0].best;
+    double         best_entropy  = chunks[0].best_entropy;
+    size_t         kept_amt      = chunks[0].kept_amt;
+
+    for (size_t i = 1; i < chunks_amt; i++)
+    {
+        memmove(matrix->active + kept_amt, matrix->active + chunks[i].begin,
+                chunks[i].kept_amt * sizeof(ActiveRange));
+        kept_amt += chunks[i].kept_amt;
+
+        if (IsBetterQuestion(chunks[i].best, chunks[i].best_entropy, best_question, best_entropy))
+        {
+            best_question = chunks[i].best;
+            best_entropy  = chunks[i].best_entropy;
+        }
+    }
+
+    matrix->active_amt = kept_amt;
+
+    return best_question;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void ScanChunkTask(void* arg)
+{
+    assert(arg);
+
+#if defined(__x86_64__)
+    static const bool HAS_POPCNT = __builtin_cpu_supports("popcnt");
+
+    if (HAS_POPCNT)
+    {
+        ScanQuestionsPopcnt((ScanChunk*) arg);
+        return;
+    }
+#endif
+
+    ScanQuestions((ScanChunk*) arg);
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool IsBetterQuestion(const GuessQuestion* question, const double entropy,
+                             const GuessQuestion* best_question, const double best_entropy)
+{
+    if (question == nullptr)
+        return false;
+
+    if (best_question == nullptr || entropy < best_entropy)
+        return true;
+
+    // ties go to question met first in tree, so choice does not depend on order of scan
+    return entropy <= best_entropy && question->first_range < best_question->first_range;
+}
+
+//---------------------------------------------------------------------------------------
+
+void GuessMatrixAnswer(GuessMatrix* matrix, GuessQuestion* question, const bool answer)
+{
+    assert(matrix);
+    assert(question);
+
+    // objects with opposite answer are dropped, objects with unknown answer stay
+    for (size_t i = 0; i < question->ranges_amt; i++)
+    {
+        const AnswerRange* range = &matrix->ranges[question->first_range + i];
+
+        if (answer)
+            ClearCandidatesInRange(matrix, range->mid, range->end);
+        else
+            ClearCandidatesInRange(matrix, range->begin, range->mid);
+    }
+
+    CountRanks(matrix);
+    matrix->candidates_amt = matrix->ranks[matrix->words_amt];
+    matrix->best_valid     = false;
+}
+
+//---------------------------------------------------------------------------------------
+
+GuessQuestion* GuessMatrixFindQuestion(const GuessMatrix* matrix, const char* text)
+{
+    assert(matrix);
+    assert(text);
+
+    // questions are sorted by text hash and text by GroupQuestions
+    const hash_t text_hash = Hash64(text, strlen(text));
+
+    size_t left  = 0;
+    size_t right = matrix->questions_amt;
+
+    while (left < right)
+    {
+        const size_t middle = left + (right - left) / 2;
+        const char*  middle_text = matrix->questions[middle].node->data;
+        const hash_t middle_hash = Hash64(middle_text, strlen(middle_text));
+
+        int cmp = (middle_hash != text_hash) ? ((middle_hash < text_hash) ? -1 : 1) : strcmp(middle_text, text);
+
+        if (cmp == 0)
+            return &matrix->questions[middle];
+
+        if (cmp < 0)
+            left = middle + 1;
+        else
+            right = middle;
+    }
+
+    return nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+
+size_t GuessMatrixFirstObject(const GuessMatrix* matrix)
+{
+    assert(matrix);
+
+    for (size_t i = 0; i < matrix->words_amt; i++)
+    {
+        if (matrix->candidates[i] != 0)
+            return i * WORD_BITS + (size_t) __builtin_ctzll(matrix->candidates[i]);
+    }
+
+    return SIZE_MAX;
+}
+
+//---------------------------------------------------------------------------------------
+
+void GuessMatrixDropObject(GuessMatrix* matrix, const size_t object)
+{
+    assert(matrix);
+    assert(object < matrix->objects_amt);
+
+    const uint64_t bit = 1ULL << (object % WORD_BITS);
+
+    if ((matrix->candidates[object / WORD_BITS] & bit) != 0)
+    {
+        matrix->candidates[object / WORD_BITS] &= ~bit;
+        matrix->candidates_amt--;
+        matrix->best_valid = false;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+static void CountRanks(GuessMatrix* matrix)
+{
+    assert(matrix);
+
+#if defined(__x86_64__)
+    static const bool HAS_POPCNT = __builtin_cpu_supports("popcnt");
+
+    if (HAS_POPCNT)
+    {
+        CountRanksPopcnt(matrix);
+        return;
+    }
+#endif
+
+    CountRanksBody(matrix);
+}
+
+//---------------------------------------------------------------------------------------
+
+static void ScanQuestions(ScanChunk* chunk)
+{
+    ScanQuestionsBody(chunk);
+}
+
+//---------------------------------------------------------------------------------------
+
+#if defined(__x86_64__)
+__attribute__((target("popcnt")))
+static void CountRanksPopcnt(GuessMatrix* matrix)
+{
+    CountRanksBody(matrix);
+}
+
+//---------------------------------------------------------------------------------------
+
+__attribute__((target("popcnt")))
+static void ScanQuestionsPopcnt(ScanChunk* chunk)
+{
+    ScanQuestionsBody(chunk);
+}
+#endif
+
+//---------------------------------------------------------------------------------------
+
+static inline void CountRanksBody(GuessMatrix* matrix)
+{
+    assert(matrix);
+
+    for (size_t i = 0; i < matrix->words_amt; i++)
+        matrix->ranks[i + 1] = matrix->ranks[i] + (size_t) __builtin_popcountll(matrix->candidates[i]);
+}
+
+//---------------------------------------------------------------------------------------
+
+static inline void ScanQuestionsBody(ScanChunk* chunk)
+{
+    assert(chunk);
+
+    GuessMatrix* matrix = chunk->matrix;
+    ActiveRange* active = matrix->active;
+
+    size_t index = chunk->begin;
+
+    while (index < chunk->end)
+    {
+        const size_t question_index = active[index].question;
+        const size_t kept_before    = chunk->kept_amt;
+
+        size_t yes_amt = 0;
+        size_t no_amt  = 0;
+
+        for (; index < chunk->end && active[index].question == question_index; index++)
+        {
+            const AnswerRange* range = &active[index].range;
+
+            const size_t before_begin = CountCandidatesBefore(matrix, range->begin);
+            const size_t before_mid   = CountCandidatesBefore(matrix, range->mid);
+            const size_t before_end   = CountCandidatesBefore(matrix, range->end);
+
+            // candidates never come back, so range without them is dropped for the rest of session
+            if (before_begin == before_end)
+                continue;
+
+            yes_amt += before_mid - before_begin;
+            no_amt  += before_end - before_mid;
+
+            active[chunk->begin + chunk->kept_amt++] = active[index];
+        }
+
+        // question, that does not split candidates, will never split them (asked ones too)
+        if (yes_amt == 0 || no_amt == 0)
+        {
+            chunk->kept_amt = kept_before;
+            continue;
+        }
+
+        GuessQuestion* question = &matrix->questions[question_index];
+        double         entropy  = CountExpectedEntropy(yes_amt, no_amt, matrix->candidates_amt);
+
+        if (IsBetterQuestion(question, entropy, chunk->best, chunk->best_entropy))
+        {
+            chunk->best         = question;
+            chunk->best_entropy = entropy;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+static inline size_t CountCandidatesBefore(const GuessMatrix* matrix, const size_t pos)
+{
+    // ones in previous words and lower bits of its word
+    const uint64_t mask = (1ULL << (pos % WORD_BITS)) - 1;
+
+    return matrix->ranks[pos / WORD_BITS] + (size_t) __builtin_popcountll(matrix->candidates[pos / WORD_BITS] & mask);
+}
+
+//---------------------------------------------------------------------------------------
+
+static void ClearCandidatesInRange(GuessMatrix* matrix, const size_t begin, const size_t end)
+{
+    assert(matrix);
+    assert(begin <= end);
+
+    if (begin == end)
+        return;
+
+    const size_t first_word = begin / WORD_BITS;
+    const size_t last_word  = (end - 1) / WORD_BITS;
+
+    const uint64_t first_mask = ~0ULL << (begin % WORD_BITS);
+    const uint64_t last_mask  = ~0ULL >> (WORD_BITS - 1 - (end - 1) % WORD_BITS);
+
+    if (first_word == last_word)
+    {
+        matrix->candidates[first_word] &= ~(first_mask & last_mask);
+        return;
+    }
+
+    matrix->candidates[first_word] &= ~first_mask;
+
+    // whole words are cleared by memset, which is vectorized
+    memset(matrix->candidates + first_word + 1, 0, (last_word - first_word - 1) * sizeof(uint64_t));
+
+    matrix->candidates[last_word] &= ~last_mask;
+}
+
+//---------------------------------------------------------------------------------------
+
+static double CountExpectedEntropy(const size_t yes_amt, const size_t no_amt, const size_t total)
+{
+    // objects with unknown answer stay after any answer and make both answers equally likely
+    const size_t unknown_amt = (yes_amt + no_amt < total) ? total - yes_amt - no_amt : 0;
+
+    const double yes_left = (double) (yes_amt + unknown_amt);
+    const double no_left  = (double) (no_amt  + unknown_amt);
+
+    const double yes_prob = ((double) yes_amt + (double) unknown_amt / 2) / (double) total;
+
+    // information gain is log2(total) minus this value, so min of it is max of gain
+    return yes_prob * log2(yes_left) + (1 - yes_prob) * log2(no_left);
+}
@@ -0,0 +1,79 @@
+#ifndef __GUESS_MATRIX_H_
+#define __GUESS_MATRIX_H_
+
+#include <stdint.h>
+
+#include "akinator.h"
+
+// Object-by-question answer matrix derived from tree.
+//
+// Objects (leaves) are numbered in DFS order, so objects with "yes" answer to some question node
+// are one range and objects with "no" answer are the next one. Question that appears in several
+// nodes has a range pair for each of them. Objects outside of ranges have unknown answer.
+
+struct AnswerRange
+{
+    // "yes" objects are [begin, mid), "no" objects are [mid, end)
+    size_t begin;
+    size_t mid;
+    size_t end;
+};
+
+struct GuessQuestion
+{
+    // first node with question text (it is asked)
+    Node*  node;
+    size_t first_range;
+    size_t ranges_amt;
+};
+
+struct ActiveRange
+{
+    AnswerRange range;
+    size_t      question;
+};
+
+struct GuessMatrix
+{
+    Node** objects;
+    size_t objects_amt;
+
+    GuessQuestion* questions;
+    size_t         questions_amt;
+
+    AnswerRange* ranges;
+    size_t       ranges_amt;
+
+    // objects, that still match all answers
+    uint64_t* candidates;
+    size_t    words_amt;
+    size_t    candidates_amt;
+
+    // candidates before every word of bitset, so candidates in range are counted in O(1)
+    size_t* ranks;
+
+    // ranges with candidates of questions, that still split candidates. They are scanned
+    // one after another, ranges of one question are neighbours
+    ActiveRange* active;
+    size_t       active_amt;
+
+    // best question for current candidates (opening question is found by constructor)
+    GuessQuestion* best;
+    bool           best_valid;
+};
+
+AkinatorErrors GuessMatrixCtor(GuessMatrix* matrix, const tree_t* tree, error_t* error);
+void           GuessMatrixDtor(GuessMatrix* matrix);
+
+// returns question with max information gain over candidates (nullptr if no question splits them)
+GuessQuestion* GuessMatrixBestQuestion(GuessMatrix* matrix);
+void           GuessMatrixAnswer(GuessMatrix* matrix, GuessQuestion* question, const bool answer);
+
+// question with this text (nullptr if tree has no such question), O(log questions)
+GuessQuestion* GuessMatrixFindQuestion(const GuessMatrix* matrix, const char* text);
+
+// returns first candidate (SIZE_MAX if there are no candidates)
+size_t         GuessMatrixFirstObject(const GuessMatrix* matrix);
+void           GuessMatrixDropObject(GuessMatrix* matrix, const size_t object);
+
+#endif
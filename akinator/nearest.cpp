@@ -0,0 +1,105 @@
+#include <assert.h>
+
+#include "nearest.h"
+#include "tree/traversal.h"
+#include "common/trace.h"
+#include "common/memory.h"
+
+static bool TakeObjects(const Node* subtree, const size_t same_answers, const size_t take_amt,
+                        NearestObject* nearest, size_t* nearest_amt);
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors FindNearestObjects(const tree_t* tree, const path_t* path, const size_t k,
+                                  NearestObject* nearest, size_t* nearest_amt, error_t* error)
+{
+    assert(tree);
+    assert(tree->root);
+    assert(path);
+    assert(nearest);
+    assert(nearest_amt);
+    assert(error);
+
+    TRACE_SPAN("FindNearestObjects");
+
+    *nearest_amt = 0;
+
+    const size_t depth = path->size;
+
+    // nodes[i] is i-th node on path, nodes[depth] is object
+    const Node** nodes = (const Node**) MemCalloc(MEM_INDEXES, depth + 1, sizeof(const Node*));
+    if (nodes == nullptr)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    nodes[0] = tree->root;
+
+    for (size_t i = 0; i < depth; i++)
+        nodes[i + 1] = (path->data[i] == LEFT_STEP) ? nodes[i]->left : nodes[i]->right;
+
+    for (size_t i = depth; i > 0 && *nearest_amt < k; i--)
+    {
+        const Node* parent  = nodes[i - 1];
+        const Node* sibling = (path->data[i - 1] == LEFT_STEP) ? parent->right : parent->left;
+
+        if (sibling == nullptr)
+            continue;
+
+        // whole interval is taken, if it fits, otherwise only its beginning is walked
+        const size_t left_amt = k - *nearest_amt;
+        const size_t take_amt = (sibling->subtree.leaves < left_amt) ? sibling->subtree.leaves : left_amt;
+
+        if (!TakeObjects(sibling, i - 1, take_amt, nearest, nearest_amt))
+        {
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            break;
+        }
+    }
+
+    MemFree(nodes);
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct TakeObjectsVisitor : TreeVisitor<const Node>
+{
+    NearestObject* nearest      = nullptr;
+    size_t*        nearest_amt  = nullptr;
+    size_t         same_answers = 0;
+    size_t         left_amt     = 0;
+
+    TraverseAction pre(const Node* node, const TraversePos*)
+    {
+        if (node->left != nullptr || node->right != nullptr)
+            return TRAVERSE_CONTINUE;
+
+        nearest[(*nearest_amt)++] = {node, same_answers};
+
+        return (--left_amt == 0) ? TRAVERSE_STOP : TRAVERSE_CONTINUE;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+static bool TakeObjects(const Node* subtree, const size_t same_answers, const size_t take_amt,
+                        NearestObject* nearest, size_t* nearest_amt)
+{
+    assert(subtree);
+    assert(nearest);
+    assert(nearest_amt);
+
+    if (take_amt == 0)
+        return true;
+
+    TakeObjectsVisitor visitor = {};
+    visitor.nearest      = nearest;
+    visitor.nearest_amt  = nearest_amt;
+    visitor.same_answers = same_answers;
+    visitor.left_amt     = take_amt;
+
+    return TraverseNodes(subtree, &visitor) == TreeErrors::NONE;
+}
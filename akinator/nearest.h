@@ -0,0 +1,26 @@
+#ifndef __NEAREST_H_
+#define __NEAREST_H_
+
+#include "akinator.h"
+
+// Objects, that share the longest prefix of answers with given object.
+//
+// Objects under sibling of the i-th node on path to object answer first i questions the same way,
+// and objects are numbered in DFS order, so every sibling subtree is one interval of objects with
+// known length (leaves of its subtree stats). Siblings are taken from the deepest one, and only
+// intervals, that are needed, are walked, so query costs O(depth + k) instead of whole tree.
+
+static const size_t NEAREST_OBJECTS_DEFAULT_AMT = 5;
+
+struct NearestObject
+{
+    const Node* node;
+    // questions from root, that are answered the same way
+    size_t      same_answers;
+};
+
+// nearest must have room for k objects, they go from the nearest one
+AkinatorErrors FindNearestObjects(const tree_t* tree, const path_t* path, const size_t k,
+                                  NearestObject* nearest, size_t* nearest_amt, error_t* error);
+
+#endif
@@ -0,0 +1,558 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "node_stats.h"
+#include "tree/traversal.h"
+#include "stack/hash.h"
+#include "common/input_and_output.h"
+#include "common/trace.h"
+#include "common/memory.h"
+
+// distinct places in shard of one thread (power of two)
+static const size_t SHARD_CAPACITY = 64;
+// dead branches printed by name
+static const size_t PRINTED_DEAD_BRANCHES = 5;
+
+struct ShardEntry
+{
+    // the same as key of NodeStatsSlot
+    size_t             key;
+    unsigned long long yes;
+    unsigned long long no;
+};
+
+struct StatsShard
+{
+    NodeStats* owner;
+    size_t     used;
+    ShardEntry entries[SHARD_CAPACITY];
+};
+
+static thread_local StatsShard SHARD = {};
+
+// line of stats file
+struct SavedCounts
+{
+    hash_t      text_hash;
+    char*       text;
+    size_t      line;
+    NodeCounts  counts;
+    bool        used;
+};
+
+static size_t         HashKey(const size_t key);
+static NodeStatsSlot* FindSlot(NodeStats* stats, const size_t key, const bool insert);
+
+static void           GetStatsFileName(const char* data_file, char* stats_file);
+static AkinatorErrors ReadSavedCounts(FILE* fp, SavedCounts** saved, size_t* saved_amt, error_t* error);
+static int            CompareSavedCounts(const void* first, const void* second);
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors NodeStatsCtor(NodeStats* stats, const tree_t* tree, error_t* error)
+{
+    assert(stats);
+    assert(tree);
+    assert(error);
+
+    TreeStats tree_stats = {};
+    TreeCountStats(tree, &tree_stats);
+
+    // half of table stays free, so probes are short; guess mode adds two nodes per game
+    size_t capacity = SHARD_CAPACITY;
+    while (capacity < 2 * (tree_stats.nodes + 2))
+        capacity *= 2;
+
+    stats->slots = (NodeStatsSlot*) MemCalloc(MEM_INDEXES, capacity, sizeof(NodeStatsSlot));
+    if (stats->slots == nullptr)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    stats->capacity = capacity;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+void NodeStatsDtor(NodeStats* stats)
+{
+    assert(stats);
+
+    if (SHARD.owner == stats)
+        SHARD = {};
+
+    MemFree(stats->slots);
+
+    stats->slots    = nullptr;
+    stats->capacity = 0;
+}
+
+//---------------------------------------------------------------------------------------
+
+void NodeStatsAnswer(NodeStats* stats, const size_t place, const bool answer)
+{
+    assert(stats);
+
+    if (SHARD.owner != stats)
+    {
+        NodeStatsFlush(SHARD.owner);
+        SHARD.owner = stats;
+    }
+
+    if (SHARD.used >= SHARD_CAPACITY / 2)
+        NodeStatsFlush(stats);
+
+    const size_t key   = place + 1;
+    size_t       index = HashKey(key) & (SHARD_CAPACITY - 1);
+
+    while (SHARD.entries[index].key != 0 && SHARD.entries[index].key != key)
+        index = (index + 1) & (SHARD_CAPACITY - 1);
+
+    ShardEntry* entry = &SHARD.entries[index];
+
+    if (entry->key == 0)
+    {
+        entry->key = key;
+        SHARD.used++;
+    }
+
+    if (answer)
+        entry->yes++;
+    else
+        entry->no++;
+}
+
+//---------------------------------------------------------------------------------------
+
+void NodeStatsFlush(NodeStats* stats)
+{
+    if (stats == nullptr || SHARD.owner != stats)
+        return;
+
+    for (size_t i = 0; i < SHARD_CAPACITY && SHARD.used > 0; i++)
+    {
+        ShardEntry* entry = &SHARD.entries[i];
+
+        if (entry->key == 0)
+            continue;
+
+        // answers are dropped only if nodes were added after table was made for much more than twice
+        NodeStatsSlot* slot = FindSlot(stats, entry->key, true);
+        if (slot != nullptr)
+        {
+            slot->yes.fetch_add(entry->yes, std::memory_order_relaxed);
+            slot->no.fetch_add(entry->no, std::memory_order_relaxed);
+        }
+
+        *entry = {};
+        SHARD.used--;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+size_t NodeStatsChildPlace(const Node* node, const size_t place, const bool left)
+{
+    assert(node);
+
+    if (left || node->left == nullptr)
+        return place + 1;
+
+    // right subtree goes after whole left one, shared nodes of it are counted for every path too
+    return place + 1 + node->left->subtree.nodes;
+}
+
+//---------------------------------------------------------------------------------------
+
+static size_t HashKey(const size_t key)
+{
+    // places of one game are far from each other, so high bits of product are taken, not low ones
+    return (size_t) (((uint64_t) key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+//---------------------------------------------------------------------------------------
+
+static NodeStatsSlot* FindSlot(NodeStats* stats, const size_t key, const bool insert)
+{
+    assert(stats);
+    assert(key != 0);
+
+    size_t index = HashKey(key) & (stats->capacity - 1);
+
+    for (size_t probe = 0; probe < stats->capacity; probe++)
+    {
+        NodeStatsSlot* slot = &stats->slots[index];
+
+        size_t slot_key = slot->key.load(std::memory_order_acquire);
+
+        if (slot_key == key)
+            return slot;
+
+        if (slot_key == 0)
+        {
+            if (!insert)
+                return nullptr;
+
+            // other thread may take the same free slot, then its key is checked as usual
+            if (slot->key.compare_exchange_strong(slot_key, key, std::memory_order_acq_rel) ||
+                slot_key == key)
+                return slot;
+        }
+
+        index = (index + 1) & (stats->capacity - 1);
+    }
+
+    return nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct SaveCountsVisitor : TreeVisitor<const Node>
+{
+    FILE*             fp     = nullptr;
+    NodeStats*        stats  = nullptr;
+    const NodeCounts* counts = nullptr;
+    size_t            index  = 0;
+
+    TraverseAction pre(const Node* node, const TraversePos*)
+    {
+        // index is prefix place of node, so every place of shared node gets only its own answers
+        NodeCounts node_counts = counts[index];
+
+        NodeStatsSlot* slot = FindSlot(stats, index + 1, false);
+        if (slot != nullptr)
+        {
+            node_counts.yes += slot->yes.load(std::memory_order_relaxed);
+            node_counts.no  += slot->no.load(std::memory_order_relaxed);
+        }
+
+        index++;
+
+        fprintf(fp, "%llu %llu " PRINT_NODE "\n", node_counts.yes, node_counts.no, node->data);
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors NodeStatsSave(NodeStats* stats, const tree_t* tree, const char* data_file, error_t* error)
+{
+    assert(stats);
+    assert(tree);
+    assert(data_file);
+    assert(error);
+
+    TRACE_SPAN("NodeStatsSave");
+
+    NodeStatsFlush(stats);
+
+    NodeCounts* counts = nullptr;
+
+    NodeStatsLoad(tree, data_file, &counts, error);
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+    char stats_file[MAX_STRING_LEN + sizeof(".stats")] = {};
+    GetStatsFileName(data_file, stats_file);
+
+    FILE* fp = fopen(stats_file, "w");
+    if (fp == nullptr)
+    {
+        MemFree(counts);
+
+        error->code = (int) AkinatorErrors::DATA_FILE;
+        error->data = data_file;
+        return AkinatorErrors::DATA_FILE;
+    }
+
+    SaveCountsVisitor visitor = {};
+    visitor.fp     = fp;
+    visitor.stats  = stats;
+    visitor.counts = counts;
+
+    TreeErrors traverse_error = TraverseNodes((const Node*) tree->root, &visitor);
+
+    fclose(fp);
+    MemFree(counts);
+
+    if (traverse_error != TreeErrors::NONE)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    // answers are in file now, so next save does not add them again
+    for (size_t i = 0; i < stats->capacity; i++)
+    {
+        stats->slots[i].yes.store(0, std::memory_order_relaxed);
+        stats->slots[i].no.store(0, std::memory_order_relaxed);
+    }
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct MatchCountsVisitor : TreeVisitor<const Node>
+{
+    SavedCounts* saved     = nullptr;
+    size_t       saved_amt = 0;
+    NodeCounts*  counts    = nullptr;
+    size_t       index     = 0;
+
+    TraverseAction pre(const Node* node, const TraversePos*)
+    {
+        const SavedCounts key = {Hash64(node->data, strlen(node->data)), node->data, 0, {}, false};
+
+        size_t left  = 0;
+        size_t right = saved_amt;
+
+        while (left < right)
+        {
+            size_t mid = left + (right - left) / 2;
+
+            if (CompareSavedCounts(&saved[mid], &key) < 0)
+                left = mid + 1;
+            else
+                right = mid;
+        }
+
+        // lines with the same text are sorted by line number, k-th node takes k-th line
+        while (left < saved_amt && saved[left].used && saved[left].text_hash == key.text_hash &&
+               strcmp(saved[left].text, key.text) == 0)
+            left++;
+
+        if (left < saved_amt && saved[left].text_hash == key.text_hash && strcmp(saved[left].text, key.text) == 0)
+        {
+            counts[index] = saved[left].counts;
+            saved[left].used = true;
+        }
+
+        index++;
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors NodeStatsLoad(const tree_t* tree, const char* data_file, NodeCounts** counts, error_t* error)
+{
+    assert(tree);
+    assert(data_file);
+    assert(counts);
+    assert(error);
+
+    TreeStats tree_stats = {};
+    TreeCountStats(tree, &tree_stats);
+
+    *counts = (NodeCounts*) MemCalloc(MEM_INDEXES, tree_stats.nodes + 1, sizeof(NodeCounts));
+    if (*counts == nullptr)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    char stats_file[MAX_STRING_LEN + sizeof(".stats")] = {};
+    GetStatsFileName(data_file, stats_file);
+
+    // there are no answers before first game
+    FILE* fp = fopen(stats_file, "r");
+    if (fp == nullptr)
+        return AkinatorErrors::NONE;
+
+    SavedCounts* saved     = nullptr;
+    size_t       saved_amt = 0;
+
+    ReadSavedCounts(fp, &saved, &saved_amt, error);
+    fclose(fp);
+
+    if (error->code == (int) AkinatorErrors::NONE)
+    {
+        qsort(saved, saved_amt, sizeof(SavedCounts), CompareSavedCounts);
+
+        MatchCountsVisitor visitor = {};
+        visitor.saved     = saved;
+        visitor.saved_amt = saved_amt;
+        visitor.counts    = *counts;
+
+        if (TraverseNodes((const Node*) tree->root, &visitor) != TreeErrors::NONE)
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    for (size_t i = 0; i < saved_amt; i++)
+        MemFree(saved[i].text);
+
+    MemFree(saved);
+
+    if (error->code != (int) AkinatorErrors::NONE)
+    {
+        MemFree(*counts);
+        *counts = nullptr;
+    }
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void GetStatsFileName(const char* data_file, char* stats_file)
+{
+    assert(data_file);
+    assert(stats_file);
+
+    snprintf(stats_file, MAX_STRING_LEN + sizeof(".stats"), "%s%s", data_file, NODE_STATS_FILE_EXT);
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors ReadSavedCounts(FILE* fp, SavedCounts** saved, size_t* saved_amt, error_t* error)
+{
+    assert(fp);
+    assert(saved);
+    assert(saved_amt);
+    assert(error);
+
+    size_t capacity = SHARD_CAPACITY;
+
+    *saved     = (SavedCounts*) MemCalloc(MEM_INDEXES, capacity, sizeof(SavedCounts));
+    *saved_amt = 0;
+
+    if (*saved == nullptr)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    NodeCounts counts = {};
+    char text[MAX_STRING_LEN] = {};
+
+    while (fscanf(fp, " %llu %llu \"%99[^\"]\"", &counts.yes, &counts.no, text) == 3)
+    {
+        if (*saved_amt == capacity)
+        {
+            SavedCounts* grown = (SavedCounts*) MemRealloc(MEM_INDEXES,
+                                                           *saved, 2 * capacity * sizeof(SavedCounts));
+            if (grown == nullptr)
+            {
+                error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+                return AkinatorErrors::ALLOCATE_MEMORY;
+            }
+
+            *saved    = grown;
+            capacity *= 2;
+        }
+
+        char* line_text = MemStrdup(MEM_STRINGS, text);
+        if (line_text == nullptr)
+        {
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            return AkinatorErrors::ALLOCATE_MEMORY;
+        }
+
+        (*saved)[*saved_amt] = {Hash64(text, strlen(text)), line_text, *saved_amt, counts, false};
+        (*saved_amt)++;
+    }
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+static int CompareSavedCounts(const void* first, const void* second)
+{
+    const SavedCounts* counts_1 = (const SavedCounts*) first;
+    const SavedCounts* counts_2 = (const SavedCounts*) second;
+
+    if (counts_1->text_hash != counts_2->text_hash)
+        return (counts_1->text_hash < counts_2->text_hash) ? -1 : 1;
+
+    int text_cmp = strcmp(counts_1->text, counts_2->text);
+    if (text_cmp != 0)
+        return text_cmp;
+
+    if (counts_1->line != counts_2->line)
+        return (counts_1->line < counts_2->line) ? -1 : 1;
+
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct DeadBranchVisitor : TreeVisitor<const Node>
+{
+    FILE*             fp     = nullptr;
+    const NodeCounts* counts = nullptr;
+    size_t            index  = 0;
+
+    size_t asked_nodes    = 0;
+    size_t reached_leaves = 0;
+    size_t leaves         = 0;
+    size_t dead_branches  = 0;
+
+    // depth of dead branch root, that is being walked (SIZE_MAX if walk is not in dead branch)
+    size_t dead_depth = SIZE_MAX;
+
+    TraverseAction pre(const Node* node, const TraversePos* pos)
+    {
+        const NodeCounts* node_counts = &counts[index++];
+        const bool        asked       = node_counts->yes + node_counts->no > 0;
+        const bool        is_leaf     = node->left == nullptr && node->right == nullptr;
+
+        if (pos->depth <= dead_depth)
+            dead_depth = SIZE_MAX;
+
+        leaves         += is_leaf;
+        asked_nodes    += asked;
+        reached_leaves += is_leaf && asked;
+
+        // parent of every node outside dead branch was asked, so unasked node starts new one
+        if (!asked && pos->depth > 0 && dead_depth == SIZE_MAX)
+        {
+            if (dead_branches < PRINTED_DEAD_BRANCHES)
+                fprintf(fp, "dead branch:    " PRINT_NODE "\n", node->data);
+
+            dead_branches++;
+            dead_depth = pos->depth;
+        }
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+void NodeStatsPrint(FILE* fp, const tree_t* tree, const char* data_file)
+{
+    assert(fp);
+    assert(tree);
+    assert(data_file);
+
+    error_t     error  = {};
+    NodeCounts* counts = nullptr;
+
+    if (tree->root == nullptr || NodeStatsLoad(tree, data_file, &counts, &error) != AkinatorErrors::NONE)
+        return;
+
+    fprintf(fp, "========================== ANSWERS ===========================\n");
+
+    DeadBranchVisitor visitor = {};
+    visitor.fp     = fp;
+    visitor.counts = counts;
+
+    TraverseNodes((const Node*) tree->root, &visitor);
+
+    fprintf(fp, "games:          %llu\n"
+                "asked nodes:    %zu\n"
+                "reached leaves: %zu / %zu\n"
+                "dead branches:  %zu\n",
+                counts[0].yes + counts[0].no, visitor.asked_nodes,
+                visitor.reached_leaves, visitor.leaves, visitor.dead_branches);
+
+    MemFree(counts);
+}
@@ -0,0 +1,61 @@
+#ifndef __NODE_STATS_H_
+#define __NODE_STATS_H_
+
+#include <atomic>
+
+#include "akinator.h"
+
+// Answers given to every node. "Is it ...?" is asked for leaves too, so answers of leaf are its hits
+// (yes - right guesses, no - wrong ones).
+//
+// Counts are kept in stats file next to data file, not in it. Every line is `yes no "text"`, lines go
+// in prefix order of tree. Node gets counts of line with the same text and the same number among
+// nodes with this text, so counts survive new nodes added by guess mode.
+//
+// Answers are counted per place of node in tree, not per node: place is number of node in prefix
+// order, where node shared by hash-consing is met once for every path to it (as in TreeStats::nodes).
+// So shared node keeps separate counts for every place, exactly like the same tree without sharing,
+// and stats file has one line for every place.
+
+static const char* const NODE_STATS_FILE_EXT = ".stats";
+
+struct NodeCounts
+{
+    unsigned long long yes;
+    unsigned long long no;
+};
+
+struct NodeStatsSlot
+{
+    // prefix place of node + 1 (0 - free slot)
+    std::atomic<size_t>             key;
+    std::atomic<unsigned long long> yes;
+    std::atomic<unsigned long long> no;
+};
+
+// answers of current session. Every thread counts answers in its own shard and merges shard here
+// without locks, when shard is full or flushed, so counting answer never waits for other threads
+struct NodeStats
+{
+    NodeStatsSlot* slots;
+    size_t         capacity;
+};
+
+AkinatorErrors NodeStatsCtor(NodeStats* stats, const tree_t* tree, error_t* error);
+void           NodeStatsDtor(NodeStats* stats);
+
+// place is prefix number of node, root has 0 (see NodeStatsChildPlace)
+void           NodeStatsAnswer(NodeStats* stats, const size_t place, const bool answer);
+// prefix number of left or right child of node with this place
+size_t         NodeStatsChildPlace(const Node* node, const size_t place, const bool left);
+// merges shard of calling thread (other threads must flush their shards before save)
+void           NodeStatsFlush(NodeStats* stats);
+
+// adds answers of session to stats file of data file
+AkinatorErrors NodeStatsSave(NodeStats* stats, const tree_t* tree, const char* data_file, error_t* error);
+// counts from stats file for every node of tree in prefix order (array is freed with MemFree)
+AkinatorErrors NodeStatsLoad(const tree_t* tree, const char* data_file, NodeCounts** counts, error_t* error);
+// games, visited nodes and dead branches (subtrees, whose question was never asked)
+void           NodeStatsPrint(FILE* fp, const tree_t* tree, const char* data_file);
+
+#endif
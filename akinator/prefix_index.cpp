@@ -0,0 +1,384 @@
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "prefix_index.h"
+#include "tree/traversal.h"
+#include "common/input_and_output.h"
+#include "common/trace.h"
+#include "common/memory.h"
+
+static const size_t ENTRIES_START_CAPACITY = 64;
+
+static AkinatorErrors BuildIndex(PrefixIndex* index, const tree_t* tree, error_t* error);
+static void           DropAddedEntries(PrefixIndex* index);
+static void           ClearIndex(PrefixIndex* index);
+
+static AkinatorErrors MakeEntry(PrefixEntry* entry, const char* name, error_t* error);
+static size_t         LowerBound(const PrefixIndex* index, const PrefixEntry* entry);
+static size_t         FoldName(const char* name, char* key);
+static int            CompareEntries(const void* first, const void* second);
+
+//---------------------------------------------------------------------------------------
+
+void PrefixIndexCtor(PrefixIndex* index)
+{
+    assert(index);
+
+    *index = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+void PrefixIndexDtor(PrefixIndex* index)
+{
+    assert(index);
+
+    ClearIndex(index);
+
+    MemFree(index->entries);
+
+    *index = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors PrefixIndexSync(PrefixIndex* index, tree_t* tree, error_t* error)
+{
+    assert(index);
+    assert(tree);
+    assert(error);
+
+    const hash_t tree_hash = TreeRootHash(tree);
+
+    if (index->built && tree_hash == index->expected_hash)
+    {
+        for (size_t i = 0; i < index->entries_amt && index->added_amt > 0; i++)
+        {
+            if (index->entries[i].added)
+                index->added_amt--;
+
+            index->entries[i].added = false;
+        }
+    }
+    else if (index->built && tree_hash == index->tree_hash)
+    {
+        // learned tree was not saved
+        DropAddedEntries(index);
+    }
+    else
+    {
+        BuildIndex(index, tree, error);
+        RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+    }
+
+    index->tree_hash     = tree_hash;
+    index->expected_hash = tree_hash;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors PrefixIndexInsert(PrefixIndex* index, const char* name, error_t* error)
+{
+    assert(index);
+    assert(name);
+    assert(error);
+
+    if (index->entries_amt == index->capacity)
+    {
+        const size_t capacity = (index->capacity > 0) ? 2 * index->capacity : ENTRIES_START_CAPACITY;
+        PrefixEntry* entries  = (PrefixEntry*) MemRealloc(MEM_INDEXES,
+                                                          index->entries, capacity * sizeof(PrefixEntry));
+        if (entries == nullptr)
+        {
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            return AkinatorErrors::ALLOCATE_MEMORY;
+        }
+
+        index->entries  = entries;
+        index->capacity = capacity;
+    }
+
+    PrefixEntry entry = {};
+
+    MakeEntry(&entry, name, error);
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+    entry.added = true;
+
+    const size_t position = LowerBound(index, &entry);
+
+    memmove(index->entries + position + 1, index->entries + position,
+            (index->entries_amt - position) * sizeof(PrefixEntry));
+
+    index->entries[position] = entry;
+    index->entries_amt++;
+    index->added_amt++;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+void PrefixIndexExpectTree(PrefixIndex* index, tree_t* tree)
+{
+    assert(index);
+    assert(tree);
+
+    index->expected_hash = TreeRootHash(tree);
+}
+
+//---------------------------------------------------------------------------------------
+
+void PrefixIndexComplete(const PrefixIndex* index, const char* prefix, size_t* first, size_t* amt)
+{
+    assert(index);
+    assert(prefix);
+    assert(first);
+    assert(amt);
+
+    char         key[MAX_STRING_LEN + 1] = {};
+    const size_t len                     = FoldName(prefix, key);
+
+    // the first key not less than prefix
+    size_t left  = 0;
+    size_t right = index->entries_amt;
+
+    while (left < right)
+    {
+        const size_t middle = left + (right - left) / 2;
+
+        if (strcmp(index->entries[middle].key, key) < 0)
+            left = middle + 1;
+        else
+            right = middle;
+    }
+
+    *first = left;
+
+    // the first key after it, that does not start with prefix
+    right = index->entries_amt;
+
+    while (left < right)
+    {
+        const size_t middle = left + (right - left) / 2;
+
+        if (strncmp(index->entries[middle].key, key, len) <= 0)
+            left = middle + 1;
+        else
+            right = middle;
+    }
+
+    *amt = left - *first;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct PrefixIndexVisitor : TreeVisitor<const Node>
+{
+    PrefixIndex* index = nullptr;
+    error_t*     error = nullptr;
+
+    TraverseAction pre(const Node* node, const TraversePos*)
+    {
+        if (node->left != nullptr || node->right != nullptr)
+            return TRAVERSE_CONTINUE;
+
+        MakeEntry(&index->entries[index->entries_amt], node->data, error);
+        if (error->code != (int) AkinatorErrors::NONE)
+            return TRAVERSE_STOP;
+
+        index->entries_amt++;
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors BuildIndex(PrefixIndex* index, const tree_t* tree, error_t* error)
+{
+    assert(index);
+    assert(tree);
+    assert(error);
+
+    TRACE_SPAN("PrefixIndex build");
+
+    ClearIndex(index);
+
+    index->built = true;
+
+    if (tree->root == nullptr)
+        return AkinatorErrors::NONE;
+
+    const size_t leaves_amt = tree->root->subtree.leaves;
+
+    if (index->capacity < leaves_amt)
+    {
+        MemFree(index->entries);
+
+        // guess mode inserts one object at a time, so there is place for some of them
+        index->capacity = leaves_amt + ENTRIES_START_CAPACITY;
+        index->entries  = (PrefixEntry*) MemCalloc(MEM_INDEXES, index->capacity, sizeof(PrefixEntry));
+
+        if (index->entries == nullptr)
+        {
+            index->capacity = 0;
+
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            return AkinatorErrors::ALLOCATE_MEMORY;
+        }
+    }
+
+    PrefixIndexVisitor visitor = {};
+    visitor.index = index;
+    visitor.error = error;
+
+    if (TraverseNodes(tree->root, &visitor) != TreeErrors::NONE)
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+
+    if (error->code != (int) AkinatorErrors::NONE)
+    {
+        // half made index is made again by next sync
+        ClearIndex(index);
+        return (AkinatorErrors) error->code;
+    }
+
+    qsort(index->entries, index->entries_amt, sizeof(PrefixEntry), CompareEntries);
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void DropAddedEntries(PrefixIndex* index)
+{
+    assert(index);
+
+    if (index->added_amt == 0)
+        return;
+
+    size_t kept_amt = 0;
+
+    for (size_t i = 0; i < index->entries_amt; i++)
+    {
+        if (index->entries[i].added)
+            MemFree(index->entries[i].key);
+        else
+            index->entries[kept_amt++] = index->entries[i];
+    }
+
+    index->entries_amt = kept_amt;
+    index->added_amt   = 0;
+}
+
+//---------------------------------------------------------------------------------------
+
+// frees texts, but keeps array
+static void ClearIndex(PrefixIndex* index)
+{
+    assert(index);
+
+    for (size_t i = 0; i < index->entries_amt; i++)
+    {
+        MemFree(index->entries[i].key);
+        index->entries[i] = {};
+    }
+
+    index->entries_amt = 0;
+    index->added_amt   = 0;
+    index->built       = false;
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors MakeEntry(PrefixEntry* entry, const char* name, error_t* error)
+{
+    assert(entry);
+    assert(name);
+    assert(error);
+
+    const size_t size = strlen(name) + 1;
+
+    char* texts = (char*) MemCalloc(MEM_STRINGS, 2 * size, sizeof(char));
+    if (texts == nullptr)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    for (size_t i = 0; i < size; i++)
+        texts[i] = (char) tolower((unsigned char) name[i]);
+
+    memcpy(texts + size, name, size);
+
+    *entry = {};
+    entry->key  = texts;
+    entry->name = texts + size;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+// position of the first entry not less than this one
+static size_t LowerBound(const PrefixIndex* index, const PrefixEntry* entry)
+{
+    assert(index);
+    assert(entry);
+
+    size_t left  = 0;
+    size_t right = index->entries_amt;
+
+    while (left < right)
+    {
+        const size_t middle = left + (right - left) / 2;
+
+        if (CompareEntries(&index->entries[middle], entry) < 0)
+            left = middle + 1;
+        else
+            right = middle;
+    }
+
+    return left;
+}
+
+//---------------------------------------------------------------------------------------
+
+// key is name in lower case, returns its length (not more than MAX_STRING_LEN)
+static size_t FoldName(const char* name, char* key)
+{
+    assert(name);
+    assert(key);
+
+    size_t len = 0;
+
+    while (name[len] != '\0' && len < MAX_STRING_LEN)
+    {
+        key[len] = (char) tolower((unsigned char) name[len]);
+        len++;
+    }
+
+    key[len] = '\0';
+
+    return len;
+}
+
+//---------------------------------------------------------------------------------------
+
+// names, that differ only by case, are sorted by their own bytes
+static int CompareEntries(const void* first, const void* second)
+{
+    assert(first);
+    assert(second);
+
+    const PrefixEntry* entry_1 = (const PrefixEntry*) first;
+    const PrefixEntry* entry_2 = (const PrefixEntry*) second;
+
+    const int keys_order = strcmp(entry_1->key, entry_2->key);
+
+    return (keys_order != 0) ? keys_order : strcmp(entry_1->name, entry_2->name);
+}
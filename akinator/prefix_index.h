@@ -0,0 +1,50 @@
+#ifndef __PREFIX_INDEX_H_
+#define __PREFIX_INDEX_H_
+
+#include "akinator.h"
+
+// Sorted array of object names for completions: name typed with '*' at the end is prefix.
+//
+// Keys are names in lower case (bytes of UTF-8 letters are kept), so names with one prefix are one
+// range of array, it is found by two binary searches. Index lives for whole session like word index:
+// it is made again only after reading of other tree, and guess mode inserts its new object.
+
+// completions, that are listed at once
+static const size_t MAX_COMPLETIONS_NAMED = 10;
+
+struct PrefixEntry
+{
+    // both texts are in one block, key goes first
+    char* key;
+    char* name;
+    // inserted by guess mode after last sync, dropped if tree is not saved
+    bool  added;
+};
+
+struct PrefixIndex
+{
+    PrefixEntry* entries;
+    size_t       entries_amt;
+    size_t       capacity;
+    size_t       added_amt;
+
+    // merkle hashes of tree, that index is made for, and of tree with inserted objects
+    hash_t       tree_hash;
+    hash_t       expected_hash;
+    bool         built;
+};
+
+void           PrefixIndexCtor(PrefixIndex* index);
+void           PrefixIndexDtor(PrefixIndex* index);
+
+// makes index again, if tree is not the one index is made for (called after every reading,
+// tree is hashed here, if it is not hashed yet)
+AkinatorErrors PrefixIndexSync(PrefixIndex* index, tree_t* tree, error_t* error);
+AkinatorErrors PrefixIndexInsert(PrefixIndex* index, const char* name, error_t* error);
+// objects were inserted for changes of tree already, so this tree (hashed here, if needed) keeps them
+void           PrefixIndexExpectTree(PrefixIndex* index, tree_t* tree);
+
+// completions are entries[first .. first + amt), case is ignored
+void           PrefixIndexComplete(const PrefixIndex* index, const char* prefix, size_t* first, size_t* amt);
+
+#endif
@@ -0,0 +1,641 @@
+#include <assert.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "question_index.h"
+#include "stack/hash.h"
+#include "common/trace.h"
+#include "common/memory.h"
+
+enum QueryToken
+{
+    TOKEN_END  = 0,
+    TOKEN_AND  = 1,
+    TOKEN_OR   = 2,
+    TOKEN_NOT  = 3,
+    TOKEN_TEXT = 4
+};
+
+struct QueryKeyword
+{
+    const char* word;
+    QueryToken  token;
+};
+
+static const QueryKeyword KEYWORDS[] =
+{
+    {"and", TOKEN_AND},
+    {"or",  TOKEN_OR},
+    {"not", TOKEN_NOT}
+};
+
+static const size_t KEYWORDS_AMT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+
+static AkinatorErrors BuildIndex(QuestionIndex* index, const tree_t* tree, error_t* error);
+static bool           CopyTexts(QuestionIndex* index, const GuessMatrix* matrix);
+static size_t         FillQuestionRuns(QuestionIndex* index, const GuessMatrix* matrix,
+                                       const GuessQuestion* question, const bool answer);
+static int            CompareRuns(const void* first, const void* second);
+
+static bool   ObjectSetReserve(ObjectSet* set, const size_t capacity);
+static bool   ObjectSetCopy(const ObjectSet* set, ObjectSet* result);
+static bool   ObjectSetAnd(const ObjectSet* set_1, const ObjectSet* set_2, ObjectSet* result);
+static bool   ObjectSetOr(const ObjectSet* set_1, const ObjectSet* set_2, ObjectSet* result);
+static void   ObjectSetPush(ObjectSet* set, const ObjectRun run);
+static void   ObjectSetSwap(ObjectSet* set_1, ObjectSet* set_2);
+
+static const QuestionRuns*  FindQuestion(const QuestionIndex* index, const char* text);
+static QueryToken           PeekToken(const char* query, size_t* len);
+static bool                 ReadTerm(const char** query, char* term);
+static const char*          SkipQuerySpaces(const char* query);
+
+//---------------------------------------------------------------------------------------
+
+void QuestionIndexCtor(QuestionIndex* index)
+{
+    assert(index);
+
+    *index = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+void QuestionIndexDtor(QuestionIndex* index)
+{
+    assert(index);
+
+    MemFree(index->questions);
+    MemFree(index->runs);
+    MemFree(index->names);
+    MemFree(index->texts);
+
+    *index = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+// runs are taken from guess matrix, that is dropped after it, because it points to nodes of tree
+static AkinatorErrors BuildIndex(QuestionIndex* index, const tree_t* tree, error_t* error)
+{
+    assert(index);
+    assert(tree);
+    assert(error);
+
+    TRACE_SPAN("QuestionIndex build");
+
+    QuestionIndexDtor(index);
+
+    GuessMatrix matrix = {};
+
+    GuessMatrixCtor(&matrix, tree, error);
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+    index->questions = (QuestionRuns*) MemCalloc(MEM_INDEXES, matrix.questions_amt + 1, sizeof(QuestionRuns));
+    index->runs      = (ObjectRun*)    MemCalloc(MEM_INDEXES, 2 * matrix.ranges_amt + 1, sizeof(ObjectRun));
+    index->names     = (const char**)  MemCalloc(MEM_INDEXES, matrix.objects_amt + 1, sizeof(const char*));
+
+    if (index->questions == nullptr || index->runs == nullptr || index->names == nullptr ||
+        !CopyTexts(index, &matrix))
+    {
+        GuessMatrixDtor(&matrix);
+        QuestionIndexDtor(index);
+
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    for (size_t i = 0; i < matrix.questions_amt; i++)
+    {
+        QuestionRuns* question = &index->questions[i];
+
+        for (int answer = 0; answer < 2; answer++)
+        {
+            question->first[answer] = index->runs_amt;
+            question->amt[answer]   = FillQuestionRuns(index, &matrix, &matrix.questions[i], answer);
+
+            index->runs_amt += question->amt[answer];
+        }
+    }
+
+    GuessMatrixDtor(&matrix);
+
+    index->built = true;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+// texts of questions and names of objects are copied in one block in order of matrix
+static bool CopyTexts(QuestionIndex* index, const GuessMatrix* matrix)
+{
+    assert(index);
+    assert(matrix);
+
+    size_t texts_size = 0;
+
+    for (size_t i = 0; i < matrix->questions_amt; i++)
+        texts_size += strlen(matrix->questions[i].node->data) + 1;
+
+    for (size_t i = 0; i < matrix->objects_amt; i++)
+        texts_size += strlen(matrix->objects[i]->data) + 1;
+
+    index->texts = (char*) MemCalloc(MEM_STRINGS, texts_size + 1, sizeof(char));
+    if (index->texts == nullptr)
+        return false;
+
+    char* text = index->texts;
+
+    for (size_t i = 0; i < matrix->questions_amt; i++)
+    {
+        const size_t len = strlen(matrix->questions[i].node->data);
+        memcpy(text, matrix->questions[i].node->data, len + 1);
+
+        index->questions[i].text = text;
+        index->questions[i].hash = Hash64(text, len);
+
+        text += len + 1;
+    }
+
+    index->questions_amt = matrix->questions_amt;
+
+    for (size_t i = 0; i < matrix->objects_amt; i++)
+    {
+        const size_t size = strlen(matrix->objects[i]->data) + 1;
+        memcpy(text, matrix->objects[i]->data, size);
+
+        index->names[i] = text;
+        text += size;
+    }
+
+    index->objects_amt = matrix->objects_amt;
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+// writes runs of question after index->runs_amt, returns their amount
+static size_t FillQuestionRuns(QuestionIndex* index, const GuessMatrix* matrix,
+                               const GuessQuestion* question, const bool answer)
+{
+    assert(index);
+    assert(matrix);
+    assert(question);
+
+    ObjectRun* runs     = index->runs + index->runs_amt;
+    size_t     runs_amt = 0;
+
+    for (size_t i = 0; i < question->ranges_amt; i++)
+    {
+        const AnswerRange* range = &matrix->ranges[question->first_range + i];
+
+        ObjectRun run = answer ? ObjectRun{range->begin, range->mid} : ObjectRun{range->mid, range->end};
+
+        if (run.begin < run.end)
+            runs[runs_amt++] = run;
+    }
+
+    // question, that is asked again in its own subtree, has nested runs
+    if (runs_amt > 1)
+        qsort(runs, runs_amt, sizeof(ObjectRun), CompareRuns);
+
+    size_t merged_amt = 0;
+
+    for (size_t i = 0; i < runs_amt; i++)
+    {
+        if (merged_amt > 0 && runs[i].begin <= runs[merged_amt - 1].end)
+        {
+            if (runs[i].end > runs[merged_amt - 1].end)
+                runs[merged_amt - 1].end = runs[i].end;
+        }
+        else
+            runs[merged_amt++] = runs[i];
+    }
+
+    return merged_amt;
+}
+
+//---------------------------------------------------------------------------------------
+
+static int CompareRuns(const void* first, const void* second)
+{
+    assert(first);
+    assert(second);
+
+    const ObjectRun* run_1 = (const ObjectRun*) first;
+    const ObjectRun* run_2 = (const ObjectRun*) second;
+
+    return (run_1->begin > run_2->begin) - (run_1->begin < run_2->begin);
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors QuestionIndexQuery(QuestionIndex* index, tree_t* tree, const char* query, ObjectSet* result,
+                                  QueryError* query_error, error_t* error)
+{
+    assert(index);
+    assert(tree);
+    assert(query);
+    assert(result);
+    assert(query_error);
+    assert(error);
+
+    TRACE_SPAN("QuestionIndexQuery");
+
+    *result      = {};
+    *query_error = {};
+
+    const hash_t tree_hash = TreeRootHash(tree);
+
+    if (!index->built || index->tree_hash != tree_hash)
+    {
+        BuildIndex(index, tree, error);
+        RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+        index->tree_hash = tree_hash;
+    }
+
+    // every term is shorter than query
+    char* term = (char*) MemCalloc(MEM_STRINGS, strlen(query) + 1, sizeof(char));
+    if (term == nullptr)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    ObjectSet conjunction = {};
+    ObjectSet temp        = {};
+    bool      first_term  = true;
+    bool      allocated   = true;
+
+    while (allocated)
+    {
+        size_t token_len = 0;
+        bool   answer    = true;
+
+        query = SkipQuerySpaces(query);
+
+        while (PeekToken(query, &token_len) == TOKEN_NOT)
+        {
+            answer = !answer;
+            query  = SkipQuerySpaces(query + token_len);
+        }
+
+        const char* term_start = query;
+
+        if (!ReadTerm(&query, term))
+        {
+            *query_error = {QUERY_SYNTAX, term_start, strlen(term_start)};
+            break;
+        }
+
+        const QuestionRuns* question = FindQuestion(index, term);
+        if (question == nullptr)
+        {
+            // quotes are not part of property
+            const size_t quotes_amt = (*term_start == '"') ? 1 : 0;
+
+            *query_error = {QUERY_UNKNOWN_PROPERTY, term_start + quotes_amt,
+                            (size_t) (query - term_start) - 2 * quotes_amt};
+            break;
+        }
+
+        // runs of index are only read, so set looks at them without copy
+        const ObjectSet term_set = {index->runs + question->first[answer], question->amt[answer], 0};
+
+        allocated = first_term ? ObjectSetCopy(&term_set, &temp) : ObjectSetAnd(&conjunction, &term_set, &temp);
+        ObjectSetSwap(&conjunction, &temp);
+        first_term = false;
+
+        query = SkipQuerySpaces(query);
+
+        QueryToken token = PeekToken(query, &token_len);
+        query += token_len;
+
+        if (token == TOKEN_AND)
+            continue;
+
+        if (token != TOKEN_OR && token != TOKEN_END)
+        {
+            *query_error = {QUERY_SYNTAX, query, strlen(query)};
+            break;
+        }
+
+        allocated = allocated && ObjectSetOr(result, &conjunction, &temp);
+        ObjectSetSwap(result, &temp);
+        first_term = true;
+
+        if (token == TOKEN_END)
+            break;
+    }
+
+    ObjectSetDtor(&conjunction);
+    ObjectSetDtor(&temp);
+    MemFree(term);
+
+    if (!allocated)
+    {
+        ObjectSetDtor(result);
+
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    // half of answer is not an answer
+    if (query_error->code != QUERY_NONE)
+        ObjectSetDtor(result);
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+// exact text is found by binary search, other case by scan of all questions
+static const QuestionRuns* FindQuestion(const QuestionIndex* index, const char* text)
+{
+    assert(index);
+    assert(text);
+
+    const hash_t text_hash = Hash64(text, strlen(text));
+
+    size_t left  = 0;
+    size_t right = index->questions_amt;
+
+    while (left < right)
+    {
+        const size_t        middle   = left + (right - left) / 2;
+        const QuestionRuns* question = &index->questions[middle];
+
+        int cmp = (question->hash != text_hash) ? ((question->hash < text_hash) ? -1 : 1) :
+                                                  strcmp(question->text, text);
+
+        if (cmp == 0)
+            return question;
+
+        if (cmp < 0)
+            left = middle + 1;
+        else
+            right = middle;
+    }
+
+    for (size_t i = 0; i < index->questions_amt; i++)
+    {
+        if (!strcasecmp(index->questions[i].text, text))
+            return &index->questions[i];
+    }
+
+    return nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+
+static QueryToken PeekToken(const char* query, size_t* len)
+{
+    assert(query);
+    assert(len);
+
+    *len = 1;
+
+    switch (*query)
+    {
+        case '\0':  *len = 0; return TOKEN_END;
+        case '!':   return TOKEN_NOT;
+        case '&':   *len = (query[1] == '&') ? 2 : 1; return TOKEN_AND;
+        case '|':   *len = (query[1] == '|') ? 2 : 1; return TOKEN_OR;
+        default:    break;
+    }
+
+    for (size_t i = 0; i < KEYWORDS_AMT; i++)
+    {
+        const size_t word_len = strlen(KEYWORDS[i].word);
+        const char   after    = query[word_len];
+
+        // keyword is whole word, "order" is a text
+        if (!strncasecmp(query, KEYWORDS[i].word, word_len) &&
+            (after == '\0' || isspace((unsigned char) after) || strchr("\"!&|", after) != nullptr))
+        {
+            *len = word_len;
+            return KEYWORDS[i].token;
+        }
+    }
+
+    *len = 0;
+    return TOKEN_TEXT;
+}
+
+//---------------------------------------------------------------------------------------
+
+// term is quoted text or plain words up to keyword, false if there is no term
+static bool ReadTerm(const char** query, char* term)
+{
+    assert(query);
+    assert(*query);
+    assert(term);
+
+    const char* text = *query;
+
+    if (*text == '"')
+    {
+        const char* closing = strchr(text + 1, '"');
+        if (closing == nullptr || closing == text + 1)
+            return false;
+
+        memcpy(term, text + 1, (size_t) (closing - text - 1));
+        term[closing - text - 1] = '\0';
+
+        *query = closing + 1;
+        return true;
+    }
+
+    size_t token_len = 0;
+    size_t term_len  = 0;
+
+    while (PeekToken(text, &token_len) == TOKEN_TEXT && *text != '"')
+    {
+        if (term_len > 0)
+            term[term_len++] = ' ';
+
+        while (*text != '\0' && !isspace((unsigned char) *text) && strchr("\"&|", *text) == nullptr)
+            term[term_len++] = *text++;
+
+        *query = text;
+        text   = SkipQuerySpaces(text);
+    }
+
+    term[term_len] = '\0';
+
+    return term_len > 0;
+}
+
+//---------------------------------------------------------------------------------------
+
+static const char* SkipQuerySpaces(const char* query)
+{
+    assert(query);
+
+    while (isspace((unsigned char) *query))
+        query++;
+
+    return query;
+}
+
+//---------------------------------------------------------------------------------------
+
+size_t ObjectSetCount(const ObjectSet* set)
+{
+    assert(set);
+
+    size_t objects_amt = 0;
+
+    for (size_t i = 0; i < set->runs_amt; i++)
+        objects_amt += set->runs[i].end - set->runs[i].begin;
+
+    return objects_amt;
+}
+
+//---------------------------------------------------------------------------------------
+
+void ObjectSetDtor(ObjectSet* set)
+{
+    assert(set);
+
+    MemFree(set->runs);
+
+    *set = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool ObjectSetReserve(ObjectSet* set, const size_t capacity)
+{
+    assert(set);
+
+    set->runs_amt = 0;
+
+    if (capacity <= set->capacity)
+        return true;
+
+    ObjectRun* new_runs = (ObjectRun*) MemRealloc(MEM_INDEXES, set->runs, capacity * sizeof(ObjectRun));
+    if (new_runs == nullptr)
+        return false;
+
+    set->runs     = new_runs;
+    set->capacity = capacity;
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool ObjectSetCopy(const ObjectSet* set, ObjectSet* result)
+{
+    assert(set);
+    assert(result);
+
+    if (!ObjectSetReserve(result, set->runs_amt + 1))
+        return false;
+
+    if (set->runs_amt > 0)
+        memcpy(result->runs, set->runs, set->runs_amt * sizeof(ObjectRun));
+
+    result->runs_amt = set->runs_amt;
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool ObjectSetAnd(const ObjectSet* set_1, const ObjectSet* set_2, ObjectSet* result)
+{
+    assert(set_1);
+    assert(set_2);
+    assert(result);
+
+    // every intersection ends where one of runs ends
+    if (!ObjectSetReserve(result, set_1->runs_amt + set_2->runs_amt + 1))
+        return false;
+
+    size_t i = 0;
+    size_t j = 0;
+
+    while (i < set_1->runs_amt && j < set_2->runs_amt)
+    {
+        const ObjectRun run_1 = set_1->runs[i];
+        const ObjectRun run_2 = set_2->runs[j];
+
+        const size_t begin = (run_1.begin > run_2.begin) ? run_1.begin : run_2.begin;
+        const size_t end   = (run_1.end   < run_2.end)   ? run_1.end   : run_2.end;
+
+        if (begin < end)
+            ObjectSetPush(result, {begin, end});
+
+        if (run_1.end < run_2.end)
+            i++;
+        else
+            j++;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool ObjectSetOr(const ObjectSet* set_1, const ObjectSet* set_2, ObjectSet* result)
+{
+    assert(set_1);
+    assert(set_2);
+    assert(result);
+
+    if (!ObjectSetReserve(result, set_1->runs_amt + set_2->runs_amt + 1))
+        return false;
+
+    size_t i = 0;
+    size_t j = 0;
+
+    while (i < set_1->runs_amt || j < set_2->runs_amt)
+    {
+        const bool take_first = (j == set_2->runs_amt ||
+                                 (i < set_1->runs_amt && set_1->runs[i].begin <= set_2->runs[j].begin));
+
+        ObjectSetPush(result, take_first ? set_1->runs[i++] : set_2->runs[j++]);
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+// run must not start before last run, touching and overlapping runs are merged
+static void ObjectSetPush(ObjectSet* set, const ObjectRun run)
+{
+    assert(set);
+    assert(set->runs_amt < set->capacity);
+
+    if (set->runs_amt > 0 && run.begin <= set->runs[set->runs_amt - 1].end)
+    {
+        ObjectRun* last = &set->runs[set->runs_amt - 1];
+
+        if (run.end > last->end)
+            last->end = run.end;
+
+        return;
+    }
+
+    set->runs[set->runs_amt++] = run;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void ObjectSetSwap(ObjectSet* set_1, ObjectSet* set_2)
+{
+    assert(set_1);
+    assert(set_2);
+
+    ObjectSet temp = *set_1;
+
+    *set_1 = *set_2;
+    *set_2 = temp;
+}
@@ -0,0 +1,91 @@
+#ifndef __QUESTION_INDEX_H_
+#define __QUESTION_INDEX_H_
+
+#include "akinator.h"
+#include "guess_matrix.h"
+
+// Index of objects by answers to questions for set queries like "hockey player and not from Krasnodar".
+//
+// Objects are numbered in DFS order (like in guess matrix), so objects with "yes" answer to one
+// question node are one run of numbers, and objects with "no" answer are the next run. Every set
+// is sorted list of disjoint runs, AND and OR merge lists in O(runs) without looking at objects.
+//
+// Query is OR of ANDs: term [and|& term]... [or|| ...]. Term is question text (in quotes or as plain
+// words), "not"/"!" before it means known "no" answer. Objects with unknown answer match neither.
+//
+// Index keeps copies of texts, so it lives for whole session like fuzzy index: it is made on first
+// query and made again only for other tree (tree with learned objects has other merkle hash).
+
+// set query mode names only first objects of big sets
+static const size_t MAX_FOUND_OBJECTS_NAMED = 32;
+
+struct ObjectRun
+{
+    // objects [begin, end)
+    size_t begin;
+    size_t end;
+};
+
+struct ObjectSet
+{
+    ObjectRun* runs;
+    size_t     runs_amt;
+    size_t     capacity;
+};
+
+struct QuestionRuns
+{
+    const char* text;
+    hash_t      hash;
+
+    // runs of objects with this answer are runs[first[answer] .. first[answer] + amt[answer])
+    size_t      first[2];
+    size_t      amt[2];
+};
+
+struct QuestionIndex
+{
+    // sorted by hash and text of question like questions of guess matrix
+    QuestionRuns* questions;
+    size_t        questions_amt;
+
+    ObjectRun*    runs;
+    size_t        runs_amt;
+
+    // names[i] is name of i-th object in DFS order, texts of questions and names are in one block
+    const char**  names;
+    size_t        objects_amt;
+    char*         texts;
+
+    // merkle hash of tree, that index is made for
+    hash_t        tree_hash;
+    bool          built;
+};
+
+enum QueryErrors
+{
+    QUERY_NONE             = 0,
+    QUERY_SYNTAX           = 1,
+    QUERY_UNKNOWN_PROPERTY = 2
+};
+
+struct QueryError
+{
+    QueryErrors code;
+    // bad part of query text
+    const char* text;
+    size_t      len;
+};
+
+void           QuestionIndexCtor(QuestionIndex* index);
+void           QuestionIndexDtor(QuestionIndex* index);
+
+// result must be destroyed by ObjectSetDtor, query_error tells about mistakes in query. Index is
+// made again if it is not for this tree (tree is hashed here, if it is not hashed yet)
+AkinatorErrors QuestionIndexQuery(QuestionIndex* index, tree_t* tree, const char* query, ObjectSet* result,
+                                  QueryError* query_error, error_t* error);
+
+size_t         ObjectSetCount(const ObjectSet* set);
+void           ObjectSetDtor(ObjectSet* set);
+
+#endif
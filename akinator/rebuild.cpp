@@ -0,0 +1,646 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include <atomic>
+
+#include "rebuild.h"
+#include "guess_matrix.h"
+#include "tree/traversal.h"
+#include "stack/hash.h"
+#include "common/input_and_output.h"
+#include "common/trace.h"
+#include "common/memory.h"
+#include "common/tasks.h"
+
+// smaller subtrees are built by task, that has split them
+static const size_t PARALLEL_REBUILD_MIN_OBJECTS = 1 << 12;
+
+struct RebuildEntry
+{
+    size_t object;
+    double weight;
+};
+
+struct RebuildJob
+{
+    RebuildEntry* entries;
+    size_t        entries_amt;
+    Node**        slot;
+};
+
+struct RebuildContext
+{
+    const GuessMatrix* matrix;
+
+    // known answers of object i are facts[offsets[i]..offsets[i + 1]) sorted by question,
+    // fact is question * 2 + 1 for "yes" and question * 2 for "no"
+    size_t* offsets;
+    size_t* facts;
+
+    double* weights;
+    // objects, whose path does not ask the same question twice with different answers
+    bool*   reachable;
+    double  total_weight;
+
+    TaskGroup         group;
+    std::atomic<bool> failed;
+
+    RebuildStats* stats;
+
+    // tasks add their counters here when they finish
+    std::atomic<size_t> new_nodes;
+    std::atomic<size_t> lost;
+    std::atomic<double> questions_weight;
+};
+
+// answers to one question among objects of node
+struct QuestionCounter
+{
+    double yes_weight;
+    size_t yes_amt;
+    size_t no_amt;
+};
+
+// counters of all questions, reused by every node of task
+struct RebuildScratch
+{
+    QuestionCounter* counters;
+    size_t*          touched;
+};
+
+struct RebuildTaskArg
+{
+    RebuildContext* context;
+    RebuildJob      job;
+};
+
+static AkinatorErrors CollectFacts(RebuildContext* context, error_t* error);
+static void           CompactFacts(RebuildContext* context);
+static AkinatorErrors FillWeights(RebuildContext* context, const tree_t* tree, const NodeCounts* counts,
+                                  error_t* error);
+
+static void   RebuildTask(void* arg);
+static void   RebuildSubtree(RebuildContext* context, const RebuildJob* root_job);
+static bool   BuildNode(RebuildContext* context, RebuildScratch* scratch, const RebuildJob* job,
+                        UncheckedStack<RebuildJob>* jobs, RebuildStats* stats, double* questions_weight);
+static bool   BuildLeaf(RebuildContext* context, const RebuildJob* job, RebuildStats* stats);
+static bool   PushRebuildJob(RebuildContext* context, const RebuildJob* job, UncheckedStack<RebuildJob>* jobs);
+static size_t ChooseQuestion(const RebuildContext* context, RebuildScratch* scratch, const RebuildJob* job);
+static bool   FindAnswer(const RebuildContext* context, const size_t object, const size_t question);
+static double CountBinaryEntropy(const double p);
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors RebuildTree(const tree_t* tree, const NodeCounts* counts,
+                           tree_t* rebuilt, RebuildStats* stats, error_t* error)
+{
+    assert(tree);
+    assert(tree->root);
+    assert(rebuilt);
+    assert(stats);
+    assert(error);
+
+    TRACE_SPAN("RebuildTree");
+
+    *stats = {};
+
+    TreeStats tree_stats = {};
+    TreeCountStats(tree, &tree_stats);
+
+    stats->old_nodes = tree_stats.nodes;
+
+    GuessMatrix matrix = {};
+
+    GuessMatrixCtor(&matrix, tree, error);
+    RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+
+    RebuildContext context = {};
+    context.matrix = &matrix;
+    context.stats  = stats;
+
+    stats->objects = matrix.objects_amt;
+
+    RebuildJob root_job = {};
+    root_job.entries = (RebuildEntry*) MemCalloc(MEM_INDEXES, matrix.objects_amt, sizeof(RebuildEntry));
+    root_job.slot    = &rebuilt->root;
+
+    context.weights   = (double*) MemCalloc(MEM_INDEXES, matrix.objects_amt, sizeof(double));
+    context.reachable = (bool*)   MemCalloc(MEM_INDEXES, matrix.objects_amt, sizeof(bool));
+
+    if (root_job.entries == nullptr || context.weights == nullptr || context.reachable == nullptr)
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+
+    if (error->code == (int) AkinatorErrors::NONE)
+        FillWeights(&context, tree, counts, error);
+
+    if (error->code == (int) AkinatorErrors::NONE)
+        CollectFacts(&context, error);
+
+    if (error->code == (int) AkinatorErrors::NONE)
+    {
+        for (size_t i = 0; i < matrix.objects_amt; i++)
+        {
+            if (context.reachable[i])
+                root_job.entries[root_job.entries_amt++] = {i, context.weights[i]};
+        }
+
+        // root job frees its entries
+        RebuildSubtree(&context, &root_job);
+        root_job.entries = nullptr;
+
+        TaskWait(&context.group);
+
+        if (context.failed.load())
+        {
+            TreeDtor(rebuilt);
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        }
+        else
+            TreeRecountStats(rebuilt);
+
+        stats->new_nodes = context.new_nodes.load();
+        stats->lost     += context.lost.load();
+
+        // every game with object passes through questions above it, so sum of weights of nodes
+        // over all questions is expected amount of questions
+        stats->new_expected_questions = context.questions_weight.load() / context.total_weight;
+    }
+
+    MemFree(root_job.entries);
+    MemFree(context.weights);
+    MemFree(context.reachable);
+    MemFree(context.offsets);
+    MemFree(context.facts);
+    GuessMatrixDtor(&matrix);
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors CollectFacts(RebuildContext* context, error_t* error)
+{
+    assert(context);
+    assert(error);
+
+    const GuessMatrix* matrix = context->matrix;
+
+    context->offsets = (size_t*) MemCalloc(MEM_INDEXES, matrix->objects_amt + 1, sizeof(size_t));
+    size_t* fill     = (size_t*) MemCalloc(MEM_INDEXES, matrix->objects_amt + 1, sizeof(size_t));
+
+    if (context->offsets == nullptr || fill == nullptr)
+    {
+        MemFree(fill);
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    for (size_t i = 0; i < matrix->ranges_amt; i++)
+    {
+        for (size_t object = matrix->ranges[i].begin; object < matrix->ranges[i].end; object++)
+            context->offsets[object + 1]++;
+    }
+
+    for (size_t i = 0; i < matrix->objects_amt; i++)
+    {
+        context->offsets[i + 1] += context->offsets[i];
+        fill[i] = context->offsets[i];
+    }
+
+    context->facts = (size_t*) MemCalloc(MEM_INDEXES, context->offsets[matrix->objects_amt] + 1,
+                                         sizeof(size_t));
+    if (context->facts == nullptr)
+    {
+        MemFree(fill);
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    // questions are taken in order, so facts of every object are sorted at once
+    for (size_t question = 0; question < matrix->questions_amt; question++)
+    {
+        const GuessQuestion* entry = &matrix->questions[question];
+
+        for (size_t i = entry->first_range; i < entry->first_range + entry->ranges_amt; i++)
+        {
+            const AnswerRange* range = &matrix->ranges[i];
+
+            for (size_t object = range->begin; object < range->end; object++)
+                context->facts[fill[object]++] = question * 2 + (object < range->mid);
+        }
+    }
+
+    MemFree(fill);
+
+    CompactFacts(context);
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void CompactFacts(RebuildContext* context)
+{
+    assert(context);
+
+    const size_t objects_amt = context->matrix->objects_amt;
+
+    size_t* facts = context->facts;
+    size_t  write = 0;
+
+    double depth_sum = 0;
+
+    // question asked twice on path gives repeated fact. If answers differ, user with consistent
+    // answers never gets to object, so it is not put in new tree
+    for (size_t object = 0; object < objects_amt; object++)
+    {
+        const size_t begin = context->offsets[object];
+        const size_t end   = context->offsets[object + 1];
+
+        context->offsets[object] = write;
+
+        bool conflict = false;
+
+        for (size_t i = begin; i < end; i++)
+        {
+            if (i > begin && facts[i] / 2 == facts[i - 1] / 2)
+                conflict |= (facts[i] != facts[i - 1]);
+            else
+                facts[write++] = facts[i];
+        }
+
+        context->reachable[object] = !conflict;
+
+        if (conflict)
+        {
+            context->stats->lost++;
+            continue;
+        }
+
+        // every fact is question node above object, so their amount is depth of object
+        context->total_weight += context->weights[object];
+        depth_sum += context->weights[object] * (double) (end - begin);
+    }
+
+    context->offsets[objects_amt] = write;
+
+    context->stats->old_expected_questions = depth_sum / context->total_weight;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct WeightsVisitor : TreeVisitor<const Node>
+{
+    double*           weights     = nullptr;
+    const NodeCounts* counts      = nullptr;
+    size_t            index       = 0;
+    size_t            objects_amt = 0;
+
+    TraverseAction pre(const Node* node, const TraversePos*)
+    {
+        // leaves come in the same order as objects of matrix
+        if (node->left == nullptr && node->right == nullptr)
+        {
+            // hits start from one, so object, that was never guessed, is not thrown to the bottom
+            weights[objects_amt++] = 1 + (double) (counts[index].yes + counts[index].no);
+        }
+
+        index++;
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors FillWeights(RebuildContext* context, const tree_t* tree, const NodeCounts* counts,
+                                  error_t* error)
+{
+    assert(context);
+    assert(tree);
+    assert(error);
+
+    // without answer stats every object is equally popular
+    if (counts == nullptr)
+    {
+        for (size_t i = 0; i < context->matrix->objects_amt; i++)
+            context->weights[i] = 1;
+
+        return AkinatorErrors::NONE;
+    }
+
+    WeightsVisitor visitor = {};
+    visitor.weights = context->weights;
+    visitor.counts  = counts;
+
+    if (TraverseNodes((const Node*) tree->root, &visitor) != TreeErrors::NONE)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+static void RebuildTask(void* arg)
+{
+    assert(arg);
+
+    RebuildTaskArg* task = (RebuildTaskArg*) arg;
+
+    RebuildSubtree(task->context, &task->job);
+
+    MemFree(task);
+}
+
+//---------------------------------------------------------------------------------------
+
+static void RebuildSubtree(RebuildContext* context, const RebuildJob* root_job)
+{
+    assert(context);
+    assert(root_job);
+
+    const size_t questions_amt = context->matrix->questions_amt;
+
+    RebuildScratch scratch = {};
+    scratch.counters = (QuestionCounter*) MemCalloc(MEM_INDEXES, questions_amt + 1, sizeof(QuestionCounter));
+    scratch.touched  = (size_t*)          MemCalloc(MEM_INDEXES, questions_amt + 1, sizeof(size_t));
+
+    UncheckedStack<RebuildJob> jobs;
+    jobs.init();
+
+    if (scratch.counters == nullptr || scratch.touched == nullptr ||
+        jobs.push(*root_job) != (int) ERRORS::NONE)
+    {
+        context->failed.store(true);
+        MemFree(root_job->entries);
+    }
+
+    RebuildStats stats = {};
+    double questions_weight = 0;
+
+    RebuildJob job = {};
+
+    // nodes are built with own stack, so degenerate trees do not overflow call stack
+    while (jobs.size > 0)
+    {
+        jobs.pop(&job);
+
+        if (!context->failed.load(std::memory_order_relaxed) &&
+            !BuildNode(context, &scratch, &job, &jobs, &stats, &questions_weight))
+            context->failed.store(true);
+
+        MemFree(job.entries);
+    }
+
+    jobs.destroy();
+    MemFree(scratch.counters);
+    MemFree(scratch.touched);
+
+    context->new_nodes.fetch_add(stats.new_nodes);
+    context->lost.fetch_add(stats.lost);
+
+    double weight = context->questions_weight.load();
+    while (!context->questions_weight.compare_exchange_weak(weight, weight + questions_weight))
+        ;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool BuildNode(RebuildContext* context, RebuildScratch* scratch, const RebuildJob* job,
+                      UncheckedStack<RebuildJob>* jobs, RebuildStats* stats, double* questions_weight)
+{
+    assert(context);
+    assert(scratch);
+    assert(job);
+    assert(jobs);
+    assert(stats);
+    assert(questions_weight);
+
+    size_t question = SIZE_MAX;
+
+    if (job->entries_amt > 1)
+        question = ChooseQuestion(context, scratch, job);
+
+    if (question == SIZE_MAX)
+        return BuildLeaf(context, job, stats);
+
+    error_t error = {};
+
+    char* text = MemStrdup(MEM_STRINGS, context->matrix->questions[question].node->data);
+    if (text == nullptr)
+        return false;
+
+    Node* node = NodeCtor(text, nullptr, nullptr, &error);
+    if (node == nullptr)
+    {
+        MemFree(text);
+        return false;
+    }
+
+    *job->slot = node;
+    stats->new_nodes++;
+
+    RebuildJob yes_job = {nullptr, 0, &node->left};
+    RebuildJob no_job  = {nullptr, 0, &node->right};
+
+    yes_job.entries = (RebuildEntry*) MemCalloc(MEM_INDEXES, job->entries_amt, sizeof(RebuildEntry));
+    no_job.entries  = (RebuildEntry*) MemCalloc(MEM_INDEXES, job->entries_amt, sizeof(RebuildEntry));
+
+    if (yes_job.entries == nullptr || no_job.entries == nullptr)
+    {
+        MemFree(yes_job.entries);
+        MemFree(no_job.entries);
+        return false;
+    }
+
+    for (size_t i = 0; i < job->entries_amt; i++)
+    {
+        const RebuildEntry* entry = &job->entries[i];
+
+        *questions_weight += entry->weight;
+
+        if (FindAnswer(context, entry->object, question))
+            yes_job.entries[yes_job.entries_amt++] = *entry;
+        else
+            no_job.entries[no_job.entries_amt++] = *entry;
+    }
+
+    bool pushed_no = PushRebuildJob(context, &no_job, jobs);
+    if (!pushed_no)
+        MemFree(yes_job.entries);
+
+    return pushed_no && PushRebuildJob(context, &yes_job, jobs);
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool BuildLeaf(RebuildContext* context, const RebuildJob* job, RebuildStats* stats)
+{
+    assert(context);
+    assert(job);
+    assert(stats);
+
+    // objects are always separated by question of their common ancestor, so this is only
+    // for broken trees: the most popular object is kept
+    size_t kept = 0;
+
+    for (size_t i = 1; i < job->entries_amt; i++)
+    {
+        if (job->entries[i].weight > job->entries[kept].weight)
+            kept = i;
+    }
+
+    error_t error = {};
+
+    char* text = MemStrdup(MEM_STRINGS, context->matrix->objects[job->entries[kept].object]->data);
+    if (text == nullptr)
+        return false;
+
+    Node* leaf = NodeCtor(text, nullptr, nullptr, &error);
+    if (leaf == nullptr)
+    {
+        MemFree(text);
+        return false;
+    }
+
+    *job->slot = leaf;
+
+    stats->new_nodes++;
+    stats->lost += job->entries_amt - 1;
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool PushRebuildJob(RebuildContext* context, const RebuildJob* job, UncheckedStack<RebuildJob>* jobs)
+{
+    assert(context);
+    assert(job);
+    assert(jobs);
+
+    if (job->entries_amt >= PARALLEL_REBUILD_MIN_OBJECTS && TaskThreadsAmt() > 1)
+    {
+        RebuildTaskArg* task = (RebuildTaskArg*) MemCalloc(MEM_TASKS, 1, sizeof(RebuildTaskArg));
+
+        if (task != nullptr)
+        {
+            task->context = context;
+            task->job     = *job;
+
+            TaskSpawn(&context->group, RebuildTask, task);
+            return true;
+        }
+    }
+
+    if (jobs->push(*job) != (int) ERRORS::NONE)
+    {
+        MemFree(job->entries);
+        return false;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+
+static size_t ChooseQuestion(const RebuildContext* context, RebuildScratch* scratch, const RebuildJob* job)
+{
+    assert(context);
+    assert(scratch);
+    assert(job);
+
+    QuestionCounter* counters = scratch->counters;
+    size_t touched_amt  = 0;
+    double total_weight = 0;
+
+    for (size_t i = 0; i < job->entries_amt; i++)
+    {
+        const RebuildEntry* entry = &job->entries[i];
+
+        total_weight += entry->weight;
+
+        for (size_t j = context->offsets[entry->object]; j < context->offsets[entry->object + 1]; j++)
+        {
+            const size_t fact = context->facts[j];
+            QuestionCounter* counter = &counters[fact / 2];
+
+            if (counter->yes_amt == 0 && counter->no_amt == 0)
+                scratch->touched[touched_amt++] = fact / 2;
+
+            if (fact % 2 == 1)
+            {
+                counter->yes_weight += entry->weight;
+                counter->yes_amt++;
+            }
+            else
+                counter->no_amt++;
+        }
+    }
+
+    size_t best      = SIZE_MAX;
+    double best_gain = -1;
+
+    for (size_t i = 0; i < touched_amt; i++)
+    {
+        const size_t question = scratch->touched[i];
+        QuestionCounter* counter = &counters[question];
+
+        // question must be known for every object, question asked above has one answer here
+        if (counter->yes_amt + counter->no_amt == job->entries_amt &&
+            counter->yes_amt > 0 && counter->no_amt > 0)
+        {
+            const double gain = CountBinaryEntropy(counter->yes_weight / total_weight);
+
+            // ties go to smaller question index, so tree does not depend on order of tasks
+            if (gain > best_gain || (gain >= best_gain && question < best))
+            {
+                best      = question;
+                best_gain = gain;
+            }
+        }
+
+        *counter = {};
+    }
+
+    return best;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool FindAnswer(const RebuildContext* context, const size_t object, const size_t question)
+{
+    assert(context);
+
+    size_t left  = context->offsets[object];
+    size_t right = context->offsets[object + 1];
+
+    while (left < right)
+    {
+        size_t mid = left + (right - left) / 2;
+
+        if (context->facts[mid] / 2 < question)
+            left = mid + 1;
+        else
+            right = mid;
+    }
+
+    assert(left < context->offsets[object + 1] && context->facts[left] / 2 == question);
+
+    return context->facts[left] % 2 == 1;
+}
+
+//---------------------------------------------------------------------------------------
+
+static double CountBinaryEntropy(const double p)
+{
+    if (p <= 0 || p >= 1)
+        return 0;
+
+    return -p * log2(p) - (1 - p) * log2(1 - p);
+}
@@ -0,0 +1,32 @@
+#ifndef __REBUILD_H_
+#define __REBUILD_H_
+
+#include "akinator.h"
+#include "node_stats.h"
+
+// Offline rebuild of tree, that lowers expected amount of questions per game.
+//
+// Every object keeps answers, that are known from its path in old tree. Node asks question, whose
+// answer is known for every object of its subtree, and among them the one with max information gain
+// (the most even split of popularity, like in Huffman code). So new tree asks only what old tree
+// knew, and the same question met in different branches can be asked once above them.
+
+struct RebuildStats
+{
+    size_t objects;
+    size_t old_nodes;
+    size_t new_nodes;
+
+    // objects, that are reached only by contradictory answers (dropped from new tree)
+    size_t lost;
+
+    // expected amount of questions before guess (objects are weighted by popularity)
+    double old_expected_questions;
+    double new_expected_questions;
+};
+
+// popularity of objects is hits of leaves from answer stats (nullptr if every object is equally popular)
+AkinatorErrors RebuildTree(const tree_t* tree, const NodeCounts* counts,
+                           tree_t* rebuilt, RebuildStats* stats, error_t* error);
+
+#endif
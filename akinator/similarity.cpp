@@ -0,0 +1,380 @@
+#include <assert.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+#include "similarity.h"
+#include "tree/traversal.h"
+#include "common/tasks.h"
+#include "common/trace.h"
+#include "common/memory.h"
+
+// rows in one band take about so many bytes (one row at least)
+static const size_t BAND_BYTES            = 1 << 20;
+// bands counted at once for every thread, only they are kept in memory
+static const size_t WAVE_BANDS_PER_THREAD = 4;
+
+struct SimilarityBand
+{
+    const SimilarityObjects* objects;
+    uint32_t                 cell_size;
+
+    size_t                   first_row;
+    size_t                   rows_amt;
+    // rows_amt * objects_amt cells
+    char*                    cells;
+};
+
+struct NameEntry
+{
+    const char* name;
+    size_t      index;
+};
+
+static uint32_t SimilarityCellSize(const size_t height);
+static void     FillBandTask(void* arg);
+
+template <typename cell_t>
+static void     FillRows(const SimilarityObjects* objects, const size_t first_row, const size_t rows_amt,
+                         cell_t* cells);
+
+static int      CompareNameEntries(const void* first, const void* second);
+
+//---------------------------------------------------------------------------------------
+
+struct SimilarityVisitor : TreeVisitor<const Node>
+{
+    static const bool VISIT_IN = true;
+
+    SimilarityObjects* objects = nullptr;
+    // the highest node between last object and next one, it is their LCA
+    size_t             min_depth = SIZE_MAX;
+
+    TraverseAction pre(const Node* node, const TraversePos* pos)
+    {
+        if (node->left != nullptr || node->right != nullptr)
+            return TRAVERSE_CONTINUE;
+
+        if (objects->objects_amt > 0)
+            objects->lca_depths[objects->objects_amt - 1] = min_depth;
+
+        objects->objects[objects->objects_amt] = node;
+        objects->depths [objects->objects_amt] = pos->depth;
+        objects->objects_amt++;
+
+        min_depth = SIZE_MAX;
+
+        return TRAVERSE_CONTINUE;
+    }
+
+    TraverseAction in(const Node*, const TraversePos* pos)
+    {
+        if (pos->depth < min_depth)
+            min_depth = pos->depth;
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors SimilarityObjectsCtor(SimilarityObjects* objects, const tree_t* tree, error_t* error)
+{
+    assert(objects);
+    assert(tree);
+    assert(error);
+
+    TRACE_SPAN("SimilarityObjectsCtor");
+
+    *objects = {};
+
+    if (tree->root == nullptr)
+        return AkinatorErrors::NONE;
+
+    const size_t leaves_amt = tree->root->subtree.leaves;
+
+    objects->objects    = (const Node**) MemCalloc(MEM_INDEXES, leaves_amt + 1, sizeof(const Node*));
+    objects->depths     = (size_t*)      MemCalloc(MEM_INDEXES, leaves_amt + 1, sizeof(size_t));
+    objects->lca_depths = (size_t*)      MemCalloc(MEM_INDEXES, leaves_amt + 1, sizeof(size_t));
+    objects->height     = tree->root->subtree.height;
+
+    if (objects->objects == nullptr || objects->depths == nullptr || objects->lca_depths == nullptr)
+    {
+        SimilarityObjectsDtor(objects);
+
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    SimilarityVisitor visitor = {};
+    visitor.objects = objects;
+
+    if (TraverseNodes(tree->root, &visitor) != TreeErrors::NONE)
+    {
+        SimilarityObjectsDtor(objects);
+
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+void SimilarityObjectsDtor(SimilarityObjects* objects)
+{
+    assert(objects);
+
+    MemFree(objects->objects);
+    MemFree(objects->depths);
+    MemFree(objects->lca_depths);
+
+    *objects = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+const char* SimilarityObjectsSelect(SimilarityObjects* objects, char* const* names, const size_t names_amt,
+                                    error_t* error)
+{
+    assert(objects);
+    assert(names);
+    assert(error);
+
+    NameEntry* entries  = (NameEntry*) MemCalloc(MEM_INDEXES, objects->objects_amt + 1, sizeof(NameEntry));
+    bool*      selected = (bool*)      MemCalloc(MEM_INDEXES, objects->objects_amt + 1, sizeof(bool));
+
+    if (entries == nullptr || selected == nullptr)
+    {
+        MemFree(entries);
+        MemFree(selected);
+
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < objects->objects_amt; i++)
+        entries[i] = {objects->objects[i]->data, i};
+
+    qsort(entries, objects->objects_amt, sizeof(NameEntry), CompareNameEntries);
+
+    const char* unknown = nullptr;
+
+    for (size_t i = 0; i < names_amt && unknown == nullptr; i++)
+    {
+        const NameEntry  key   = {names[i], 0};
+        const NameEntry* found = (const NameEntry*) bsearch(&key, entries, objects->objects_amt,
+                                                            sizeof(NameEntry), CompareNameEntries);
+        if (found == nullptr)
+            unknown = names[i];
+        else
+            selected[found->index] = true;
+    }
+
+    if (unknown == nullptr)
+    {
+        size_t kept_amt  = 0;
+        size_t min_depth = SIZE_MAX;
+
+        // neighbours in subset get min over all neighbours between them, so arrays are compacted in place
+        for (size_t i = 0; i < objects->objects_amt; i++)
+        {
+            if (selected[i])
+            {
+                if (kept_amt > 0)
+                    objects->lca_depths[kept_amt - 1] = min_depth;
+
+                objects->objects[kept_amt] = objects->objects[i];
+                objects->depths [kept_amt] = objects->depths[i];
+                kept_amt++;
+
+                min_depth = SIZE_MAX;
+            }
+
+            if (i + 1 < objects->objects_amt && objects->lca_depths[i] < min_depth)
+                min_depth = objects->lca_depths[i];
+        }
+
+        objects->objects_amt = kept_amt;
+    }
+
+    MemFree(entries);
+    MemFree(selected);
+
+    return unknown;
+}
+
+//---------------------------------------------------------------------------------------
+
+static int CompareNameEntries(const void* first, const void* second)
+{
+    assert(first);
+    assert(second);
+
+    const NameEntry* entry_1 = (const NameEntry*) first;
+    const NameEntry* entry_2 = (const NameEntry*) second;
+
+    return strcasecmp(entry_1->name, entry_2->name);
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors SimilarityWrite(FILE* fp, const SimilarityObjects* objects, error_t* error)
+{
+    assert(fp);
+    assert(objects);
+    assert(error);
+
+    TRACE_SPAN("SimilarityWrite");
+
+    const size_t objects_amt = objects->objects_amt;
+
+    SimilarityHeader header = {};
+    header.magic       = SIMILARITY_MAGIC;
+    header.cell_size   = SimilarityCellSize(objects->height);
+    header.objects_amt = objects_amt;
+
+    for (size_t i = 0; i < objects_amt; i++)
+        header.names_size += strlen(objects->objects[i]->data) + 1;
+
+    fwrite(&header, sizeof(header), 1, fp);
+
+    for (size_t i = 0; i < objects_amt; i++)
+        fwrite(objects->objects[i]->data, sizeof(char), strlen(objects->objects[i]->data) + 1, fp);
+
+    if (objects_amt == 0)
+        return AkinatorErrors::NONE;
+
+    const size_t row_bytes = objects_amt * header.cell_size;
+    const size_t band_rows = (BAND_BYTES > row_bytes) ? BAND_BYTES / row_bytes : 1;
+    const size_t bands_amt = (objects_amt + band_rows - 1) / band_rows;
+    const size_t wave_amt  = WAVE_BANDS_PER_THREAD * TaskThreadsAmt();
+
+    SimilarityBand* bands = (SimilarityBand*) MemCalloc(MEM_TASKS, wave_amt, sizeof(SimilarityBand));
+    if (bands == nullptr)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    // buffers are made once and reused by every wave
+    for (size_t i = 0; i < wave_amt && i < bands_amt && error->code == (int) AkinatorErrors::NONE; i++)
+    {
+        bands[i].cells = (char*) MemCalloc(MEM_TASKS, band_rows * row_bytes, sizeof(char));
+        if (bands[i].cells == nullptr)
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    for (size_t wave_start = 0; wave_start < bands_amt && error->code == (int) AkinatorErrors::NONE;
+         wave_start += wave_amt)
+    {
+        const size_t wave_end = (wave_start + wave_amt < bands_amt) ? wave_start + wave_amt : bands_amt;
+
+        TaskGroup group = {};
+
+        for (size_t i = wave_start; i < wave_end; i++)
+        {
+            SimilarityBand* band = &bands[i - wave_start];
+
+            band->objects   = objects;
+            band->cell_size = header.cell_size;
+            band->first_row = i * band_rows;
+            band->rows_amt  = (band->first_row + band_rows < objects_amt) ? band_rows : objects_amt - band->first_row;
+
+            TaskSpawn(&group, FillBandTask, band);
+        }
+
+        TaskWait(&group);
+
+        // bands are written in order, so file is the same for any amount of threads
+        for (size_t i = wave_start; i < wave_end; i++)
+            fwrite(bands[i - wave_start].cells, sizeof(char), bands[i - wave_start].rows_amt * row_bytes, fp);
+    }
+
+    for (size_t i = 0; i < wave_amt; i++)
+        MemFree(bands[i].cells);
+
+    MemFree(bands);
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+static uint32_t SimilarityCellSize(const size_t height)
+{
+    if (height <= UINT8_MAX)
+        return sizeof(uint8_t);
+
+    if (height <= UINT16_MAX)
+        return sizeof(uint16_t);
+
+    return sizeof(uint32_t);
+}
+
+//---------------------------------------------------------------------------------------
+
+static void FillBandTask(void* arg)
+{
+    assert(arg);
+
+    TRACE_SPAN("SimilarityWrite band");
+
+    SimilarityBand* band = (SimilarityBand*) arg;
+
+    switch (band->cell_size)
+    {
+        case sizeof(uint8_t):
+            FillRows(band->objects, band->first_row, band->rows_amt, (uint8_t*)  band->cells);
+            break;
+
+        case sizeof(uint16_t):
+            FillRows(band->objects, band->first_row, band->rows_amt, (uint16_t*) band->cells);
+            break;
+
+        default:
+            FillRows(band->objects, band->first_row, band->rows_amt, (uint32_t*) band->cells);
+            break;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+template <typename cell_t>
+static void FillRows(const SimilarityObjects* objects, const size_t first_row, const size_t rows_amt,
+                     cell_t* cells)
+{
+    assert(objects);
+    assert(cells);
+
+    const size_t  objects_amt = objects->objects_amt;
+    const size_t* lca_depths  = objects->lca_depths;
+
+    for (size_t row = first_row; row < first_row + rows_amt; row++)
+    {
+        cell_t* cell = cells + (row - first_row) * objects_amt;
+
+        cell[row] = (cell_t) objects->depths[row];
+
+        size_t min_depth = SIZE_MAX;
+
+        for (size_t column = row + 1; column < objects_amt; column++)
+        {
+            if (lca_depths[column - 1] < min_depth)
+                min_depth = lca_depths[column - 1];
+
+            cell[column] = (cell_t) min_depth;
+        }
+
+        min_depth = SIZE_MAX;
+
+        for (size_t column = row; column-- > 0; )
+        {
+            if (lca_depths[column] < min_depth)
+                min_depth = lca_depths[column];
+
+            cell[column] = (cell_t) min_depth;
+        }
+    }
+}
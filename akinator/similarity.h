@@ -0,0 +1,53 @@
+#ifndef __SIMILARITY_H_
+#define __SIMILARITY_H_
+
+#include <stdint.h>
+
+#include "akinator.h"
+
+// Matrix of similarity of objects: cell (i, j) is depth of lowest common ancestor of i-th and j-th
+// objects (amount of questions, that they answer the same way), cell (i, i) is depth of object.
+//
+// Objects are numbered in DFS order, so LCA depth of i < j is min of LCA depths of neighbours
+// i..j-1. Row is filled from diagonal to both sides with running min, every cell costs O(1).
+// Subset of objects keeps DFS order, its neighbours get min over objects between them.
+//
+// File: SimilarityHeader, names of objects (with '\0' after each), then matrix by rows. Rows are
+// counted by threads in bands and written, when wave of bands is done, so memory does not depend
+// on size of matrix.
+
+static const char* const SIMILARITY_FILE_EXT    = ".similarity";
+// "AKSM" in little endian file
+static const uint32_t    SIMILARITY_MAGIC       = 0x4D534B41;
+static const size_t      SIMILARITY_BUFFER_SIZE = 1 << 20;
+
+struct SimilarityHeader
+{
+    uint32_t magic;
+    // bytes in one cell: 1, 2 or 4 (the least one for height of tree)
+    uint32_t cell_size;
+    uint64_t objects_amt;
+    uint64_t names_size;
+};
+
+struct SimilarityObjects
+{
+    const Node** objects;
+    size_t*      depths;
+    // lca_depths[i] is LCA depth of objects i and i + 1
+    size_t*      lca_depths;
+    size_t       objects_amt;
+
+    size_t       height;
+};
+
+AkinatorErrors SimilarityObjectsCtor(SimilarityObjects* objects, const tree_t* tree, error_t* error);
+void           SimilarityObjectsDtor(SimilarityObjects* objects);
+
+// keeps only objects with these names (case is ignored), returns name, that is not found, or nullptr
+const char*    SimilarityObjectsSelect(SimilarityObjects* objects, char* const* names, const size_t names_amt,
+                                       error_t* error);
+
+AkinatorErrors SimilarityWrite(FILE* fp, const SimilarityObjects* objects, error_t* error);
+
+#endif
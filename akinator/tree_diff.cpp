@@ -0,0 +1,221 @@
+#include <assert.h>
+#include <string.h>
+
+#include "tree_diff.h"
+#include "tree/traversal.h"
+#include "common/trace.h"
+#include "common/memory.h"
+
+static const size_t ENTRIES_START_CAPACITY = 16;
+
+struct DiffPair
+{
+    const Node* old_node;
+    const Node* new_node;
+    // depth of nodes and step to them from parents
+    size_t      depth;
+    step_t      step;
+};
+
+static AkinatorErrors AddEntry(TreeDiff* diff, const TreeDiffKind kind, const path_t* path,
+                               const DiffPair* pair, error_t* error);
+static bool           IsQuestion(const Node* node);
+static bool           HasObject(const Node* subtree, const char* object);
+
+//---------------------------------------------------------------------------------------
+
+void TreeDiffDtor(TreeDiff* diff)
+{
+    assert(diff);
+
+    for (size_t i = 0; i < diff->entries_amt; i++)
+        MemFree(diff->entries[i].path);
+
+    MemFree(diff->entries);
+
+    *diff = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors TreeDiffFind(tree_t* old_tree, tree_t* new_tree, TreeDiff* diff, error_t* error)
+{
+    assert(old_tree);
+    assert(new_tree);
+    assert(diff);
+    assert(error);
+
+    TRACE_SPAN("TreeDiffFind");
+
+    *diff = {};
+
+    TreeRootHash(old_tree);
+    TreeRootHash(new_tree);
+
+    if (old_tree->root == nullptr || new_tree->root == nullptr)
+    {
+        if (old_tree->root != new_tree->root)
+        {
+            path_t   path = {};
+            DiffPair pair = {old_tree->root, new_tree->root, 0, LEFT_STEP};
+
+            path.init();
+            AddEntry(diff, DIFF_REPLACEMENT, &path, &pair, error);
+            path.destroy();
+        }
+
+        return (AkinatorErrors) error->code;
+    }
+
+    UncheckedStack<DiffPair> pairs;
+    pairs.init();
+
+    path_t path = {};
+    path.init();
+
+    if (pairs.push({old_tree->root, new_tree->root, 0, LEFT_STEP}) != (int) ERRORS::NONE)
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+
+    while (pairs.size > 0 && error->code == (int) AkinatorErrors::NONE)
+    {
+        DiffPair pair = {};
+        pairs.pop(&pair);
+
+        // path is shared by all pairs: it keeps steps to parent of this pair only
+        while (path.size >= pair.depth && path.size > 0)
+            path.pop();
+
+        if (pair.depth > 0 && path.push(pair.step) != (int) ERRORS::NONE)
+        {
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            break;
+        }
+
+        if (pair.old_node->hash == pair.new_node->hash)
+            continue;
+
+        diff->visited_pairs++;
+
+        const Node* old_node = pair.old_node;
+        const Node* new_node = pair.new_node;
+
+        if (IsQuestion(old_node) && IsQuestion(new_node) && strcmp(old_node->data, new_node->data) == 0)
+        {
+            // right child goes first, so changes are found in prefix order
+            if (pairs.push({old_node->right, new_node->right, pair.depth + 1, RIGHT_STEP}) != (int) ERRORS::NONE ||
+                pairs.push({old_node->left,  new_node->left,  pair.depth + 1, LEFT_STEP})  != (int) ERRORS::NONE)
+                error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+
+            continue;
+        }
+
+        if (old_node->left == nullptr && old_node->right == nullptr && HasObject(new_node, old_node->data))
+        {
+            AddEntry(diff, DIFF_EXPANSION, &path, &pair, error);
+            diff->learned_objects += new_node->subtree.leaves - 1;
+        }
+        else
+            AddEntry(diff, DIFF_REPLACEMENT, &path, &pair, error);
+    }
+
+    pairs.destroy();
+    path.destroy();
+
+    if (error->code != (int) AkinatorErrors::NONE)
+        TreeDiffDtor(diff);
+
+    return (AkinatorErrors) error->code;
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors AddEntry(TreeDiff* diff, const TreeDiffKind kind, const path_t* path,
+                               const DiffPair* pair, error_t* error)
+{
+    assert(diff);
+    assert(path);
+    assert(pair);
+    assert(error);
+
+    if (diff->entries_amt == diff->capacity)
+    {
+        const size_t   capacity = (diff->capacity > 0) ? 2 * diff->capacity : ENTRIES_START_CAPACITY;
+        TreeDiffEntry* entries  = (TreeDiffEntry*) MemRealloc(MEM_INDEXES,
+                                                              diff->entries, capacity * sizeof(TreeDiffEntry));
+        if (entries == nullptr)
+        {
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            return AkinatorErrors::ALLOCATE_MEMORY;
+        }
+
+        diff->entries  = entries;
+        diff->capacity = capacity;
+    }
+
+    TreeDiffEntry entry = {};
+    entry.kind     = kind;
+    entry.depth    = path->size;
+    entry.old_node = pair->old_node;
+    entry.new_node = pair->new_node;
+
+    if (entry.depth > 0)
+    {
+        entry.path = (step_t*) MemCalloc(MEM_INDEXES, entry.depth, sizeof(step_t));
+        if (entry.path == nullptr)
+        {
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            return AkinatorErrors::ALLOCATE_MEMORY;
+        }
+
+        memcpy(entry.path, path->data, entry.depth * sizeof(step_t));
+    }
+
+    diff->entries[diff->entries_amt++] = entry;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+// only questions with both answers are walked together, other nodes are compared as whole
+static bool IsQuestion(const Node* node)
+{
+    assert(node);
+
+    return node->left != nullptr && node->right != nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct HasObjectVisitor : TreeVisitor<const Node>
+{
+    const char* object = nullptr;
+    bool        found  = false;
+
+    TraverseAction pre(const Node* node, const TraversePos*)
+    {
+        if (node->left != nullptr || node->right != nullptr)
+            return TRAVERSE_CONTINUE;
+
+        if (strcmp(node->data, object) != 0)
+            return TRAVERSE_CONTINUE;
+
+        found = true;
+        return TRAVERSE_STOP;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+static bool HasObject(const Node* subtree, const char* object)
+{
+    assert(subtree);
+    assert(object);
+
+    HasObjectVisitor visitor = {};
+    visitor.object = object;
+
+    TraverseNodes(subtree, &visitor);
+
+    return visitor.found;
+}
@@ -0,0 +1,51 @@
+#ifndef __TREE_DIFF_H_
+#define __TREE_DIFF_H_
+
+#include "akinator.h"
+
+// Difference of two trees as leaf expansions: guess mode turns leaf into question with new object
+// and old one, so trees learned from one data file differ by leaves, that became subtrees.
+//
+// Both trees are walked together only where merkle hashes of nodes differ, so equal subtrees are
+// skipped at once, and diff of big trees with few learned objects costs O(changes * depth).
+
+// learned objects, that are named for one expansion
+static const size_t MAX_DIFF_OBJECTS_NAMED = 10;
+
+enum TreeDiffKind
+{
+    // leaf of old tree is subtree of new one, that still has old object
+    DIFF_EXPANSION,
+    // any other change: question or object is renamed, objects are removed
+    DIFF_REPLACEMENT
+};
+
+struct TreeDiffEntry
+{
+    TreeDiffKind kind;
+
+    // steps from root of old tree to changed node
+    step_t*      path;
+    size_t       depth;
+
+    const Node*  old_node;
+    const Node*  new_node;
+};
+
+struct TreeDiff
+{
+    TreeDiffEntry* entries;
+    size_t         entries_amt;
+    size_t         capacity;
+
+    size_t         learned_objects;
+    // pairs of nodes with different hashes, that were compared
+    size_t         visited_pairs;
+};
+
+void           TreeDiffDtor(TreeDiff* diff);
+
+// trees, that are not hashed yet, are hashed here; entries go in prefix order of old tree
+AkinatorErrors TreeDiffFind(tree_t* old_tree, tree_t* new_tree, TreeDiff* diff, error_t* error);
+
+#endif
@@ -0,0 +1,504 @@
+#include <assert.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "word_index.h"
+#include "tree/traversal.h"
+#include "stack/hash.h"
+#include "common/input_and_output.h"
+#include "common/trace.h"
+#include "common/memory.h"
+
+static const size_t WORDS_START_CAPACITY     = 64;
+static const size_t QUESTIONS_START_CAPACITY = 64;
+static const size_t POSTINGS_START_CAPACITY  = 4;
+
+static AkinatorErrors BuildIndex(WordIndex* index, const tree_t* tree, error_t* error);
+static void           DropAddedQuestions(WordIndex* index);
+static void           ClearIndex(WordIndex* index);
+
+static AkinatorErrors AddQuestion(WordIndex* index, const char* text, const step_t* path, const size_t depth,
+                                  error_t* error);
+static AkinatorErrors AddPosting(WordIndex* index, const char* word, const size_t len, const size_t question,
+                                 error_t* error);
+static AkinatorErrors GrowWords(WordIndex* index, error_t* error);
+
+static size_t         FindSlot(const WordPostings* words, const size_t capacity, const char* word,
+                               const size_t len, const hash_t hash);
+static const char*    NextWord(const char* text, char* word, size_t* len);
+static bool           HasQuestion(const WordPostings* postings, const size_t question);
+
+//---------------------------------------------------------------------------------------
+
+void WordIndexCtor(WordIndex* index)
+{
+    assert(index);
+
+    *index = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+void WordIndexDtor(WordIndex* index)
+{
+    assert(index);
+
+    ClearIndex(index);
+
+    MemFree(index->questions);
+    MemFree(index->words);
+
+    *index = {};
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors WordIndexSync(WordIndex* index, tree_t* tree, error_t* error)
+{
+    assert(index);
+    assert(tree);
+    assert(error);
+
+    const hash_t tree_hash = TreeRootHash(tree);
+
+    if (index->built && tree_hash == index->expected_hash)
+    {
+        index->synced_amt = index->questions_amt;
+    }
+    else if (index->built && tree_hash == index->tree_hash)
+    {
+        // learned tree was not saved
+        DropAddedQuestions(index);
+    }
+    else
+    {
+        BuildIndex(index, tree, error);
+        RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+    }
+
+    index->tree_hash     = tree_hash;
+    index->expected_hash = tree_hash;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors WordIndexAdd(WordIndex* index, const char* text, const path_t* path, error_t* error)
+{
+    assert(index);
+    assert(text);
+    assert(path);
+    assert(error);
+
+    return AddQuestion(index, text, path->data, path->size, error);
+}
+
+//---------------------------------------------------------------------------------------
+
+void WordIndexExpectTree(WordIndex* index, tree_t* tree)
+{
+    assert(index);
+    assert(tree);
+
+    index->expected_hash = TreeRootHash(tree);
+}
+
+//---------------------------------------------------------------------------------------
+
+AkinatorErrors WordIndexSearch(const WordIndex* index, const char* query,
+                               size_t** found, size_t* found_amt, error_t* error)
+{
+    assert(index);
+    assert(query);
+    assert(found);
+    assert(found_amt);
+    assert(error);
+
+    TRACE_SPAN("WordIndexSearch");
+
+    *found     = nullptr;
+    *found_amt = 0;
+
+    const WordPostings* lists[MAX_STRING_LEN] = {};
+    size_t              lists_amt             = 0;
+
+    char   word[MAX_STRING_LEN + 1] = {};
+    size_t len                      = 0;
+
+    for (const char* text = NextWord(query, word, &len); len > 0 && lists_amt < MAX_STRING_LEN;
+         text = NextWord(text, word, &len))
+    {
+        const size_t slot = (index->words_capacity > 0) ?
+                            FindSlot(index->words, index->words_capacity, word, len, Hash64(word, len)) : 0;
+
+        // unknown word leaves nothing to intersect
+        if (index->words_capacity == 0 || index->words[slot].word == nullptr || index->words[slot].amt == 0)
+            return AkinatorErrors::NONE;
+
+        lists[lists_amt++] = &index->words[slot];
+    }
+
+    if (lists_amt == 0)
+        return AkinatorErrors::NONE;
+
+    // the shortest list is walked, others are searched by binary search
+    size_t shortest = 0;
+    for (size_t i = 1; i < lists_amt; i++)
+        if (lists[i]->amt < lists[shortest]->amt)
+            shortest = i;
+
+    *found = (size_t*) MemCalloc(MEM_INDEXES, lists[shortest]->amt, sizeof(size_t));
+    if (*found == nullptr)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    for (size_t i = 0; i < lists[shortest]->amt; i++)
+    {
+        const size_t question = lists[shortest]->questions[i];
+
+        bool in_all = true;
+        for (size_t j = 0; j < lists_amt && in_all; j++)
+            in_all = (j == shortest) || HasQuestion(lists[j], question);
+
+        if (in_all)
+            (*found)[(*found_amt)++] = question;
+    }
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+struct WordIndexVisitor : TreeVisitor<const Node>
+{
+    WordIndex* index = nullptr;
+    error_t*   error = nullptr;
+
+    // steps to current node
+    path_t     path;
+
+    TraverseAction pre(const Node* node, const TraversePos* pos)
+    {
+        while (path.size + 1 > pos->depth && path.size > 0)
+            path.pop();
+
+        if (pos->depth > 0 && path.push(pos->is_left ? LEFT_STEP : RIGHT_STEP) != (int) ERRORS::NONE)
+        {
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            return TRAVERSE_STOP;
+        }
+
+        if (node->left == nullptr && node->right == nullptr)
+            return TRAVERSE_CONTINUE;
+
+        AddQuestion(index, node->data, path.data, path.size, error);
+
+        return (error->code == (int) AkinatorErrors::NONE) ? TRAVERSE_CONTINUE : TRAVERSE_STOP;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors BuildIndex(WordIndex* index, const tree_t* tree, error_t* error)
+{
+    assert(index);
+    assert(tree);
+    assert(error);
+
+    TRACE_SPAN("WordIndex build");
+
+    ClearIndex(index);
+
+    index->built = true;
+
+    if (tree->root == nullptr)
+        return AkinatorErrors::NONE;
+
+    WordIndexVisitor visitor = {};
+    visitor.index = index;
+    visitor.error = error;
+    visitor.path.init();
+
+    if (TraverseNodes(tree->root, &visitor) != TreeErrors::NONE)
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+
+    visitor.path.destroy();
+
+    if (error->code != (int) AkinatorErrors::NONE)
+    {
+        // half made index is made again by next sync
+        ClearIndex(index);
+        return (AkinatorErrors) error->code;
+    }
+
+    index->synced_amt = index->questions_amt;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+// questions of guess mode are the last ones, so they are the last ones in their lists too
+static void DropAddedQuestions(WordIndex* index)
+{
+    assert(index);
+
+    char   word[MAX_STRING_LEN + 1] = {};
+    size_t len                      = 0;
+
+    while (index->questions_amt > index->synced_amt)
+    {
+        const size_t  question = --index->questions_amt;
+        WordQuestion* entry    = &index->questions[question];
+
+        for (const char* text = NextWord(entry->text, word, &len); len > 0; text = NextWord(text, word, &len))
+        {
+            WordPostings* postings = &index->words[FindSlot(index->words, index->words_capacity,
+                                                            word, len, Hash64(word, len))];
+
+            if (postings->amt > 0 && postings->questions[postings->amt - 1] == question)
+                postings->amt--;
+        }
+
+        MemFree(entry->text);
+        MemFree(entry->path);
+        *entry = {};
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+// frees texts and lists, but keeps tables
+static void ClearIndex(WordIndex* index)
+{
+    assert(index);
+
+    for (size_t i = 0; i < index->questions_amt; i++)
+    {
+        MemFree(index->questions[i].text);
+        MemFree(index->questions[i].path);
+        index->questions[i] = {};
+    }
+
+    for (size_t i = 0; i < index->words_capacity; i++)
+    {
+        MemFree(index->words[i].word);
+        MemFree(index->words[i].questions);
+        index->words[i] = {};
+    }
+
+    index->questions_amt = 0;
+    index->synced_amt    = 0;
+    index->words_amt     = 0;
+    index->built         = false;
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors AddQuestion(WordIndex* index, const char* text, const step_t* path, const size_t depth,
+                                  error_t* error)
+{
+    assert(index);
+    assert(text);
+    assert(error);
+
+    if (index->questions_amt == index->capacity)
+    {
+        const size_t  capacity  = (index->capacity > 0) ? 2 * index->capacity : QUESTIONS_START_CAPACITY;
+        WordQuestion* questions = (WordQuestion*) MemRealloc(MEM_INDEXES,
+                                                             index->questions, capacity * sizeof(WordQuestion));
+        if (questions == nullptr)
+        {
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            return AkinatorErrors::ALLOCATE_MEMORY;
+        }
+
+        index->questions = questions;
+        index->capacity  = capacity;
+    }
+
+    WordQuestion entry = {};
+    entry.text  = MemStrdup(MEM_STRINGS, text);
+    entry.path  = (step_t*) MemCalloc(MEM_INDEXES, depth + 1, sizeof(step_t));
+    entry.depth = depth;
+
+    if (entry.text == nullptr || entry.path == nullptr)
+    {
+        MemFree(entry.text);
+        MemFree(entry.path);
+
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    if (depth > 0)
+        memcpy(entry.path, path, depth * sizeof(step_t));
+
+    const size_t question = index->questions_amt++;
+    index->questions[question] = entry;
+
+    char   word[MAX_STRING_LEN + 1] = {};
+    size_t len                      = 0;
+
+    for (const char* rest = NextWord(text, word, &len); len > 0; rest = NextWord(rest, word, &len))
+    {
+        AddPosting(index, word, len, question, error);
+        RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+    }
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors AddPosting(WordIndex* index, const char* word, const size_t len, const size_t question,
+                                 error_t* error)
+{
+    assert(index);
+    assert(word);
+    assert(error);
+
+    if (2 * (index->words_amt + 1) > index->words_capacity)
+    {
+        GrowWords(index, error);
+        RETURN_IF_AKINATOR_ERROR((AkinatorErrors) error->code);
+    }
+
+    const hash_t  hash     = Hash64(word, len);
+    WordPostings* postings = &index->words[FindSlot(index->words, index->words_capacity, word, len, hash)];
+
+    if (postings->word == nullptr)
+    {
+        postings->word = MemStrdup(MEM_STRINGS, word);
+        if (postings->word == nullptr)
+        {
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            return AkinatorErrors::ALLOCATE_MEMORY;
+        }
+
+        postings->hash = hash;
+        index->words_amt++;
+    }
+
+    // word is repeated in the same question
+    if (postings->amt > 0 && postings->questions[postings->amt - 1] == question)
+        return AkinatorErrors::NONE;
+
+    if (postings->amt == postings->capacity)
+    {
+        const size_t capacity  = (postings->capacity > 0) ? 2 * postings->capacity : POSTINGS_START_CAPACITY;
+        size_t*      questions = (size_t*) MemRealloc(MEM_INDEXES, postings->questions, capacity * sizeof(size_t));
+        if (questions == nullptr)
+        {
+            error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+            return AkinatorErrors::ALLOCATE_MEMORY;
+        }
+
+        postings->questions = questions;
+        postings->capacity  = capacity;
+    }
+
+    postings->questions[postings->amt++] = question;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+static AkinatorErrors GrowWords(WordIndex* index, error_t* error)
+{
+    assert(index);
+    assert(error);
+
+    const size_t  capacity = (index->words_capacity > 0) ? 2 * index->words_capacity : WORDS_START_CAPACITY;
+    WordPostings* words    = (WordPostings*) MemCalloc(MEM_INDEXES, capacity, sizeof(WordPostings));
+    if (words == nullptr)
+    {
+        error->code = (int) AkinatorErrors::ALLOCATE_MEMORY;
+        return AkinatorErrors::ALLOCATE_MEMORY;
+    }
+
+    for (size_t i = 0; i < index->words_capacity; i++)
+    {
+        const WordPostings* postings = &index->words[i];
+
+        if (postings->word != nullptr)
+            words[FindSlot(words, capacity, postings->word, strlen(postings->word), postings->hash)] = *postings;
+    }
+
+    MemFree(index->words);
+
+    index->words          = words;
+    index->words_capacity = capacity;
+
+    return AkinatorErrors::NONE;
+}
+
+//---------------------------------------------------------------------------------------
+
+// slot with this word or free slot, where it must be
+static size_t FindSlot(const WordPostings* words, const size_t capacity, const char* word,
+                       const size_t len, const hash_t hash)
+{
+    assert(words);
+    assert(word);
+
+    size_t slot = hash & (capacity - 1);
+
+    while (words[slot].word != nullptr &&
+           (words[slot].hash != hash || strncmp(words[slot].word, word, len) || words[slot].word[len] != '\0'))
+        slot = (slot + 1) & (capacity - 1);
+
+    return slot;
+}
+
+//---------------------------------------------------------------------------------------
+
+// copies next word of text in lower case, len is 0 at the end of text
+static const char* NextWord(const char* text, char* word, size_t* len)
+{
+    assert(text);
+    assert(word);
+    assert(len);
+
+    *len = 0;
+
+    while (*text != '\0' && !isalnum((unsigned char) *text) && (unsigned char) *text < 0x80)
+        text++;
+
+    while (*text != '\0' && (isalnum((unsigned char) *text) || (unsigned char) *text >= 0x80))
+    {
+        if (*len < MAX_STRING_LEN)
+            word[(*len)++] = (char) tolower((unsigned char) *text);
+        text++;
+    }
+
+    word[*len] = '\0';
+
+    return text;
+}
+
+//---------------------------------------------------------------------------------------
+
+static bool HasQuestion(const WordPostings* postings, const size_t question)
+{
+    assert(postings);
+
+    size_t left  = 0;
+    size_t right = postings->amt;
+
+    while (left < right)
+    {
+        const size_t middle = left + (right - left) / 2;
+
+        if (postings->questions[middle] < question)
+            left = middle + 1;
+        else
+            right = middle;
+    }
+
+    return left < postings->amt && postings->questions[left] == question;
+}
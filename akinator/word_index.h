@@ -0,0 +1,70 @@
+#ifndef __WORD_INDEX_H_
+#define __WORD_INDEX_H_
+
+#include "akinator.h"
+
+// Inverted index of words of questions, so search of "sweden" or "sniper" does not walk the tree.
+//
+// Word is run of letters and digits (case is ignored, bytes of UTF-8 letters are kept as they are).
+// Every word has list of questions with it, sorted by number of question, and query of several words
+// is intersection of lists. Index lives for whole session like description cache: it is made again
+// only after reading of other tree, and guess mode adds its new question, so saved tree keeps index.
+
+// word search mode names only first questions of big results
+static const size_t MAX_FOUND_QUESTIONS_NAMED = 32;
+
+struct WordQuestion
+{
+    char*   text;
+    // steps from root to question
+    step_t* path;
+    size_t  depth;
+};
+
+struct WordPostings
+{
+    // free slot of table has no word
+    char*   word;
+    hash_t  hash;
+
+    // numbers of questions with word, ascending
+    size_t* questions;
+    size_t  amt;
+    size_t  capacity;
+};
+
+struct WordIndex
+{
+    WordQuestion* questions;
+    size_t        questions_amt;
+    size_t        capacity;
+    // questions after these ones are added by guess mode, they are dropped if tree is not saved
+    size_t        synced_amt;
+
+    // open addressing by hash of word, table is at most half full
+    WordPostings* words;
+    size_t        words_amt;
+    size_t        words_capacity;
+
+    // merkle hashes of tree, that index is made for, and of tree with added questions
+    hash_t        tree_hash;
+    hash_t        expected_hash;
+    bool          built;
+};
+
+void           WordIndexCtor(WordIndex* index);
+void           WordIndexDtor(WordIndex* index);
+
+// makes index again, if tree is not the one index is made for (called after every reading,
+// tree is hashed here, if it is not hashed yet)
+AkinatorErrors WordIndexSync(WordIndex* index, tree_t* tree, error_t* error);
+// question is added in place of leaf on this path
+AkinatorErrors WordIndexAdd(WordIndex* index, const char* text, const path_t* path, error_t* error);
+// questions were added for changes of tree already, so this tree (hashed here, if needed) keeps them
+void           WordIndexExpectTree(WordIndex* index, tree_t* tree);
+
+// numbers of questions with all words of query, found must be freed by MemFree
+AkinatorErrors WordIndexSearch(const WordIndex* index, const char* query,
+                               size_t** found, size_t* found_amt, error_t* error);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef __BENCH_H_
+#define __BENCH_H_
+
+#include <stdio.h>
+#include <time.h>
+
+// Benchmarks are built with -O2 by "make bench" and print one line per measurement. Checks fail
+// with exit code 1, so "make bench" stops on them.
+
+static inline double BenchSeconds()
+{
+    timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
+
+// result of measured code is kept here, so compiler does not throw the code away
+static volatile unsigned long long BENCH_SINK = 0;
+
+#endif
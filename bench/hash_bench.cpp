@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "bench.h"
+#include "stack/hash.h"
+
+// Hash64 and Crc32c: published reference vectors, streaming and chained parts, collisions and bucket
+// balance on keys like the ones program hashes, avalanche, and throughput across input sizes.
+
+static const size_t KEYS_AMT          = (size_t) 1 << 20;
+static const size_t BUCKET_BITS       = 16;
+static const size_t AVALANCHE_KEYS    = 10000;
+static const size_t AVALANCHE_KEY_LEN = 16;
+// bias of one output bit to flip of one input bit, 10 sigmas for AVALANCHE_KEYS samples
+static const double AVALANCHE_MAX_BIAS = 0.05;
+static const size_t THROUGHPUT_BYTES  = (size_t) 1 << 28;
+
+struct HashVector
+{
+    const char* text;
+    hash_t      hash;
+};
+
+struct CrcVector
+{
+    const char* name;
+    unsigned    crc;
+};
+
+// XXH64 with seed 0
+static const HashVector HASH_VECTORS[] = {{"",                                        0xEF46DB3751D8E999},
+                                          {"a",                                       0xD24EC4F1A98C6E5B},
+                                          {"abc",                                     0x44BC2CF5AD770999},
+                                          {"Nobody inspects the spammish repetition", 0xFBCEA83C8A378BF1}};
+
+// "123456789" check value and iSCSI test vectors (RFC 3720, 32 bytes each)
+static const CrcVector CRC_VECTORS[] = {{"123456789",  0xE3069283},
+                                        {"zeros",      0x8A9136AA},
+                                        {"ones",       0x62A8AB43},
+                                        {"ascending",  0x46DD794E}};
+
+static const size_t THROUGHPUT_SIZES[] = {8, 64, 1024, (size_t) 1 << 16, (size_t) 1 << 20};
+
+static bool CheckReferenceVectors();
+static bool CheckParts();
+static bool CheckCollisions(const char* keys_name, hash_t* hashes);
+static bool CheckAvalanche();
+static void BenchThroughput();
+
+static unsigned long long NextRandom(unsigned long long* state);
+static int                CompareHashes(const void* first, const void* second);
+
+//-----------------------------------------------------------------------------------------------------
+
+int main()
+{
+    bool ok = CheckReferenceVectors() && CheckParts();
+
+    hash_t* hashes = (hash_t*) calloc(KEYS_AMT, sizeof(hash_t));
+    if (hashes == nullptr)
+        return 1;
+
+    // numbers of nodes and names of objects, like keys of description cache and fuzzy index
+    for (size_t i = 0; i < KEYS_AMT; i++)
+        hashes[i] = Hash64(&i, sizeof(i));
+
+    ok = CheckCollisions("integers", hashes) && ok;
+
+    char name[32] = {};
+    for (size_t i = 0; i < KEYS_AMT; i++)
+    {
+        const int len = snprintf(name, sizeof(name), "object %zu", i);
+        hashes[i] = Hash64(name, (size_t) len);
+    }
+
+    ok = CheckCollisions("names", hashes) && ok;
+
+    free(hashes);
+
+    ok = CheckAvalanche() && ok;
+
+    BenchThroughput();
+
+    if (!ok)
+    {
+        printf("HASH CHECKS FAILED\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool CheckReferenceVectors()
+{
+    bool ok = true;
+
+    for (size_t i = 0; i < sizeof(HASH_VECTORS) / sizeof(HASH_VECTORS[0]); i++)
+    {
+        const hash_t hash = Hash64(HASH_VECTORS[i].text, strlen(HASH_VECTORS[i].text));
+
+        if (hash != HASH_VECTORS[i].hash)
+        {
+            printf("Hash64(\"%s\") = %016llX, expected %016llX\n",
+                   HASH_VECTORS[i].text, hash, HASH_VECTORS[i].hash);
+            ok = false;
+        }
+    }
+
+    unsigned char blocks[4][32] = {};
+    memcpy(blocks[0], "123456789", 9);
+    memset(blocks[2], 0xFF, sizeof(blocks[2]));
+    for (size_t i = 0; i < sizeof(blocks[3]); i++)
+        blocks[3][i] = (unsigned char) i;
+
+    for (size_t i = 0; i < sizeof(CRC_VECTORS) / sizeof(CRC_VECTORS[0]); i++)
+    {
+        const unsigned crc = Crc32c(blocks[i], (i == 0) ? 9 : sizeof(blocks[i]));
+
+        if (crc != CRC_VECTORS[i].crc)
+        {
+            printf("Crc32c(%s) = %08X, expected %08X\n", CRC_VECTORS[i].name, crc, CRC_VECTORS[i].crc);
+            ok = false;
+        }
+    }
+
+    printf("reference vectors: %s\n", ok ? "ok" : "FAILED");
+
+    return ok;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+// streaming hash and chained checksum of parts must be equal to ones of whole input
+static bool CheckParts()
+{
+    unsigned char data[1000] = {};
+
+    unsigned long long state = 1;
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = (unsigned char) NextRandom(&state);
+
+    const hash_t   whole_hash = Hash64(data, sizeof(data));
+    const unsigned whole_crc  = Crc32c(data, sizeof(data));
+
+    bool ok = true;
+
+    for (size_t split = 0; split <= sizeof(data) && ok; split += 7)
+    {
+        HashState hash_state = {};
+        HashStart(&hash_state);
+
+        // second part goes by odd pieces, so stripe buffer is filled from different offsets
+        HashUpdate(&hash_state, data, split);
+        for (size_t i = split; i < sizeof(data); i += 13)
+            HashUpdate(&hash_state, data + i, (sizeof(data) - i < 13) ? sizeof(data) - i : 13);
+
+        const unsigned crc = Crc32c(data + split, sizeof(data) - split, Crc32c(data, split));
+
+        if (HashFinish(&hash_state) != whole_hash || crc != whole_crc)
+        {
+            printf("parts split at %zu differ from whole input\n", split);
+            ok = false;
+        }
+    }
+
+    printf("streaming and chained parts: %s\n", ok ? "ok" : "FAILED");
+
+    return ok;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+// no 64-bit collisions, and low and high bits fill buckets evenly (chi-squared in 6 sigmas)
+static bool CheckCollisions(const char* keys_name, hash_t* hashes)
+{
+    const size_t buckets_amt = (size_t) 1 << BUCKET_BITS;
+
+    size_t* low  = (size_t*) calloc(buckets_amt, sizeof(size_t));
+    size_t* high = (size_t*) calloc(buckets_amt, sizeof(size_t));
+    if (low == nullptr || high == nullptr)
+    {
+        free(low);
+        free(high);
+        return false;
+    }
+
+    for (size_t i = 0; i < KEYS_AMT; i++)
+    {
+        low [hashes[i] & (buckets_amt - 1)]++;
+        high[hashes[i] >> (64 - BUCKET_BITS)]++;
+    }
+
+    const double expected = (double) KEYS_AMT / (double) buckets_amt;
+
+    double low_chi  = 0;
+    double high_chi = 0;
+
+    for (size_t i = 0; i < buckets_amt; i++)
+    {
+        low_chi  += ((double) low [i] - expected) * ((double) low [i] - expected) / expected;
+        high_chi += ((double) high[i] - expected) * ((double) high[i] - expected) / expected;
+    }
+
+    free(low);
+    free(high);
+
+    qsort(hashes, KEYS_AMT, sizeof(hash_t), CompareHashes);
+
+    size_t collisions = 0;
+    for (size_t i = 1; i < KEYS_AMT; i++)
+        if (hashes[i] == hashes[i - 1])
+            collisions++;
+
+    const double degrees = (double) (buckets_amt - 1);
+    const double limit   = 6 * sqrt(2 * degrees);
+
+    const bool ok = collisions == 0 && fabs(low_chi - degrees) < limit && fabs(high_chi - degrees) < limit;
+
+    printf("%zu %s: %zu collisions, chi-squared of low / high %zu bits %.0lf / %.0lf (%.0lf +- %.0lf): %s\n",
+           KEYS_AMT, keys_name, collisions, BUCKET_BITS, low_chi, high_chi, degrees, limit,
+           ok ? "ok" : "FAILED");
+
+    return ok;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+// flip of every input bit must flip every output bit with probability 1/2
+static bool CheckAvalanche()
+{
+    const size_t input_bits = 8 * AVALANCHE_KEY_LEN;
+
+    size_t* flips = (size_t*) calloc(input_bits * 64, sizeof(size_t));
+    if (flips == nullptr)
+        return false;
+
+    unsigned long long state = 2;
+    unsigned char      key[AVALANCHE_KEY_LEN] = {};
+
+    for (size_t i = 0; i < AVALANCHE_KEYS; i++)
+    {
+        for (size_t j = 0; j < AVALANCHE_KEY_LEN; j++)
+            key[j] = (unsigned char) NextRandom(&state);
+
+        const hash_t hash = Hash64(key, sizeof(key));
+
+        for (size_t bit = 0; bit < input_bits; bit++)
+        {
+            key[bit / 8] ^= (unsigned char) (1 << (bit % 8));
+            const hash_t diff = hash ^ Hash64(key, sizeof(key));
+            key[bit / 8] ^= (unsigned char) (1 << (bit % 8));
+
+            for (size_t out = 0; out < 64; out++)
+                flips[bit * 64 + out] += (diff >> out) & 1;
+        }
+    }
+
+    double worst_bias = 0;
+    size_t all_flips  = 0;
+
+    for (size_t i = 0; i < input_bits * 64; i++)
+    {
+        const double bias = fabs((double) flips[i] / (double) AVALANCHE_KEYS - 0.5);
+        if (bias > worst_bias)
+            worst_bias = bias;
+
+        all_flips += flips[i];
+    }
+
+    free(flips);
+
+    const bool ok = worst_bias < AVALANCHE_MAX_BIAS;
+
+    printf("avalanche: %.2lf of 64 bits flip on average, worst bias %.4lf (limit %.2lf): %s\n",
+           (double) all_flips / (double) (AVALANCHE_KEYS * input_bits), worst_bias, AVALANCHE_MAX_BIAS,
+           ok ? "ok" : "FAILED");
+
+    return ok;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void BenchThroughput()
+{
+    const size_t max_size = THROUGHPUT_SIZES[sizeof(THROUGHPUT_SIZES) / sizeof(THROUGHPUT_SIZES[0]) - 1];
+
+    unsigned char* data = (unsigned char*) calloc(max_size, sizeof(unsigned char));
+    if (data == nullptr)
+        return;
+
+    unsigned long long state = 3;
+    for (size_t i = 0; i < max_size; i++)
+        data[i] = (unsigned char) NextRandom(&state);
+
+    printf("%-8s %10s %12s %10s\n", "hash", "size", "ns per call", "GB/s");
+
+    for (size_t i = 0; i < sizeof(THROUGHPUT_SIZES) / sizeof(THROUGHPUT_SIZES[0]); i++)
+    {
+        const size_t size  = THROUGHPUT_SIZES[i];
+        const size_t calls = THROUGHPUT_BYTES / size;
+
+        double start = BenchSeconds();
+        for (size_t j = 0; j < calls; j++)
+        {
+            // first bytes are changed, so calls are not merged by compiler
+            data[0] = (unsigned char) j;
+            BENCH_SINK += Hash64(data, size);
+        }
+        double seconds = BenchSeconds() - start;
+
+        printf("%-8s %10zu %12.2lf %10.2lf\n", "Hash64", size, seconds * 1e9 / (double) calls,
+               (double) (calls * size) / seconds * 1e-9);
+
+        start = BenchSeconds();
+        for (size_t j = 0; j < calls; j++)
+        {
+            data[0] = (unsigned char) j;
+            BENCH_SINK += Crc32c(data, size);
+        }
+        seconds = BenchSeconds() - start;
+
+        printf("%-8s %10zu %12.2lf %10.2lf\n", "Crc32c", size, seconds * 1e9 / (double) calls,
+               (double) (calls * size) / seconds * 1e-9);
+    }
+
+    free(data);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+// xorshift64*, inputs are the same in every run
+static unsigned long long NextRandom(unsigned long long* state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    // high bits of product are the best ones
+    return (*state * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int CompareHashes(const void* first, const void* second)
+{
+    const hash_t hash_1 = *(const hash_t*) first;
+    const hash_t hash_2 = *(const hash_t*) second;
+
+    return (hash_1 > hash_2) - (hash_1 < hash_2);
+}
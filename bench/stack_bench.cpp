@@ -0,0 +1,119 @@
+#include <stdlib.h>
+
+#include "bench.h"
+#include "stack/stack.h"
+
+// Cost of one push or pop with every stack check mode.
+//
+//     fill  - size goes 0 -> n -> 0, so capacity grows and shrinks
+//     walk  - size stays near depth (like stack of tree walk), only top is changed
+
+static const size_t WALK_OPS = 1 << 22;
+
+struct StackCheckTier
+{
+    StackCheckMode mode;
+    const char*    name;
+    // full checks cost O(capacity) per operation, so big sizes take too long with them
+    size_t         max_size;
+};
+
+static const StackCheckTier TIERS[] = {{STACK_CHECK_OFF,     "off",     (size_t) 1 << 22},
+                                       {STACK_CHECK_SAMPLED, "sampled", (size_t) 1 << 22},
+                                       {STACK_CHECK_FULL,    "full",    (size_t) 1 << 12}};
+
+static const size_t SIZES[] = {(size_t) 1 << 5, (size_t) 1 << 12, (size_t) 1 << 16, (size_t) 1 << 22};
+
+static double BenchFill(const size_t size);
+static double BenchWalk(const size_t depth);
+
+//-----------------------------------------------------------------------------------------------------
+
+int main()
+{
+    printf("%-8s %-5s %10s %12s\n", "checks", "test", "size", "ns per op");
+
+    for (size_t i = 0; i < sizeof(TIERS) / sizeof(TIERS[0]); i++)
+    {
+        SetStackCheckMode(TIERS[i].mode);
+
+        for (size_t j = 0; j < sizeof(SIZES) / sizeof(SIZES[0]); j++)
+        {
+            if (SIZES[j] > TIERS[i].max_size)
+                continue;
+
+            printf("%-8s %-5s %10zu %12.2lf\n", TIERS[i].name, "fill", SIZES[j], BenchFill(SIZES[j]));
+            printf("%-8s %-5s %10zu %12.2lf\n", TIERS[i].name, "walk", SIZES[j], BenchWalk(SIZES[j]));
+        }
+    }
+
+    SetStackCheckMode(STACK_CHECK_MODE);
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static double BenchFill(const size_t size)
+{
+    Stack_t stk;
+    stk.init();
+
+    // small sizes are repeated, so every test does about the same amount of work
+    const size_t rounds = (WALK_OPS / size > 0) ? WALK_OPS / size : 1;
+
+    const double start = BenchSeconds();
+
+    for (size_t round = 0; round < rounds; round++)
+    {
+        for (size_t i = 0; i < size; i++)
+            stk.push((elem_t) i);
+
+        elem_t value = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            stk.pop(&value);
+            BENCH_SINK += (unsigned long long) value;
+        }
+    }
+
+    const double end = BenchSeconds();
+
+    stk.destroy();
+
+    return (end - start) * 1e9 / (double) (2 * size * rounds);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static double BenchWalk(const size_t depth)
+{
+    Stack_t stk;
+    stk.init();
+
+    // half of capacity is unused, so full checks have poison to scan
+    stk.reserve(2 * depth);
+
+    for (size_t i = 0; i + 1 < depth; i++)
+        stk.push((elem_t) i);
+
+    // full checks are O(capacity), so they get fewer operations on deep stacks
+    size_t sample_period = 0;
+    const size_t ops = (GetStackCheckMode(&sample_period) == STACK_CHECK_FULL) ? WALK_OPS / depth : WALK_OPS;
+
+    const double start = BenchSeconds();
+
+    elem_t value = 0;
+    for (size_t i = 0; i < ops; i++)
+    {
+        stk.push((elem_t) i);
+        stk.pop(&value);
+        BENCH_SINK += (unsigned long long) value;
+    }
+
+    const double end = BenchSeconds();
+
+    stk.destroy();
+
+    return (end - start) * 1e9 / (double) (2 * ops);
+}
@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+#include "tree/tree.h"
+#include "common/memory.h"
+#include "common/tasks.h"
+
+// Parallel tree walks with different amounts of threads: recount of stats (TreeCountStats only
+// copies stats of root), merkle hash, prefix print and destruction. Pool reads AKINATOR_THREADS once,
+// so every amount of threads is measured in its own child process. Hash and stats of tree must not
+// depend on amount of threads.
+
+static const size_t BALANCED_HEIGHT = 21;
+static const size_t NAME_LEN        = 16;
+// amounts of threads besides hardware concurrency, split path is measured even on one core
+static const size_t THREADS_AMTS[]  = {1, 2, 4};
+
+struct WalkResult
+{
+    hash_t hash;
+    size_t nodes;
+    size_t leaves;
+};
+
+static bool BenchThreads(const size_t threads_amt, WalkResult* result);
+static void BenchTree(WalkResult* result);
+
+static Node*       BuildBalancedTree(const size_t height, size_t* number);
+static node_data_t MakeName(const size_t number);
+
+//-----------------------------------------------------------------------------------------------------
+
+int main()
+{
+    printf("balanced, 2M nodes\n%-8s %10s %10s %10s %10s\n", "threads", "stats ms", "hash ms", "print ms",
+                                                            "dtor ms");
+    fflush(stdout);
+
+    const size_t hardware_amt = (size_t) sysconf(_SC_NPROCESSORS_ONLN);
+    const size_t amts_amt     = sizeof(THREADS_AMTS) / sizeof(THREADS_AMTS[0]);
+
+    WalkResult first = {};
+    bool       ok    = true;
+
+    for (size_t i = 0; i <= amts_amt && ok; i++)
+    {
+        // hardware concurrency is measured last, if it is not in list already
+        if (i == amts_amt && hardware_amt <= THREADS_AMTS[amts_amt - 1])
+            break;
+
+        const size_t threads_amt = (i < amts_amt) ? THREADS_AMTS[i] : hardware_amt;
+
+        WalkResult result = {};
+        ok = BenchThreads(threads_amt, &result);
+
+        if (ok && i == 0)
+            first = result;
+        else if (ok && (result.hash != first.hash || result.nodes != first.nodes || result.leaves != first.leaves))
+        {
+            printf("hash or stats with %zu threads differ from ones with one thread\n", threads_amt);
+            ok = false;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool BenchThreads(const size_t threads_amt, WalkResult* result)
+{
+    int result_pipe[2] = {};
+    if (pipe(result_pipe) != 0)
+        return false;
+
+    const pid_t pid = fork();
+    if (pid < 0)
+        return false;
+
+    if (pid == 0)
+    {
+        char env_amt[32] = {};
+        snprintf(env_amt, sizeof(env_amt), "%zu", threads_amt);
+        setenv(TASK_THREADS_ENV_VAR, env_amt, 1);
+
+        printf("%-8zu ", TaskThreadsAmt());
+
+        WalkResult child_result = {};
+        BenchTree(&child_result);
+
+        const bool written = (write(result_pipe[1], &child_result, sizeof(child_result)) ==
+                              (ssize_t) sizeof(child_result));
+        _exit(written ? 0 : 1);
+    }
+
+    close(result_pipe[1]);
+
+    const bool read_ok = (read(result_pipe[0], result, sizeof(*result)) == (ssize_t) sizeof(*result));
+    close(result_pipe[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    return read_ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void BenchTree(WalkResult* result)
+{
+    FILE* null_fp = fopen("/dev/null", "w");
+    if (null_fp == nullptr)
+        return;
+
+    size_t number = 0;
+    tree_t tree   = {};
+    tree.root     = BuildBalancedTree(BALANCED_HEIGHT, &number);
+
+    double start = BenchSeconds();
+    TreeRecountStats(&tree);
+    const double stats_time = BenchSeconds() - start;
+
+    start = BenchSeconds();
+    result->hash = TreeMerkleHash(&tree);
+    const double hash_time = BenchSeconds() - start;
+
+    start = BenchSeconds();
+    TreePrefixPrint(null_fp, &tree);
+    const double print_time = BenchSeconds() - start;
+
+    TreeStats stats = {};
+    TreeCountStats(&tree, &stats);
+    result->nodes  = stats.nodes;
+    result->leaves = stats.leaves;
+
+    start = BenchSeconds();
+    TreeDtor(&tree);
+    const double dtor_time = BenchSeconds() - start;
+
+    printf("%10.1lf %10.1lf %10.1lf %10.1lf\n", stats_time * 1e3, hash_time * 1e3, print_time * 1e3,
+                                                dtor_time * 1e3);
+    fflush(stdout);
+
+    fclose(null_fp);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static node_data_t MakeName(const size_t number)
+{
+    node_data_t name = (node_data_t) MemCalloc(MEM_STRINGS, NAME_LEN, sizeof(char));
+    if (name != nullptr)
+        snprintf(name, NAME_LEN, "node %zu", number);
+
+    return name;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+// height is small, so recursion is fine here
+static Node* BuildBalancedTree(const size_t height, size_t* number)
+{
+    if (height == 0)
+        return nullptr;
+
+    const size_t node_number = (*number)++;
+
+    Node* left  = BuildBalancedTree(height - 1, number);
+    Node* right = BuildBalancedTree(height - 1, number);
+
+    error_t error = {};
+    return NodeCtor(MakeName(node_number), left, right, &error);
+}
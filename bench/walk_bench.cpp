@@ -0,0 +1,259 @@
+#include <stdlib.h>
+
+#include "bench.h"
+#include "tree/tree.h"
+#include "tree/traversal.h"
+#include "common/memory.h"
+
+// Tree walks by traversal engine against the same walks written with recursion: prefix print,
+// hash of texts and destruction. Frame stack of engine is never checked, so mode of stack checks does
+// not matter here. Skewed tree is walked only by engine, recursion would overflow call stack on it.
+
+static const size_t BALANCED_HEIGHT = 21;
+static const size_t SKEWED_DEPTH    = 1000000;
+static const size_t NAME_LEN        = 16;
+
+static Node* BuildBalancedTree(const size_t height, size_t* number);
+static Node* BuildSkewedTree(const size_t depth);
+static void  BenchTree(const char* tree_name, const bool with_recursion, Node* (*build)());
+
+static Node*       BuildBalanced();
+static Node*       BuildSkewed();
+static node_data_t MakeName(const size_t number);
+
+static void   RecursivePrint(FILE* fp, const Node* node);
+static hash_t RecursiveHash(const Node* node, hash_t hash);
+static void   RecursiveDestruct(Node* node);
+
+static void   EnginePrint(FILE* fp, const Node* root);
+static hash_t EngineHash(const Node* root);
+static void   EngineDestruct(Node* root);
+
+//-----------------------------------------------------------------------------------------------------
+
+int main()
+{
+    BenchTree("balanced, 2M nodes", true,  BuildBalanced);
+    BenchTree("left-skewed, 1M deep", false, BuildSkewed);
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void BenchTree(const char* tree_name, const bool with_recursion, Node* (*build)())
+{
+    FILE* null_fp = fopen("/dev/null", "w");
+    if (null_fp == nullptr)
+        return;
+
+    printf("%s\n%-24s %10s %10s %10s\n", tree_name, "walk", "print ms", "hash ms", "dtor ms");
+
+    for (int walk = 0; walk < 2; walk++)
+    {
+        const bool recursive = (walk == 1);
+        if (recursive && !with_recursion)
+            break;
+
+        Node* root = build();
+        if (root == nullptr)
+            break;
+
+        double start = BenchSeconds();
+        if (recursive) RecursivePrint(null_fp, root);
+        else           EnginePrint(null_fp, root);
+        const double print_time = BenchSeconds() - start;
+
+        start = BenchSeconds();
+        BENCH_SINK += recursive ? RecursiveHash(root, 0) : EngineHash(root);
+        const double hash_time = BenchSeconds() - start;
+
+        start = BenchSeconds();
+        if (recursive) RecursiveDestruct(root);
+        else           EngineDestruct(root);
+        const double dtor_time = BenchSeconds() - start;
+
+        printf("%-24s %10.1lf %10.1lf %10.1lf\n", recursive ? "recursion" : "engine",
+               print_time * 1e3, hash_time * 1e3, dtor_time * 1e3);
+    }
+
+    fclose(null_fp);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static Node* BuildBalanced()
+{
+    size_t number = 0;
+    return BuildBalancedTree(BALANCED_HEIGHT, &number);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static Node* BuildSkewed()
+{
+    return BuildSkewedTree(SKEWED_DEPTH);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static node_data_t MakeName(const size_t number)
+{
+    node_data_t name = (node_data_t) MemCalloc(MEM_STRINGS, NAME_LEN, sizeof(char));
+    if (name != nullptr)
+        snprintf(name, NAME_LEN, "node %zu", number);
+
+    return name;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+// height is small, so recursion is fine here
+static Node* BuildBalancedTree(const size_t height, size_t* number)
+{
+    if (height == 0)
+        return nullptr;
+
+    const size_t node_number = (*number)++;
+
+    Node* left  = BuildBalancedTree(height - 1, number);
+    Node* right = BuildBalancedTree(height - 1, number);
+
+    error_t error = {};
+    return NodeCtor(MakeName(node_number), left, right, &error);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static Node* BuildSkewedTree(const size_t depth)
+{
+    Node*   node  = nullptr;
+    error_t error = {};
+
+    for (size_t i = depth; i > 0; i--)
+        node = NodeCtor(MakeName(i - 1), node, nullptr, &error);
+
+    return node;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void RecursivePrint(FILE* fp, const Node* node)
+{
+    if (node == nullptr)
+    {
+        fprintf(fp, " nil ");
+        return;
+    }
+
+    fprintf(fp, "\n(\"%s\"\n", node->data);
+    RecursivePrint(fp, node->left);
+    RecursivePrint(fp, node->right);
+    fprintf(fp, ")");
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static hash_t RecursiveHash(const Node* node, hash_t hash)
+{
+    if (node == nullptr)
+        return hash;
+
+    hash = (hash ^ (hash_t) (unsigned char) node->data[5]) * 1099511628211ULL;
+
+    return RecursiveHash(node->right, RecursiveHash(node->left, hash));
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void RecursiveDestruct(Node* node)
+{
+    if (node == nullptr)
+        return;
+
+    RecursiveDestruct(node->left);
+    RecursiveDestruct(node->right);
+    NodeDtor(node);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+struct BenchPrintVisitor : TreeVisitor<const Node>
+{
+    static const bool VISIT_POST = true;
+    static const bool VISIT_NIL  = true;
+
+    FILE* fp = nullptr;
+
+    TraverseAction pre(const Node* node, const TraversePos*)
+    {
+        fprintf(fp, "\n(\"%s\"\n", node->data);
+        return TRAVERSE_CONTINUE;
+    }
+
+    TraverseAction post(const Node*, const TraversePos*)
+    {
+        fprintf(fp, ")");
+        return TRAVERSE_CONTINUE;
+    }
+
+    TraverseAction nil(const TraversePos*)
+    {
+        fprintf(fp, " nil ");
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
+static void EnginePrint(FILE* fp, const Node* root)
+{
+    BenchPrintVisitor visitor = {};
+    visitor.fp = fp;
+
+    TraverseNodes(root, &visitor);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+struct BenchHashVisitor : TreeVisitor<const Node>
+{
+    hash_t hash = 0;
+
+    TraverseAction pre(const Node* node, const TraversePos*)
+    {
+        hash = (hash ^ (hash_t) (unsigned char) node->data[5]) * 1099511628211ULL;
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
+static hash_t EngineHash(const Node* root)
+{
+    BenchHashVisitor visitor = {};
+    TraverseNodes(root, &visitor);
+
+    return visitor.hash;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+struct BenchDestructVisitor : TreeVisitor<Node>
+{
+    static const bool VISIT_POST = true;
+
+    TraverseAction post(Node* node, const TraversePos*)
+    {
+        NodeDtor(node);
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
+static void EngineDestruct(Node* root)
+{
+    BenchDestructVisitor visitor = {};
+    TraverseNodes(root, &visitor);
+}
@@ -1,11 +1,19 @@
 #include <ctype.h>
 #include <assert.h>
 #include <stdarg.h>
+#include <string.h>
+#include <spawn.h>
+#include <sys/wait.h>
 
 #include "input_and_output.h"
 #include "colorlib.h"
+#include "trace.h"
+#include "memory.h"
+
+extern char** environ;
 
 static void ReadLine(FILE* fp, char* buf);
+static void SayLine(const char* line, const size_t len);
 
 //-----------------------------------------------------------------------------------------------------
 
@@ -70,7 +78,7 @@ char* GetDataFromLine(FILE* fp, error_t* error)
 {
     assert(error);
 
-    char* line = (char*) calloc(MAX_STRING_LEN, sizeof(char));
+    char* line = (char*) MemCalloc(MEM_STRINGS, MAX_STRING_LEN, sizeof(char));
     if (line == nullptr)
     {
         error->code = (int) ERRORS::ALLOCATE_MEMORY;
@@ -112,7 +120,11 @@ void PrintMenu()
     PrintCyanText(stdout, "CHOOSE PROGRAM MODE:\n"
                           "[G]UESS              [C]OMPARE\n"
                           "[D]ESCRIBE           [P]RINT TREE\n"
-                          "                     [Q]UIT\n", nullptr);
+                          "[S]TATS              [A]DAPTIVE GUESS\n"
+                          "[R]EBUILD TREE       [E]XPORT CATALOG\n"
+                          "[F]IND BY PROPERTIES [N]EAREST OBJECTS\n"
+                          "[W]ORD SEARCH        [M]ATRIX OF SIMILARITY\n"
+                          "[X] DIFF OF TREES    [Q]UIT\n", nullptr);
 }
 
 //-----------------------------------------------------------------------------------------------------
@@ -177,6 +189,8 @@ const char* GetInputFileName(const int argc, const char* argv[], error_t* error)
 
 int SayPhrase(const char *format, ...)
 {
+    TRACE_SPAN("SayPhrase");
+
     va_list arg;
     int done;
 
@@ -188,10 +202,55 @@ int SayPhrase(const char *format, ...)
 
     PrintCyanText(stdout, "%s", buf);
 
-    char cmd[MAX_COMMAND_LEN] = {};
-    snprintf(cmd, MAX_COMMAND_LEN, "say %s", buf);
-    system(cmd);
+    SayLine(buf, strlen(buf));
 
     return done;
 }
 
+//-----------------------------------------------------------------------------------------------------
+
+void SayText(const char* text)
+{
+    assert(text);
+
+    TRACE_SPAN("SayText");
+
+    PrintCyanText(stdout, "%s", text);
+
+    const char* line = text;
+
+    while (*line != '\0')
+    {
+        const size_t line_len = strcspn(line, "\n");
+
+        if (line_len > 0)
+            SayLine(line, line_len);
+
+        line += line_len;
+        if (*line == '\n')
+            line++;
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+// text goes to say as its argument, not through shell: names of objects come from user and data file
+static void SayLine(const char* line, const size_t len)
+{
+    assert(line);
+
+    char phrase[MAX_COMMAND_LEN] = {};
+    snprintf(phrase, MAX_COMMAND_LEN, "%.*s", (int) len, line);
+
+    char  say_name[] = "say";
+    char* say_argv[] = {say_name, phrase, nullptr};
+
+    pid_t pid = 0;
+
+    // there is no say on some systems, then text is only printed
+    if (posix_spawnp(&pid, say_name, nullptr, nullptr, say_argv, environ) != 0)
+        return;
+
+    waitpid(pid, nullptr, 0);
+}
+
@@ -21,6 +21,8 @@ const char* GetInputFileName(const int argc, const char* argv[], error_t* error)
 FILE* OpenInputFile(const char* file_name, error_t* error);
 
 int SayPhrase(const char *format, ...);
+// prints whole text (SayPhrase cuts it) and says it line by line
+void SayText(const char* text);
 
 void PrintMenu();
 
@@ -1,24 +1,97 @@
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <assert.h>
 #include <stdarg.h>
 #include <strings.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "logs.h"
+#include "memory.h"
 
 static FILE* __LOG_STREAM__ = stderr;
 
-static const char* EXTENSION = ".log.html";
+static const char EXTENSION[] = ".log.html";
+
+/// @brief single producer (owner thread) single consumer (flusher) ring of log text
+struct LogRing
+{
+    char*  buf;
+    size_t capacity;
+
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+
+    LogRing* next;
+};
+
+struct LogFlusher
+{
+    std::atomic<LogRing*> rings;
+
+    std::atomic<bool>   started;
+    std::atomic<bool>   stop;
+    std::atomic<int>    policy;
+    std::atomic<size_t> lost_records;
+
+    // rings of older generations are freed, threads must not use them
+    std::atomic<unsigned> generation;
+
+    std::mutex              lock;
+    std::condition_variable wake;
+    // flusher has freed space in rings (producers of LOG_OVERFLOW_BLOCK wait for it)
+    std::condition_variable drained;
+
+    char* write_buf;
+    // bytes copied in write_buf, that are not written yet (crash handler writes them before rings)
+    std::atomic<size_t> write_buf_size;
+
+    std::thread thread;
+};
+
+static LogFlusher LOG_FLUSHER = {};
+
+static thread_local LogRing* THREAD_RING            = nullptr;
+static thread_local unsigned THREAD_RING_GENERATION = 0;
+/// stream of dump that is being written by this thread (nullptr if none)
+static thread_local FILE*    THREAD_CAPTURE         = nullptr;
+
+static const int CRASH_SIGNALS[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+static void     StartLogFlusher();
+static void     StopLogFlusher();
+static void     LogFlusherLoop();
+static size_t   DrainRings(bool* any_data);
+static void     DrainRing(LogRing* ring, size_t* buf_size, size_t* written);
+static LogRing* GetThreadRing();
+static void     LogWrite(const char* text, size_t len);
+static size_t   RingFreeSpace(const LogRing* ring);
+static void     RingPush(LogRing* ring, const char* text, size_t len);
+static void     SetCrashHandlers();
+static void     CrashHandler(int sig);
+
+//-----------------------------------------------------------------------------------------------------
 
 void OpenLogFile(const char* FILE_NAME)
 {
-    char* file_name = strndup(FILE_NAME, MAX_FILE_NAME_LEN);
+    // name is cut to MAX_FILE_NAME_LEN, extension always fits
+    char file_name[MAX_FILE_NAME_LEN + sizeof(EXTENSION)] = {};
+    snprintf(file_name, sizeof(file_name), "%.*s%s", (int) MAX_FILE_NAME_LEN, FILE_NAME, EXTENSION);
 
-    __LOG_STREAM__ = fopen(strncat(file_name, EXTENSION, MAX_FILE_NAME_LEN + sizeof(EXTENSION)), "a");
+    __LOG_STREAM__ = fopen(file_name, "a");
 
     if (__LOG_STREAM__ == nullptr)
         __LOG_STREAM__ =  stderr;
 
+    // records are batched by flusher, so stream buffer only delays direct writes, that crash would lose
+    setvbuf(__LOG_STREAM__, nullptr, _IONBF, 0);
+
     time_t now = 0;
     time(&now);
 
@@ -37,20 +110,39 @@ void OpenLogFile(const char* FILE_NAME)
     #endif
     #pragma GCC diagnostic warning "-Wundef"
 
+    #if !DUMP_LOGS
+        fprintf(__LOG_STREAM__, "[DUMPS OFF]<br>\n");
+    #endif
+
     fprintf(__LOG_STREAM__, "<br>\n");
 
     atexit(CloseLogFile);
-    free(file_name);
+
+    StartLogFlusher();
 }
 
 //-----------------------------------------------------------------------------------------------------
 
 void CloseLogFile()
 {
+    StopLogFlusher();
+
+    // file is closed already (or was never opened), CloseLogFile is also called at exit
+    if (__LOG_STREAM__ == stderr)
+        return;
+
     fprintf(__LOG_STREAM__, "******************************************************************************<br>\n"
                             "============================ PROGRAM END ============================<br>\n"
                             "******************************************************************************<br>\n");
     fclose(__LOG_STREAM__);
+    __LOG_STREAM__ = stderr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void SetLogOverflowPolicy(const LogOverflowPolicy policy)
+{
+    LOG_FLUSHER.policy.store(policy, std::memory_order_relaxed);
 }
 
 //-----------------------------------------------------------------------------------------------------
@@ -60,7 +152,30 @@ int LogDump(dump_f dump_func, const void* stk, const char* func, const char* fil
     assert(dump_func);
     assert(stk);
 
-    return dump_func(__LOG_STREAM__, stk, func, file, line);
+    char*  text = nullptr;
+    size_t len  = 0;
+
+    FILE* capture = open_memstream(&text, &len);
+    if (capture == nullptr)
+        return dump_func(__LOG_STREAM__, stk, func, file, line);
+
+    // dump is collected whole, so records of other threads never get inside it
+    FILE* parent_capture = THREAD_CAPTURE;
+    THREAD_CAPTURE = capture;
+
+    int ret = dump_func(capture, stk, func, file, line);
+
+    THREAD_CAPTURE = parent_capture;
+    fclose(capture);
+
+    if (parent_capture != nullptr)
+        fwrite(text, 1, len, parent_capture);
+    else
+        LogWrite(text, len);
+
+    free(text);
+
+    return ret;
 }
 
 //-----------------------------------------------------------------------------------------------------
@@ -70,10 +185,377 @@ int PrintLog (const char *format, ...)
     va_list arg;
     int done;
 
+    if (THREAD_CAPTURE != nullptr)
+    {
+        va_start (arg, format);
+        done = vfprintf(THREAD_CAPTURE, format, arg);
+        va_end (arg);
+
+        return done;
+    }
+
+    char buf[MAX_LOG_RECORD_LEN] = {};
+
     va_start (arg, format);
-    done = vfprintf(__LOG_STREAM__, format, arg);
+    done = vsnprintf(buf, MAX_LOG_RECORD_LEN, format, arg);
     va_end (arg);
 
+    if (done < 0)
+        return done;
+
+    if ((size_t) done < MAX_LOG_RECORD_LEN)
+    {
+        LogWrite(buf, (size_t) done);
+        return done;
+    }
+
+    char* long_buf = (char*) MemCalloc(MEM_LOGS, (size_t) done + 1, sizeof(char));
+    if (long_buf == nullptr)
+        return -1;
+
+    va_start (arg, format);
+    done = vsnprintf(long_buf, (size_t) done + 1, format, arg);
+    va_end (arg);
+
+    LogWrite(long_buf, (size_t) done);
+    MemFree(long_buf);
+
     return done;
 }
 
+//-----------------------------------------------------------------------------------------------------
+
+static void LogWrite(const char* text, size_t len)
+{
+    assert(text);
+
+    if (!LOG_FLUSHER.started.load(std::memory_order_acquire))
+    {
+        fwrite(text, 1, len, __LOG_STREAM__);
+        return;
+    }
+
+    LogRing* ring = GetThreadRing();
+    if (ring == nullptr)
+    {
+        LOG_FLUSHER.lost_records.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    LogOverflowPolicy policy = (LogOverflowPolicy) LOG_FLUSHER.policy.load(std::memory_order_relaxed);
+
+    switch (policy)
+    {
+        case LOG_OVERFLOW_BLOCK:
+        {
+            // record longer than ring goes by pieces, flusher makes space for every next one
+            while (len > 0)
+            {
+                size_t piece = (len < ring->capacity) ? len : ring->capacity;
+
+                if (RingFreeSpace(ring) >= piece)
+                {
+                    RingPush(ring, text, piece);
+                    text += piece;
+                    len  -= piece;
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> guard(LOG_FLUSHER.lock);
+                LOG_FLUSHER.wake.notify_one();
+
+                // timeout only guards against flusher, that has been stopped meanwhile
+                LOG_FLUSHER.drained.wait_for(guard, std::chrono::milliseconds(LOG_FLUSH_PERIOD_MS),
+                                             [ring, piece] { return RingFreeSpace(ring) >= piece; });
+            }
+            break;
+        }
+
+        case LOG_OVERFLOW_COUNT:
+        // fall through
+        case LOG_OVERFLOW_DROP:
+        // fall through
+        default:
+        {
+            // record is pushed whole or dropped whole, part of dump would break html of log
+            if (RingFreeSpace(ring) < len)
+            {
+                if (policy == LOG_OVERFLOW_COUNT)
+                    LOG_FLUSHER.lost_records.fetch_add(1, std::memory_order_relaxed);
+
+                return;
+            }
+
+            RingPush(ring, text, len);
+            break;
+        }
+    }
+
+    if (RingFreeSpace(ring) < ring->capacity / 2)
+        LOG_FLUSHER.wake.notify_one();
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static LogRing* GetThreadRing()
+{
+    // ring of this thread might be freed by StopLogFlusher since last record
+    const unsigned generation = LOG_FLUSHER.generation.load(std::memory_order_acquire);
+
+    if (THREAD_RING != nullptr && THREAD_RING_GENERATION == generation)
+        return THREAD_RING;
+
+    LogRing* ring = (LogRing*) MemCalloc(MEM_LOGS, 1, sizeof(LogRing));
+    if (ring == nullptr)
+        return nullptr;
+
+    ring->buf = (char*) MemCalloc(MEM_LOGS, LOG_RING_CAPACITY, sizeof(char));
+    if (ring->buf == nullptr)
+    {
+        MemFree(ring);
+        return nullptr;
+    }
+
+    ring->capacity = LOG_RING_CAPACITY;
+
+    // rings are only added, never removed while flusher runs
+    LogRing* head = LOG_FLUSHER.rings.load(std::memory_order_relaxed);
+    do
+    {
+        ring->next = head;
+    } while (!LOG_FLUSHER.rings.compare_exchange_weak(head, ring, std::memory_order_release,
+                                                                   std::memory_order_relaxed));
+
+    THREAD_RING            = ring;
+    THREAD_RING_GENERATION = generation;
+
+    return ring;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static size_t RingFreeSpace(const LogRing* ring)
+{
+    assert(ring);
+
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    size_t tail = ring->tail.load(std::memory_order_acquire);
+
+    return ring->capacity - (head - tail);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void RingPush(LogRing* ring, const char* text, size_t len)
+{
+    assert(ring);
+    assert(text);
+
+    size_t head  = ring->head.load(std::memory_order_relaxed);
+    size_t pos   = head & (ring->capacity - 1);
+    size_t first = (len < ring->capacity - pos) ? len : ring->capacity - pos;
+
+    memcpy(ring->buf + pos, text, first);
+    memcpy(ring->buf, text + first, len - first);
+
+    ring->head.store(head + len, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void StartLogFlusher()
+{
+    LOG_FLUSHER.write_buf = (char*) MemCalloc(MEM_LOGS, LOG_WRITE_BUF_LEN, sizeof(char));
+    if (LOG_FLUSHER.write_buf == nullptr)
+        return;
+
+    LOG_FLUSHER.stop.store(false);
+    LOG_FLUSHER.thread = std::thread(LogFlusherLoop);
+
+    LOG_FLUSHER.started.store(true, std::memory_order_release);
+
+    SetCrashHandlers();
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void StopLogFlusher()
+{
+    if (!LOG_FLUSHER.started.load(std::memory_order_acquire))
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(LOG_FLUSHER.lock);
+        LOG_FLUSHER.stop.store(true);
+    }
+    LOG_FLUSHER.wake.notify_one();
+
+    LOG_FLUSHER.thread.join();
+
+    LOG_FLUSHER.started.store(false, std::memory_order_release);
+
+    // rings of all threads are freed, not only of this one: new generation makes others get new rings
+    LOG_FLUSHER.generation.fetch_add(1, std::memory_order_release);
+
+    LogRing* ring = LOG_FLUSHER.rings.exchange(nullptr);
+    while (ring != nullptr)
+    {
+        LogRing* next = ring->next;
+        MemFree(ring->buf);
+        MemFree(ring);
+        ring = next;
+    }
+    THREAD_RING = nullptr;
+
+    MemFree(LOG_FLUSHER.write_buf);
+    LOG_FLUSHER.write_buf = nullptr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void LogFlusherLoop()
+{
+    while (true)
+    {
+        bool any_data = false;
+        DrainRings(&any_data);
+
+        size_t lost = LOG_FLUSHER.lost_records.exchange(0, std::memory_order_relaxed);
+        if (lost != 0)
+            fprintf(__LOG_STREAM__, "<br>\n!!! %zu LOG RECORDS LOST (LOG RING OVERFLOW) !!!<br>\n", lost);
+
+        if (any_data || lost != 0)
+            fflush(__LOG_STREAM__);
+
+        std::unique_lock<std::mutex> guard(LOG_FLUSHER.lock);
+
+        if (any_data)
+            LOG_FLUSHER.drained.notify_all();
+
+        if (LOG_FLUSHER.stop.load())
+        {
+            guard.unlock();
+
+            // producers might have written something after last pass
+            DrainRings(&any_data);
+            fflush(__LOG_STREAM__);
+            return;
+        }
+
+        LOG_FLUSHER.wake.wait_for(guard, std::chrono::milliseconds(LOG_FLUSH_PERIOD_MS));
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static size_t DrainRings(bool* any_data)
+{
+    assert(any_data);
+
+    size_t written  = 0;
+    size_t buf_size = 0;
+
+    DrainRing(LOG_FLUSHER.rings.load(std::memory_order_acquire), &buf_size, &written);
+
+    if (buf_size != 0)
+    {
+        written += fwrite(LOG_FLUSHER.write_buf, 1, buf_size, __LOG_STREAM__);
+        LOG_FLUSHER.write_buf_size.store(0, std::memory_order_release);
+    }
+
+    *any_data = (written != 0);
+
+    return written;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void DrainRing(LogRing* ring, size_t* buf_size, size_t* written)
+{
+    assert(buf_size);
+    assert(written);
+
+    if (ring == nullptr)
+        return;
+
+    // list is newest first, oldest threads (main) are drained first
+    DrainRing(ring->next, buf_size, written);
+
+    size_t tail = ring->tail.load(std::memory_order_relaxed);
+    size_t head = ring->head.load(std::memory_order_acquire);
+
+    while (tail != head)
+    {
+        size_t pos   = tail & (ring->capacity - 1);
+        size_t avail = head - tail;
+        size_t piece = (avail < ring->capacity - pos) ? avail : ring->capacity - pos;
+
+        if (piece > LOG_WRITE_BUF_LEN - *buf_size)
+            piece = LOG_WRITE_BUF_LEN - *buf_size;
+
+        memcpy(LOG_FLUSHER.write_buf + *buf_size, ring->buf + pos, piece);
+        *buf_size += piece;
+        tail      += piece;
+
+        // bytes are counted in write_buf before they leave ring, so crash handler sees them in one of them
+        LOG_FLUSHER.write_buf_size.store(*buf_size, std::memory_order_release);
+        ring->tail.store(tail, std::memory_order_release);
+
+        if (*buf_size == LOG_WRITE_BUF_LEN)
+        {
+            *written += fwrite(LOG_FLUSHER.write_buf, 1, *buf_size, __LOG_STREAM__);
+            *buf_size = 0;
+
+            LOG_FLUSHER.write_buf_size.store(0, std::memory_order_release);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void SetCrashHandlers()
+{
+    struct sigaction action = {};
+    action.sa_handler = CrashHandler;
+    action.sa_flags   = (int) SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+
+    for (size_t i = 0; i < sizeof(CRASH_SIGNALS) / sizeof(CRASH_SIGNALS[0]); i++)
+        sigaction(CRASH_SIGNALS[i], &action, nullptr);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void CrashHandler(int sig)
+{
+    // only async-signal-safe calls: whatever is left in write buffer and rings goes straight to file
+    // descriptor. Stream is unbuffered, so nothing is left in it
+    int fd = fileno(__LOG_STREAM__);
+
+    // write buffer has older records than rings
+    size_t pending = LOG_FLUSHER.write_buf_size.load(std::memory_order_acquire);
+    if (pending != 0 && LOG_FLUSHER.write_buf != nullptr && write(fd, LOG_FLUSHER.write_buf, pending) < 0) {}
+
+    for (LogRing* ring = LOG_FLUSHER.rings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+
+        while (tail != head)
+        {
+            size_t pos   = tail & (ring->capacity - 1);
+            size_t avail = head - tail;
+            size_t piece = (avail < ring->capacity - pos) ? avail : ring->capacity - pos;
+
+            if (write(fd, ring->buf + pos, piece) <= 0)
+                break;
+
+            tail += piece;
+        }
+    }
+
+    static const char CRASH_MSG[] = "<br>\n!!! PROGRAM CRASHED, LOG FLUSHED !!!<br>\n";
+    if (write(fd, CRASH_MSG, sizeof(CRASH_MSG) - 1) < 0) {}
+
+    raise(sig);
+}
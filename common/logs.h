@@ -9,22 +9,70 @@
 * \brief Contains log functions
 */
 
-static const size_t MAX_FILE_NAME_LEN = 100;
+static const size_t MAX_FILE_NAME_LEN   = 100;
+
+/// longest record formatted on stack, longer ones are allocated
+static const size_t MAX_LOG_RECORD_LEN  = 1024;
+/// per-thread log ring size (power of 2)
+static const size_t LOG_RING_CAPACITY   = 1 << 18;
+/// flusher write buffer size
+static const size_t LOG_WRITE_BUF_LEN   = 1 << 16;
+/// how often flusher wakes up by itself
+static const int    LOG_FLUSH_PERIOD_MS = 50;
+
+#ifndef DUMP_LOGS
+/************************************************************//**
+ * @brief Dump records (DUMP_TREE, DUMP_NODE, STACK_DUMP)
+ *
+ * 1 for ON
+ * 0 for OFF (production builds, dumps are not even compiled)
+ ************************************************************/
+#define DUMP_LOGS 1
+
+#endif
+
+#if DUMP_LOGS
+#define ON_DUMP_LOGS(...) __VA_ARGS__
+
+#else
+#define ON_DUMP_LOGS(...) ;
+#endif
+
+/// @brief what happens with record if thread's log ring is full
+enum LogOverflowPolicy
+{
+    /// wait until flusher makes space
+    LOG_OVERFLOW_BLOCK = 0,
+    /// silently drop record, that does not fit in ring whole
+    LOG_OVERFLOW_DROP  = 1,
+    /// drop record and report amount of lost records in log
+    LOG_OVERFLOW_COUNT = 2
+};
 
 /************************************************************//**
- * @brief Opens log file, also close it when program shuts down
+ * @brief Opens log file, also close it when program shuts down.
+ * Starts flusher thread, that drains per-thread log rings into file,
+ * and crash handlers, that flush rings if program falls
  *
  * @param[in] FILE_NAME name of log file
  ************************************************************/
 void OpenLogFile(const char* FILE_NAME);
 
 /************************************************************//**
- * @brief Closes log file
+ * @brief Stops flusher thread, writes all left records and closes log file
  ************************************************************/
 void CloseLogFile();
 
 /************************************************************//**
- * @brief Dumping information in logs
+ * @brief Sets what to do with records when log ring is full
+ *
+ * @param[in] policy overflow policy
+ ************************************************************/
+void SetLogOverflowPolicy(const LogOverflowPolicy policy);
+
+/************************************************************//**
+ * @brief Dumping information in logs. Dump is collected whole
+ * and then written as one record
  *
  * @param[in] dump_func dumping function
  * @param[in] obj dumping object
@@ -0,0 +1,185 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <atomic>
+
+#include "memory.h"
+
+/// @brief prefix of every allocated block, keeps 16 byte alignment of memory after it
+struct alignas(16) MemHeader
+{
+    size_t      size;
+    MemCategory category;
+};
+
+struct MemCounters
+{
+    std::atomic<size_t> bytes;
+    std::atomic<size_t> blocks;
+    std::atomic<size_t> peak_bytes;
+    std::atomic<size_t> total_blocks;
+};
+
+static MemCounters         MEM_COUNTERS[MEM_CATEGORIES_AMT] = {};
+static std::atomic<size_t> MEM_TOTAL_BYTES                  = {};
+static std::atomic<size_t> MEM_TOTAL_PEAK                   = {};
+
+static const char* CATEGORY_NAMES[MEM_CATEGORIES_AMT] =
+{
+    "nodes",
+    "strings",
+    "stacks",
+    "logs",
+    "metrics",
+    "tasks",
+    "indexes",
+    "caches"
+};
+
+static void CountAlloc(const MemCategory category, const size_t size);
+static void CountFree(const MemCategory category, const size_t size);
+static void UpdatePeak(std::atomic<size_t>* peak, const size_t value);
+
+//-----------------------------------------------------------------------------------------------------
+
+void* MemCalloc(const MemCategory category, const size_t amount, const size_t size)
+{
+    assert(category < MEM_CATEGORIES_AMT);
+
+    if (size != 0 && amount > (SIZE_MAX - sizeof(MemHeader)) / size)
+        return nullptr;
+
+    size_t bytes = amount * size;
+
+    MemHeader* header = (MemHeader*) calloc(1, sizeof(MemHeader) + bytes);
+    if (header == nullptr)
+        return nullptr;
+
+    header->size     = bytes;
+    header->category = category;
+
+    CountAlloc(category, bytes);
+
+    return header + 1;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void* MemRealloc(const MemCategory category, void* ptr, const size_t new_size)
+{
+    if (ptr == nullptr)
+        return MemCalloc(category, 1, new_size);
+
+    MemHeader* header = (MemHeader*) ptr - 1;
+
+    size_t      old_size     = header->size;
+    MemCategory old_category = header->category;
+
+    MemHeader* new_header = (MemHeader*) realloc(header, sizeof(MemHeader) + new_size);
+    if (new_header == nullptr)
+        return nullptr;
+
+    new_header->size = new_size;
+
+    CountFree(old_category, old_size);
+    CountAlloc(old_category, new_size);
+
+    return new_header + 1;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+char* MemStrdup(const MemCategory category, const char* str)
+{
+    assert(str);
+
+    size_t len = strlen(str);
+
+    char* copy = (char*) MemCalloc(category, len + 1, sizeof(char));
+    if (copy == nullptr)
+        return nullptr;
+
+    memcpy(copy, str, len);
+
+    return copy;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void MemFree(void* ptr)
+{
+    if (ptr == nullptr)
+        return;
+
+    MemHeader* header = (MemHeader*) ptr - 1;
+
+    CountFree(header->category, header->size);
+
+    free(header);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void PrintMemoryStats(FILE* fp)
+{
+    assert(fp);
+
+    fprintf(fp, "=========================== MEMORY ===========================\n"
+                "%-10s %14s %10s %14s %12s\n", "category", "bytes", "blocks", "peak bytes", "allocations");
+
+    for (size_t i = 0; i < MEM_CATEGORIES_AMT; i++)
+    {
+        const MemCounters* counters = &MEM_COUNTERS[i];
+
+        fprintf(fp, "%-10s %14zu %10zu %14zu %12zu\n", CATEGORY_NAMES[i],
+                    counters->bytes.load(std::memory_order_relaxed),
+                    counters->blocks.load(std::memory_order_relaxed),
+                    counters->peak_bytes.load(std::memory_order_relaxed),
+                    counters->total_blocks.load(std::memory_order_relaxed));
+    }
+
+    fprintf(fp, "%-10s %14zu %10s %14zu\n", "total",
+                MEM_TOTAL_BYTES.load(std::memory_order_relaxed), "",
+                MEM_TOTAL_PEAK.load(std::memory_order_relaxed));
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void CountAlloc(const MemCategory category, const size_t size)
+{
+    MemCounters* counters = &MEM_COUNTERS[category];
+
+    size_t bytes = counters->bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    counters->blocks.fetch_add(1, std::memory_order_relaxed);
+    counters->total_blocks.fetch_add(1, std::memory_order_relaxed);
+
+    UpdatePeak(&counters->peak_bytes, bytes);
+
+    size_t total = MEM_TOTAL_BYTES.fetch_add(size, std::memory_order_relaxed) + size;
+    UpdatePeak(&MEM_TOTAL_PEAK, total);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void CountFree(const MemCategory category, const size_t size)
+{
+    MemCounters* counters = &MEM_COUNTERS[category];
+
+    counters->bytes.fetch_sub(size, std::memory_order_relaxed);
+    counters->blocks.fetch_sub(1, std::memory_order_relaxed);
+
+    MEM_TOTAL_BYTES.fetch_sub(size, std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void UpdatePeak(std::atomic<size_t>* peak, const size_t value)
+{
+    assert(peak);
+
+    size_t old_peak = peak->load(std::memory_order_relaxed);
+
+    while (value > old_peak &&
+           !peak->compare_exchange_weak(old_peak, value, std::memory_order_relaxed)) {}
+}
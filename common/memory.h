@@ -0,0 +1,76 @@
+#ifndef __MEMORY_H_
+#define __MEMORY_H_
+
+/*! \file
+* \brief Contains allocation functions, that count memory by categories
+*/
+
+#include <stdio.h>
+
+/// @brief list of memory categories
+enum MemCategory
+{
+    /// tree nodes
+    MEM_NODES,
+    /// node texts and user input lines
+    MEM_STRINGS,
+    /// stacks buffers
+    MEM_STACKS,
+    /// log and trace buffers
+    MEM_LOGS,
+    /// metrics histograms
+    MEM_METRICS,
+    /// task deques and parallel output chunks
+    MEM_TASKS,
+    /// indexes and matrices built from tree
+    MEM_INDEXES,
+    /// cached texts of describe and compare modes
+    MEM_CACHES,
+
+    MEM_CATEGORIES_AMT
+};
+
+/************************************************************//**
+ * @brief Allocates zeroed memory and counts it in category
+ *
+ * @param[in] category memory category
+ * @param[in] amount amount of elements
+ * @param[in] size element size
+ * @return void* memory (nullptr if allocation failed)
+ ************************************************************/
+void* MemCalloc(const MemCategory category, const size_t amount, const size_t size);
+
+/************************************************************//**
+ * @brief Reallocates memory got from MemCalloc
+ *
+ * @param[in] category category for new memory (if ptr is nullptr, old memory keeps its own)
+ * @param[in] ptr memory (nullptr allocates new)
+ * @param[in] new_size new size
+ * @return void* memory (nullptr if allocation failed, old memory stays valid)
+ ************************************************************/
+void* MemRealloc(const MemCategory category, void* ptr, const size_t new_size);
+
+/************************************************************//**
+ * @brief Copies string in memory of category
+ *
+ * @param[in] category memory category
+ * @param[in] str string
+ * @return char* copy (nullptr if allocation failed)
+ ************************************************************/
+char* MemStrdup(const MemCategory category, const char* str);
+
+/************************************************************//**
+ * @brief Frees memory got from MemCalloc, MemRealloc or MemStrdup
+ *
+ * @param[in] ptr memory (nullptr is ignored)
+ ************************************************************/
+void MemFree(void* ptr);
+
+/************************************************************//**
+ * @brief Prints bytes, blocks and high-water marks of all categories
+ *
+ * @param[in] fp output stream
+ ************************************************************/
+void PrintMemoryStats(FILE* fp);
+
+#endif
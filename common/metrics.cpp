@@ -0,0 +1,305 @@
+#include <stdlib.h>
+#include <time.h>
+#include <assert.h>
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "metrics.h"
+#include "memory.h"
+
+static const size_t SUB_BUCKETS_AMT = 1 << METRICS_SUB_BUCKET_BITS;
+static const size_t BUCKETS_AMT     = (64 - METRICS_SUB_BUCKET_BITS + 1) * SUB_BUCKETS_AMT;
+
+struct Histogram
+{
+    std::atomic<unsigned long long> buckets[BUCKETS_AMT];
+    std::atomic<unsigned long long> count;
+    std::atomic<unsigned long long> sum;
+};
+
+struct MetricsRegistry
+{
+    std::atomic<unsigned long long> counters[COUNTERS_AMT];
+    std::atomic<Histogram*>         histograms;
+
+    char                    prom_file[FILENAME_MAX];
+    std::mutex              lock;
+    std::condition_variable wake;
+    bool                    stop;
+    std::thread             exporter;
+};
+
+static MetricsRegistry METRICS = {};
+
+static const char* COUNTER_NAMES[COUNTERS_AMT] =
+{
+    "questions_asked",
+    "guesses",
+    "learn_events",
+    "describe_lookups",
+    "compare_lookups",
+    "nearest_lookups",
+    "bytes_written",
+    "cache_hits",
+    "cache_misses",
+    "cache_invalidations"
+};
+
+static const char* HISTOGRAM_NAMES[HISTOGRAMS_AMT] =
+{
+    "parse",
+    "save",
+    "lookup",
+    "answer"
+};
+
+static const double QUANTILES[] = {0.5, 0.9, 0.99};
+
+static const char* EXTENSION = ".prom";
+
+static size_t             GetBucketIndex(const unsigned long long value);
+static unsigned long long GetBucketValue(const size_t index);
+static unsigned long long GetQuantile(const Histogram* histogram, const double quantile);
+static void               ExportMetrics();
+static void               WritePrometheusFile(const char* prom_file);
+static long long          GetTimeNs();
+
+//-----------------------------------------------------------------------------------------------------
+
+void OpenMetricsFile(const char* DATA_FILE)
+{
+    assert(DATA_FILE);
+
+    Histogram* histograms = (Histogram*) MemCalloc(MEM_METRICS, HISTOGRAMS_AMT, sizeof(Histogram));
+    if (histograms == nullptr)
+        return;
+
+    METRICS.histograms.store(histograms, std::memory_order_release);
+
+    const char* env_file = getenv(METRICS_ENV_VAR);
+    if (env_file != nullptr)
+        snprintf(METRICS.prom_file, FILENAME_MAX, "%s", env_file);
+    else
+        snprintf(METRICS.prom_file, FILENAME_MAX, "%s%s", DATA_FILE, EXTENSION);
+
+    METRICS.stop     = false;
+    METRICS.exporter = std::thread(ExportMetrics);
+
+    atexit(CloseMetricsFile);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void CloseMetricsFile()
+{
+    if (!METRICS.exporter.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(METRICS.lock);
+        METRICS.stop = true;
+    }
+    METRICS.wake.notify_one();
+
+    METRICS.exporter.join();
+
+    WritePrometheusFile(METRICS.prom_file);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void MetricAdd(const MetricCounter counter, const unsigned long long value)
+{
+    assert(counter < COUNTERS_AMT);
+
+    METRICS.counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void MetricRecord(const MetricHistogram histogram, const long long value_ns)
+{
+    assert(histogram < HISTOGRAMS_AMT);
+
+    Histogram* histograms = METRICS.histograms.load(std::memory_order_acquire);
+    if (histograms == nullptr)
+        return;
+
+    unsigned long long value = (value_ns > 0) ? (unsigned long long) value_ns : 0;
+
+    Histogram* hist = &histograms[histogram];
+
+    hist->buckets[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    hist->count.fetch_add(1, std::memory_order_relaxed);
+    hist->sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void PrintMetrics(FILE* fp)
+{
+    assert(fp);
+
+    fprintf(fp, "========== COUNTERS ==========\n");
+
+    for (size_t i = 0; i < COUNTERS_AMT; i++)
+        fprintf(fp, "%-20s %llu\n", COUNTER_NAMES[i], METRICS.counters[i].load(std::memory_order_relaxed));
+
+    const Histogram* histograms = METRICS.histograms.load(std::memory_order_acquire);
+    if (histograms == nullptr)
+        return;
+
+    fprintf(fp, "========= LATENCY (ms) =========\n"
+                "%-10s %10s %10s %10s %10s\n", "operation", "count", "p50", "p90", "p99");
+
+    for (size_t i = 0; i < HISTOGRAMS_AMT; i++)
+    {
+        const Histogram* hist = &histograms[i];
+
+        fprintf(fp, "%-10s %10llu %10.3lf %10.3lf %10.3lf\n", HISTOGRAM_NAMES[i],
+                    hist->count.load(std::memory_order_relaxed),
+                    (double) GetQuantile(hist, QUANTILES[0]) / 1e6,
+                    (double) GetQuantile(hist, QUANTILES[1]) / 1e6,
+                    (double) GetQuantile(hist, QUANTILES[2]) / 1e6);
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+MetricTimer::MetricTimer(const MetricHistogram timer_histogram) :
+    histogram (timer_histogram),
+    start     (GetTimeNs())
+{}
+
+//-----------------------------------------------------------------------------------------------------
+
+MetricTimer::~MetricTimer()
+{
+    MetricRecord(histogram, GetTimeNs() - start);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static size_t GetBucketIndex(const unsigned long long value)
+{
+    if (value < SUB_BUCKETS_AMT)
+        return (size_t) value;
+
+    size_t exponent = 63 - (size_t) __builtin_clzll(value);
+    size_t shift    = exponent - METRICS_SUB_BUCKET_BITS;
+    size_t sub      = (size_t) (value >> shift) & (SUB_BUCKETS_AMT - 1);
+
+    return (shift + 1) * SUB_BUCKETS_AMT + sub;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static unsigned long long GetBucketValue(const size_t index)
+{
+    if (index < SUB_BUCKETS_AMT)
+        return index;
+
+    size_t shift = index / SUB_BUCKETS_AMT - 1;
+    size_t sub   = index % SUB_BUCKETS_AMT;
+
+    // middle of bucket
+    unsigned long long low = (unsigned long long) (SUB_BUCKETS_AMT + sub) << shift;
+    return low + ((1ULL << shift) >> 1);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static unsigned long long GetQuantile(const Histogram* histogram, const double quantile)
+{
+    assert(histogram);
+
+    unsigned long long count = histogram->count.load(std::memory_order_relaxed);
+    if (count == 0)
+        return 0;
+
+    unsigned long long rank = (unsigned long long) (quantile * (double) count);
+    if (rank >= count)
+        rank = count - 1;
+
+    unsigned long long seen = 0;
+
+    for (size_t i = 0; i < BUCKETS_AMT; i++)
+    {
+        seen += histogram->buckets[i].load(std::memory_order_relaxed);
+        if (seen > rank)
+            return GetBucketValue(i);
+    }
+
+    return GetBucketValue(BUCKETS_AMT - 1);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void ExportMetrics()
+{
+    std::unique_lock<std::mutex> guard(METRICS.lock);
+
+    while (!METRICS.stop)
+    {
+        METRICS.wake.wait_for(guard, std::chrono::seconds(METRICS_EXPORT_PERIOD_S));
+
+        if (!METRICS.stop)
+            WritePrometheusFile(METRICS.prom_file);
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void WritePrometheusFile(const char* prom_file)
+{
+    assert(prom_file);
+
+    // file is replaced at once, so scrapers never see half written metrics
+    char tmp_file[FILENAME_MAX] = {};
+    snprintf(tmp_file, FILENAME_MAX, "%s.tmp", prom_file);
+
+    FILE* fp = fopen(tmp_file, "w");
+    if (fp == nullptr)
+        return;
+
+    for (size_t i = 0; i < COUNTERS_AMT; i++)
+    {
+        fprintf(fp, "# TYPE akinator_%s_total counter\n"
+                    "akinator_%s_total %llu\n", COUNTER_NAMES[i], COUNTER_NAMES[i],
+                    METRICS.counters[i].load(std::memory_order_relaxed));
+    }
+
+    const Histogram* histograms = METRICS.histograms.load(std::memory_order_acquire);
+
+    for (size_t i = 0; histograms != nullptr && i < HISTOGRAMS_AMT; i++)
+    {
+        const Histogram* hist = &histograms[i];
+
+        fprintf(fp, "# TYPE akinator_%s_seconds summary\n", HISTOGRAM_NAMES[i]);
+
+        for (size_t q = 0; q < sizeof(QUANTILES) / sizeof(QUANTILES[0]); q++)
+            fprintf(fp, "akinator_%s_seconds{quantile=\"%g\"} %.9lf\n", HISTOGRAM_NAMES[i], QUANTILES[q],
+                        (double) GetQuantile(hist, QUANTILES[q]) / 1e9);
+
+        fprintf(fp, "akinator_%s_seconds_sum %.9lf\n"
+                    "akinator_%s_seconds_count %llu\n",
+                    HISTOGRAM_NAMES[i], (double) hist->sum.load(std::memory_order_relaxed) / 1e9,
+                    HISTOGRAM_NAMES[i], hist->count.load(std::memory_order_relaxed));
+    }
+
+    fclose(fp);
+    rename(tmp_file, prom_file);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static long long GetTimeNs()
+{
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
@@ -0,0 +1,118 @@
+#ifndef __METRICS_H_
+#define __METRICS_H_
+
+/*! \file
+* \brief Contains hot path metrics (counters and latency histograms)
+*/
+
+#include <stdio.h>
+
+/// environment variable with metrics file name, by default metrics are written next to data file
+static const char* const METRICS_ENV_VAR = "AKINATOR_METRICS";
+/// how often metrics are written in prometheus file (seconds)
+static const int    METRICS_EXPORT_PERIOD_S = 10;
+/// histogram keeps 2^SUB_BUCKET_BITS buckets for every power of two (~6% precision)
+static const size_t METRICS_SUB_BUCKET_BITS = 4;
+
+/// @brief list of counters
+enum MetricCounter
+{
+    /// questions answered by user in guess mode
+    QUESTIONS_ASKED,
+    /// objects named in the end of guess mode
+    GUESSES,
+    /// new objects learned
+    LEARN_EVENTS,
+    /// objects searched in describe mode
+    DESCRIBE_LOOKUPS,
+    /// objects searched in compare mode
+    COMPARE_LOOKUPS,
+    /// objects searched in nearest objects mode
+    NEAREST_LOOKUPS,
+    /// bytes written in data base
+    BYTES_WRITTEN,
+    /// describe and compare texts taken from cache
+    DESCRIBE_CACHE_HITS,
+    /// describe and compare texts rendered from tree
+    DESCRIBE_CACHE_MISSES,
+    /// cached texts dropped because tree has changed
+    DESCRIBE_CACHE_INVALIDATIONS,
+
+    COUNTERS_AMT
+};
+
+/// @brief list of latency histograms (nanoseconds)
+enum MetricHistogram
+{
+    /// data base parsing
+    PARSE_TIME,
+    /// data base saving
+    SAVE_TIME,
+    /// object search in tree
+    LOOKUP_TIME,
+    /// user answer to one question
+    ANSWER_TIME,
+
+    HISTOGRAMS_AMT
+};
+
+/************************************************************//**
+ * @brief Allocates metrics and starts writing them in prometheus
+ * text format file every METRICS_EXPORT_PERIOD_S seconds: file from
+ * METRICS_ENV_VAR if it is set, DATA_FILE.prom otherwise
+ *
+ * @param[in] DATA_FILE name of data file
+ ************************************************************/
+void OpenMetricsFile(const char* DATA_FILE);
+
+/************************************************************//**
+ * @brief Stops exporter, writes metrics last time
+ ************************************************************/
+void CloseMetricsFile();
+
+/************************************************************//**
+ * @brief Adds value to counter
+ *
+ * @param[in] counter counter
+ * @param[in] value added value
+ ************************************************************/
+void MetricAdd(const MetricCounter counter, const unsigned long long value = 1);
+
+/************************************************************//**
+ * @brief Records value in histogram
+ *
+ * @param[in] histogram histogram
+ * @param[in] value_ns recorded latency
+ ************************************************************/
+void MetricRecord(const MetricHistogram histogram, const long long value_ns);
+
+/************************************************************//**
+ * @brief Prints counters and p50/p90/p99 of histograms
+ *
+ * @param[in] fp output stream
+ ************************************************************/
+void PrintMetrics(FILE* fp);
+
+/// @brief RAII timer, records its life time in histogram
+struct MetricTimer
+{
+    MetricHistogram histogram;
+    long long       start;
+
+    explicit MetricTimer(const MetricHistogram timer_histogram);
+    ~MetricTimer();
+
+    MetricTimer(const MetricTimer&)            = delete;
+    MetricTimer& operator=(const MetricTimer&) = delete;
+};
+
+#ifdef METRIC_TIMER
+#undef METRIC_TIMER
+
+#endif
+#define METRIC_CONCAT_(a, b) a##b
+#define METRIC_CONCAT(a, b)  METRIC_CONCAT_(a, b)
+
+#define METRIC_TIMER(histogram)     MetricTimer METRIC_CONCAT(metric_timer_, __LINE__)(histogram)
+
+#endif
@@ -0,0 +1,309 @@
+#include <stdlib.h>
+#include <assert.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "tasks.h"
+#include "trace.h"
+#include "memory.h"
+
+struct Task
+{
+    task_f     func;
+    void*      arg;
+    TaskGroup* group;
+};
+
+/// @brief ring of tasks. Owner takes newest task (its subtree is hot in cache), thieves take oldest (biggest)
+struct TaskDeque
+{
+    std::mutex lock;
+
+    Task*  tasks;
+    size_t head;
+    size_t size;
+};
+
+struct TaskPool
+{
+    std::mutex              lock;
+    std::condition_variable has_task;
+
+    std::atomic<bool>   started;
+    std::atomic<size_t> queued;
+    std::atomic<size_t> sleeping;
+    bool                stop;
+
+    size_t threads_amt;
+
+    // deque 0 belongs to threads, that are not workers
+    TaskDeque   deques[TASK_THREADS_MAX];
+    std::thread workers[TASK_THREADS_MAX];
+};
+
+static TaskPool TASK_POOL = {};
+
+static thread_local size_t THREAD_SLOT = 0;
+
+static bool StartTaskWorkers();
+static void StopTaskWorkers();
+static void TaskWorker(const size_t slot);
+
+static bool PushTask(TaskDeque* deque, const Task* task);
+static bool PopTask(TaskDeque* deque, Task* task);
+static bool StealTask(TaskDeque* deque, Task* task);
+static bool RunOneTask(const size_t slot);
+static void RunTask(const Task* task);
+
+//-----------------------------------------------------------------------------------------------------
+
+size_t TaskThreadsAmt()
+{
+    static const size_t THREADS_AMT = []
+    {
+        size_t amt = std::thread::hardware_concurrency();
+
+        const char* env_amt = getenv(TASK_THREADS_ENV_VAR);
+        if (env_amt != nullptr)
+            amt = strtoul(env_amt, nullptr, 10);
+
+        if (amt == 0)
+            amt = 1;
+
+        return (amt < TASK_THREADS_MAX) ? amt : TASK_THREADS_MAX;
+    }();
+
+    return THREADS_AMT;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void TaskSpawn(TaskGroup* group, task_f func, void* arg)
+{
+    assert(group);
+    assert(func);
+
+    const Task task = {func, arg, group};
+
+    group->pending.fetch_add(1, std::memory_order_relaxed);
+
+    // without workers task is run at once, so caller gets sequential walk
+    if (!StartTaskWorkers())
+    {
+        RunTask(&task);
+        return;
+    }
+
+    // counter goes first, so thief never decrements it below zero
+    TASK_POOL.queued.fetch_add(1);
+
+    if (!PushTask(&TASK_POOL.deques[THREAD_SLOT], &task))
+    {
+        TASK_POOL.queued.fetch_sub(1);
+        RunTask(&task);
+        return;
+    }
+
+    if (TASK_POOL.sleeping.load() > 0)
+    {
+        // lock makes sure, that worker is already waiting and does not miss notification
+        {
+            std::lock_guard<std::mutex> guard(TASK_POOL.lock);
+        }
+
+        TASK_POOL.has_task.notify_one();
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void TaskWait(TaskGroup* group)
+{
+    assert(group);
+
+    while (group->pending.load(std::memory_order_acquire) > 0)
+    {
+        if (!RunOneTask(THREAD_SLOT))
+            std::this_thread::yield();
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool StartTaskWorkers()
+{
+    if (TASK_POOL.started.load(std::memory_order_acquire))
+        return true;
+
+    const size_t threads_amt = TaskThreadsAmt();
+    if (threads_amt < 2)
+        return false;
+
+    std::lock_guard<std::mutex> guard(TASK_POOL.lock);
+
+    if (TASK_POOL.started.load(std::memory_order_relaxed))
+        return true;
+
+    for (size_t i = 0; i < threads_amt; i++)
+    {
+        TASK_POOL.deques[i].tasks = (Task*) MemCalloc(MEM_TASKS, TASK_DEQUE_CAPACITY, sizeof(Task));
+        if (TASK_POOL.deques[i].tasks != nullptr)
+            continue;
+
+        // walks go on in one thread, next call tries again from the first deque
+        for (size_t j = 0; j < i; j++)
+        {
+            MemFree(TASK_POOL.deques[j].tasks);
+            TASK_POOL.deques[j].tasks = nullptr;
+        }
+
+        return false;
+    }
+
+    TASK_POOL.threads_amt = threads_amt;
+
+    for (size_t i = 1; i < threads_amt; i++)
+        TASK_POOL.workers[i] = std::thread(TaskWorker, i);
+
+    TASK_POOL.started.store(true, std::memory_order_release);
+
+    atexit(StopTaskWorkers);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void StopTaskWorkers()
+{
+    {
+        std::lock_guard<std::mutex> guard(TASK_POOL.lock);
+        TASK_POOL.stop = true;
+    }
+
+    TASK_POOL.has_task.notify_all();
+
+    for (size_t i = 1; i < TASK_POOL.threads_amt; i++)
+    {
+        if (TASK_POOL.workers[i].joinable())
+            TASK_POOL.workers[i].join();
+    }
+
+    for (size_t i = 0; i < TASK_POOL.threads_amt; i++)
+        MemFree(TASK_POOL.deques[i].tasks);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void TaskWorker(const size_t slot)
+{
+    TraceThreadName("task worker");
+
+    THREAD_SLOT = slot;
+
+    while (true)
+    {
+        if (RunOneTask(slot))
+            continue;
+
+        std::unique_lock<std::mutex> guard(TASK_POOL.lock);
+
+        TASK_POOL.sleeping.fetch_add(1);
+        TASK_POOL.has_task.wait(guard, []{ return TASK_POOL.queued.load() > 0 || TASK_POOL.stop; });
+        TASK_POOL.sleeping.fetch_sub(1);
+
+        if (TASK_POOL.stop && TASK_POOL.queued.load() == 0)
+            return;
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool PushTask(TaskDeque* deque, const Task* task)
+{
+    assert(deque);
+    assert(task);
+
+    std::lock_guard<std::mutex> guard(deque->lock);
+
+    if (deque->size == TASK_DEQUE_CAPACITY)
+        return false;
+
+    deque->tasks[(deque->head + deque->size) % TASK_DEQUE_CAPACITY] = *task;
+    deque->size++;
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool PopTask(TaskDeque* deque, Task* task)
+{
+    assert(deque);
+    assert(task);
+
+    std::lock_guard<std::mutex> guard(deque->lock);
+
+    if (deque->size == 0)
+        return false;
+
+    deque->size--;
+    *task = deque->tasks[(deque->head + deque->size) % TASK_DEQUE_CAPACITY];
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool StealTask(TaskDeque* deque, Task* task)
+{
+    assert(deque);
+    assert(task);
+
+    std::lock_guard<std::mutex> guard(deque->lock);
+
+    if (deque->size == 0)
+        return false;
+
+    *task = deque->tasks[deque->head];
+    deque->head = (deque->head + 1) % TASK_DEQUE_CAPACITY;
+    deque->size--;
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool RunOneTask(const size_t slot)
+{
+    if (TASK_POOL.queued.load() == 0)
+        return false;
+
+    const size_t threads_amt = TASK_POOL.threads_amt;
+
+    Task task  = {};
+    bool found = PopTask(&TASK_POOL.deques[slot], &task);
+
+    for (size_t i = 1; i < threads_amt && !found; i++)
+        found = StealTask(&TASK_POOL.deques[(slot + i) % threads_amt], &task);
+
+    if (!found)
+        return false;
+
+    TASK_POOL.queued.fetch_sub(1);
+    RunTask(&task);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void RunTask(const Task* task)
+{
+    assert(task);
+
+    task->func(task->arg);
+    task->group->pending.fetch_sub(1, std::memory_order_release);
+}
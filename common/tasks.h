@@ -0,0 +1,53 @@
+#ifndef __TASKS_H_
+#define __TASKS_H_
+
+/*! \file
+* \brief Contains work-stealing task pool for fork-join algorithms
+*/
+
+#include <stdio.h>
+
+#include <atomic>
+
+/// environment variable with amount of threads (hardware concurrency is used if it is not set)
+static const char* const TASK_THREADS_ENV_VAR = "AKINATOR_THREADS";
+/// max amount of threads in pool (including thread that waits for tasks)
+static const size_t TASK_THREADS_MAX     = 64;
+/// tasks in one thread deque, task is run at once by spawning thread if deque is full
+static const size_t TASK_DEQUE_CAPACITY  = 1024;
+
+/// @brief task function
+typedef void (*task_f)(void* arg);
+
+/// @brief group of tasks, that are waited together
+struct TaskGroup
+{
+    /// amount of spawned and not finished tasks
+    std::atomic<size_t> pending;
+};
+
+/************************************************************//**
+ * @brief Returns amount of threads, that run tasks (workers and thread that waits)
+ *
+ * @return size_t amount of threads
+ ************************************************************/
+size_t TaskThreadsAmt();
+
+/************************************************************//**
+ * @brief Puts task in deque of current thread. Idle threads steal it from there.
+ * Workers are started on first spawn and stopped when program shuts down
+ *
+ * @param[in] group task group
+ * @param[in] func task function
+ * @param[in] arg task argument (must live until TaskWait returns)
+ ************************************************************/
+void TaskSpawn(TaskGroup* group, task_f func, void* arg);
+
+/************************************************************//**
+ * @brief Waits until all tasks of group are finished. Runs own and stolen tasks while waiting
+ *
+ * @param[in] group task group
+ ************************************************************/
+void TaskWait(TaskGroup* group);
+
+#endif
@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <time.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "trace.h"
+#include "memory.h"
+
+struct TraceEvent
+{
+    const char* name;
+    long long   start;
+    long long   duration;
+};
+
+struct TraceBuffer
+{
+    TraceEvent* events;
+    size_t      size;
+    long        tid;
+
+    TraceBuffer* next;
+};
+
+struct Tracer
+{
+    std::atomic<bool> enabled;
+
+    std::mutex   lock;
+    FILE*        file;
+    bool         have_events;
+    TraceBuffer* buffers;
+    long long    start_time;
+};
+
+static Tracer TRACER = {};
+
+static thread_local TraceBuffer* THREAD_BUFFER = nullptr;
+
+static long long    GetTimeNs();
+static TraceBuffer* GetThreadBuffer();
+static void         WriteTraceBuffer(TraceBuffer* buffer);
+static void         WriteEventSeparator();
+
+//-----------------------------------------------------------------------------------------------------
+
+void OpenTraceFile(const char* file_name)
+{
+    assert(file_name);
+
+    std::lock_guard<std::mutex> guard(TRACER.lock);
+
+    TRACER.file = fopen(file_name, "w");
+    if (TRACER.file == nullptr)
+        return;
+
+    fprintf(TRACER.file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    TRACER.start_time = GetTimeNs();
+    TRACER.enabled.store(true, std::memory_order_release);
+
+    atexit(CloseTraceFile);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void CloseTraceFile()
+{
+    TRACER.enabled.store(false, std::memory_order_release);
+
+    std::lock_guard<std::mutex> guard(TRACER.lock);
+
+    if (TRACER.file == nullptr)
+        return;
+
+    TraceBuffer* buffer = TRACER.buffers;
+    while (buffer != nullptr)
+    {
+        TraceBuffer* next = buffer->next;
+
+        WriteTraceBuffer(buffer);
+        MemFree(buffer->events);
+        MemFree(buffer);
+
+        buffer = next;
+    }
+    TRACER.buffers = nullptr;
+    THREAD_BUFFER  = nullptr;
+
+    fprintf(TRACER.file, "\n]}\n");
+    fclose(TRACER.file);
+    TRACER.file = nullptr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void TraceThreadName(const char* name)
+{
+    assert(name);
+
+    if (!TRACER.enabled.load(std::memory_order_acquire))
+        return;
+
+    std::lock_guard<std::mutex> guard(TRACER.lock);
+
+    if (TRACER.file == nullptr)
+        return;
+
+    WriteEventSeparator();
+    fprintf(TRACER.file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%ld,"
+                         "\"args\":{\"name\":\"%s\"}}", getpid(), syscall(SYS_gettid), name);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+TraceSpan::TraceSpan(const char* span_name) :
+    name  (span_name),
+    start (0)
+{
+    if (TRACER.enabled.load(std::memory_order_relaxed))
+        start = GetTimeNs();
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+TraceSpan::~TraceSpan()
+{
+    if (start == 0 || !TRACER.enabled.load(std::memory_order_relaxed))
+        return;
+
+    TraceBuffer* buffer = GetThreadBuffer();
+    if (buffer == nullptr)
+        return;
+
+    TraceEvent* event = &buffer->events[buffer->size++];
+    event->name     = name;
+    event->start    = start;
+    event->duration = GetTimeNs() - start;
+
+    if (buffer->size == TRACE_THREAD_BUF_EVENTS)
+    {
+        std::lock_guard<std::mutex> guard(TRACER.lock);
+        WriteTraceBuffer(buffer);
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static TraceBuffer* GetThreadBuffer()
+{
+    if (THREAD_BUFFER != nullptr)
+        return THREAD_BUFFER;
+
+    TraceBuffer* buffer = (TraceBuffer*) MemCalloc(MEM_LOGS, 1, sizeof(TraceBuffer));
+    if (buffer == nullptr)
+        return nullptr;
+
+    buffer->events = (TraceEvent*) MemCalloc(MEM_LOGS, TRACE_THREAD_BUF_EVENTS, sizeof(TraceEvent));
+    if (buffer->events == nullptr)
+    {
+        MemFree(buffer);
+        return nullptr;
+    }
+
+    buffer->tid = syscall(SYS_gettid);
+
+    std::lock_guard<std::mutex> guard(TRACER.lock);
+
+    buffer->next   = TRACER.buffers;
+    TRACER.buffers = buffer;
+
+    THREAD_BUFFER = buffer;
+
+    return buffer;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void WriteTraceBuffer(TraceBuffer* buffer)
+{
+    assert(buffer);
+
+    if (TRACER.file == nullptr)
+    {
+        buffer->size = 0;
+        return;
+    }
+
+    for (size_t i = 0; i < buffer->size; i++)
+    {
+        const TraceEvent* event = &buffer->events[i];
+
+        WriteEventSeparator();
+        fprintf(TRACER.file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%ld,"
+                             "\"ts\":%.3lf,\"dur\":%.3lf}",
+                             event->name, getpid(), buffer->tid,
+                             (double) (event->start - TRACER.start_time) / 1e3,
+                             (double) event->duration / 1e3);
+    }
+
+    buffer->size = 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void WriteEventSeparator()
+{
+    if (TRACER.have_events)
+        fprintf(TRACER.file, ",\n");
+
+    TRACER.have_events = true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static long long GetTimeNs()
+{
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
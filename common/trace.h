@@ -0,0 +1,74 @@
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+/*! \file
+* \brief Contains tracing functions (Chrome trace-event JSON, opens in Perfetto or chrome://tracing)
+*/
+
+#include <stdio.h>
+
+#ifndef TRACE_SPANS
+/************************************************************//**
+ * @brief Trace spans
+ *
+ * 1 for ON (spans cost one check while trace file is not opened)
+ * 0 for OFF (spans are not even compiled)
+ ************************************************************/
+#define TRACE_SPANS 1
+
+#endif
+
+/// environment variable with trace file name, tracing is enabled if it is set
+static const char* const TRACE_ENV_VAR     = "AKINATOR_TRACE";
+/// events in one thread buffer, buffer is written in file when it is full
+static const size_t TRACE_THREAD_BUF_EVENTS = 4096;
+
+/************************************************************//**
+ * @brief Opens trace file and enables tracing, also closes it when program shuts down
+ *
+ * @param[in] file_name name of trace file
+ ************************************************************/
+void OpenTraceFile(const char* file_name);
+
+/************************************************************//**
+ * @brief Writes events left in thread buffers and closes trace file
+ ************************************************************/
+void CloseTraceFile();
+
+/************************************************************//**
+ * @brief Names current thread in trace
+ *
+ * @param[in] name thread name (string literal)
+ ************************************************************/
+void TraceThreadName(const char* name);
+
+/// @brief RAII span, event is recorded when span dies
+struct TraceSpan
+{
+    /// span name (string literal)
+    const char* name;
+    /// start time (ns), 0 if tracing was off when span started
+    long long   start;
+
+    explicit TraceSpan(const char* span_name);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&)            = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+#ifdef TRACE_SPAN
+#undef TRACE_SPAN
+
+#endif
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT_(a, b)
+
+#if TRACE_SPANS
+#define TRACE_SPAN(name)    TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+#else
+#define TRACE_SPAN(name)    ;
+#endif
+
+#endif
@@ -1,14 +1,31 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include "tree/tree.h"
 #include "akinator/akinator.h"
+#include "akinator/node_stats.h"
+#include "akinator/description_cache.h"
+#include "akinator/fuzzy_index.h"
+#include "akinator/word_index.h"
+#include "akinator/prefix_index.h"
+#include "akinator/question_index.h"
 #include "common/input_and_output.h"
 #include "common/colorlib.h"
-
-static const char* INPUT_FILE = "data.txt";
+#include "common/trace.h"
+#include "common/metrics.h"
+#include "common/memory.h"
 
 int main(const int argc, const char* argv[])
 {
     OpenLogFile(argv[0]);
 
+    const char* trace_file = getenv(TRACE_ENV_VAR);
+    if (trace_file != nullptr)
+        OpenTraceFile(trace_file);
+
+    const char* hash_cons_value = getenv(HASH_CONS_ENV_VAR);
+    const bool  hash_cons       = hash_cons_value != nullptr && strcmp(hash_cons_value, "0") != 0;
+
     tree_t tree   = {};
     error_t error = {};
     TreeCtor(&tree, &error);
@@ -16,6 +33,28 @@ int main(const int argc, const char* argv[])
     const char* data_file = GetInputFileName(argc, argv, &error);
     EXIT_IF_ERROR(&error);
 
+    OpenMetricsFile(data_file);
+
+    // tree is read again for every mode, cache lives for the whole session
+    DescriptionCache cache = {};
+    DescriptionCacheCtor(&cache, DESCRIPTION_CACHE_CAPACITY, &error);
+    EXIT_IF_AKINATOR_ERROR(&error);
+
+    // index of names is made on first typo and made again only after tree changes
+    FuzzyIndex fuzzy = {};
+    FuzzyIndexCtor(&fuzzy);
+
+    // words of questions and names of objects are indexed after reading, guess mode adds new ones
+    WordIndex words = {};
+    WordIndexCtor(&words);
+
+    PrefixIndex names = {};
+    PrefixIndexCtor(&names);
+
+    // objects by answers are indexed on first set query and again only after tree changes
+    QuestionIndex questions = {};
+    QuestionIndexCtor(&questions);
+
     bool leave_flag = false;
 
     while (!leave_flag)
@@ -23,18 +62,50 @@ int main(const int argc, const char* argv[])
         FILE* fp = OpenInputFile(data_file, &error);
         EXIT_IF_ERROR(&error);
 
+        // tree is read again every time, previous one must not leak
+        TreeDtor(&tree);
+
         TreePrefixRead(fp, &tree, &error);
         EXIT_IF_TREE_ERROR(&error);
 
         fclose(fp);
 
+        // identical subtrees become one node, guess mode copies shared nodes before changing them
+        if (hash_cons)
+        {
+            HashConsStats hash_cons_stats = {};
+
+            TreeHashCons(&tree, &hash_cons_stats, &error);
+            EXIT_IF_TREE_ERROR(&error);
+
+            PrintLog("HASH-CONSING: %zu nodes, %zu unique, dedup ratio %.2lf<br>\n",
+                     hash_cons_stats.nodes, hash_cons_stats.unique_nodes,
+                     (hash_cons_stats.unique_nodes == 0) ? 0 :
+                     (double) hash_cons_stats.nodes / (double) hash_cons_stats.unique_nodes);
+        }
+
+        DescriptionCacheSync(&cache, &tree);
+
+        WordIndexSync(&words, &tree, &error);
+        EXIT_IF_AKINATOR_ERROR(&error);
+
+        PrefixIndexSync(&names, &tree, &error);
+        EXIT_IF_AKINATOR_ERROR(&error);
+
         AkinatorMode mode = GetWorkingMode();
 
         switch (mode)
         {
             case AkinatorMode::COMPARE:
             {
-                CompareMode(&tree, &error);
+                CompareMode(&tree, &cache, &fuzzy, &names, &error);
+                EXIT_IF_AKINATOR_ERROR(&error);
+                break;
+            }
+
+            case AkinatorMode::NEAREST:
+            {
+                NearestMode(&tree, &fuzzy, &names, &error);
                 EXIT_IF_AKINATOR_ERROR(&error);
                 break;
             }
@@ -43,19 +114,78 @@ int main(const int argc, const char* argv[])
             {
                 DUMP_TREE(&tree);
                 TreePrefixPrint(stdout, &tree);
+                TreePrintDepthHistogram(stdout, &tree);
+                break;
+            }
+
+            case AkinatorMode::STATS:
+            {
+                TreePrintStats(stdout, &tree);
+                NodeStatsPrint(stdout, &tree, data_file);
+                PrintMetrics(stdout);
+                PrintMemoryStats(stdout);
                 break;
             }
 
             case AkinatorMode::DESCRIBE:
             {
-                DescriptionMode(&tree, &error);
+                DescriptionMode(&tree, &cache, &fuzzy, &names, &error);
                 EXIT_IF_AKINATOR_ERROR(&error);
                 break;
             }
 
             case AkinatorMode::GUESS:
             {
-                GuessMode(&tree, tree.root, INPUT_FILE, &error);
+                GuessMode(&tree, tree.root, &cache, &words, &names, data_file, &error);
+                EXIT_IF_AKINATOR_ERROR(&error);
+                break;
+            }
+
+            case AkinatorMode::ADAPTIVE:
+            {
+                AdaptiveGuessMode(&tree, &error);
+                EXIT_IF_AKINATOR_ERROR(&error);
+                break;
+            }
+
+            case AkinatorMode::REBUILD:
+            {
+                RebuildMode(&tree, data_file, &error);
+                EXIT_IF_AKINATOR_ERROR(&error);
+                break;
+            }
+
+            case AkinatorMode::EXPORT:
+            {
+                ExportMode(&tree, data_file, &error);
+                EXIT_IF_AKINATOR_ERROR(&error);
+                break;
+            }
+
+            case AkinatorMode::SET_QUERY:
+            {
+                SetQueryMode(&tree, &questions, &error);
+                EXIT_IF_AKINATOR_ERROR(&error);
+                break;
+            }
+
+            case AkinatorMode::SIMILARITY:
+            {
+                SimilarityMode(&tree, data_file, &error);
+                EXIT_IF_AKINATOR_ERROR(&error);
+                break;
+            }
+
+            case AkinatorMode::WORD_SEARCH:
+            {
+                WordSearchMode(&tree, &words, &error);
+                EXIT_IF_AKINATOR_ERROR(&error);
+                break;
+            }
+
+            case AkinatorMode::DIFF:
+            {
+                DiffMode(&tree, &error);
                 EXIT_IF_AKINATOR_ERROR(&error);
                 break;
             }
@@ -72,6 +202,11 @@ int main(const int argc, const char* argv[])
 
     PrintRedText(stdout, "Quitting program\n", nullptr);
 
+    DescriptionCacheDtor(&cache);
+    FuzzyIndexDtor(&fuzzy);
+    WordIndexDtor(&words);
+    PrefixIndexDtor(&names);
+    QuestionIndexDtor(&questions);
     TreeDtor(&tree);
 }
 
@@ -1,51 +1,361 @@
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
 #include "hash.h"
 
-hash_t MurmurHash (const void* obj, size_t size)
+static const hash_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+static const hash_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+static const hash_t PRIME_3 = 0x165667B19E3779F9ULL;
+static const hash_t PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+static const hash_t PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+static const unsigned CRC32C_POLY = 0x82F63B78;
+
+struct Crc32cLookup
+{
+    unsigned table[256];
+};
+
+static inline hash_t Rotl(const hash_t value, const int shift);
+static inline hash_t Read64(const unsigned char* data);
+static inline hash_t Read32(const unsigned char* data);
+
+static inline hash_t HashRound(hash_t acc, const hash_t input);
+static inline hash_t HashMerge(hash_t acc, const hash_t lane);
+
+static inline void InitLanes(hash_t* lanes, const hash_t seed);
+static inline const unsigned char* ProcessStripes(hash_t* lanes, const unsigned char* data, size_t* size);
+static inline hash_t MergeLanes(const hash_t* lanes);
+static inline hash_t FinishHash(hash_t hash, const unsigned char* data, size_t size);
+
+static Crc32cLookup MakeCrc32cLookup();
+static unsigned Crc32cTable(const unsigned char* data, size_t size, unsigned crc);
+
+#if defined(__x86_64__)
+static unsigned Crc32cSse42(const unsigned char* data, size_t size, unsigned crc);
+#endif
+
+//-----------------------------------------------------------------------------------------------------
+
+hash_t Hash64(const void* obj, size_t size)
+{
+    return Hash64Seed(obj, size, 0);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+hash_t Hash64Seed(const void* obj, size_t size, const hash_t seed)
+{
+    assert(obj || size == 0);
+
+    const unsigned char* data = (const unsigned char*) obj;
+    const size_t total_len    = size;
+    hash_t hash = 0;
+
+    if (size >= HASH_STRIPE_LEN)
+    {
+        hash_t lanes[4] = {};
+        InitLanes(lanes, seed);
+
+        data = ProcessStripes(lanes, data, &size);
+        hash = MergeLanes(lanes);
+    }
+    else
+        hash = seed + PRIME_5;
+
+    hash += total_len;
+
+    return FinishHash(hash, data, size);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void HashStart(HashState* state, const hash_t seed)
 {
-    assert(obj);
+    assert(state);
+
+    memset(state, 0, sizeof(HashState));
+
+    state->seed = seed;
+    InitLanes(state->lanes, seed);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void HashUpdate(HashState* state, const void* obj, size_t size)
+{
+    assert(state);
+    assert(obj || size == 0);
 
     const unsigned char* data = (const unsigned char*) obj;
-    const hash_t seed = 0;
-    const hash_t m    = 0x5bd1e995;
-    const int    r    = 24;
-    hash_t       k    = 0;
 
-    hash_t hash = (hash_t) (seed ^ size);
+    state->total_len += size;
+
+    if (state->buf_len + size < HASH_STRIPE_LEN)
+    {
+        memcpy(state->buf + state->buf_len, data, size);
+        state->buf_len += size;
+        return;
+    }
+
+    if (state->buf_len > 0)
+    {
+        size_t fill = HASH_STRIPE_LEN - state->buf_len;
+        memcpy(state->buf + state->buf_len, data, fill);
+
+        size_t stripe_len = HASH_STRIPE_LEN;
+        ProcessStripes(state->lanes, state->buf, &stripe_len);
+
+        data += fill;
+        size -= fill;
+        state->buf_len = 0;
+    }
+
+    data = ProcessStripes(state->lanes, data, &size);
+
+    memcpy(state->buf, data, size);
+    state->buf_len = size;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+hash_t HashFinish(const HashState* state)
+{
+    assert(state);
+
+    hash_t hash = (state->total_len >= HASH_STRIPE_LEN) ? MergeLanes(state->lanes) :
+                                                          state->seed + PRIME_5;
+    hash += state->total_len;
+
+    return FinishHash(hash, state->buf, state->buf_len);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+unsigned Crc32c(const void* obj, size_t size, const unsigned crc)
+{
+    assert(obj || size == 0);
+
+    const unsigned char* data = (const unsigned char*) obj;
+
+#if defined(__x86_64__)
+    static const bool HAS_SSE42 = __builtin_cpu_supports("sse4.2");
+
+    if (HAS_SSE42)
+        return ~Crc32cSse42(data, size, ~crc);
+#endif
+
+    return ~Crc32cTable(data, size, ~crc);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline hash_t Rotl(const hash_t value, const int shift)
+{
+    return (value << shift) | (value >> (64 - shift));
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline hash_t Read64(const unsigned char* data)
+{
+    hash_t value = 0;
+    memcpy(&value, data, sizeof(value));
+
+    return value;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline hash_t Read32(const unsigned char* data)
+{
+    unsigned value = 0;
+    memcpy(&value, data, sizeof(value));
+
+    return value;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline hash_t HashRound(hash_t acc, const hash_t input)
+{
+    acc += input * PRIME_2;
+    acc  = Rotl(acc, 31);
+    acc *= PRIME_1;
+
+    return acc;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline hash_t HashMerge(hash_t acc, const hash_t lane)
+{
+    acc ^= HashRound(0, lane);
+    acc  = acc * PRIME_1 + PRIME_4;
+
+    return acc;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline void InitLanes(hash_t* lanes, const hash_t seed)
+{
+    assert(lanes);
+
+    lanes[0] = seed + PRIME_1 + PRIME_2;
+    lanes[1] = seed + PRIME_2;
+    lanes[2] = seed;
+    lanes[3] = seed - PRIME_1;
+}
+
+//-----------------------------------------------------------------------------------------------------
 
-    while (size >= 4)
+static inline const unsigned char* ProcessStripes(hash_t* lanes, const unsigned char* data, size_t* size)
+{
+    assert(lanes);
+    assert(size);
+
+    // lanes do not depend on each other, so all four multiplications run in parallel
+    hash_t lane_0 = lanes[0];
+    hash_t lane_1 = lanes[1];
+    hash_t lane_2 = lanes[2];
+    hash_t lane_3 = lanes[3];
+
+    while (*size >= HASH_STRIPE_LEN)
     {
-        k  = data[0];
-        k |= data[1] << 8;
-        k |= data[2] << 16;
-        k |= data[3] << 24;
+        lane_0 = HashRound(lane_0, Read64(data));
+        lane_1 = HashRound(lane_1, Read64(data + 8));
+        lane_2 = HashRound(lane_2, Read64(data + 16));
+        lane_3 = HashRound(lane_3, Read64(data + 24));
+
+        data  += HASH_STRIPE_LEN;
+        *size -= HASH_STRIPE_LEN;
+    }
+
+    lanes[0] = lane_0;
+    lanes[1] = lane_1;
+    lanes[2] = lane_2;
+    lanes[3] = lane_3;
+
+    return data;
+}
+
+//-----------------------------------------------------------------------------------------------------
 
-        k *= m;
-        k ^= k >> r;
-        k *= m;
+static inline hash_t MergeLanes(const hash_t* lanes)
+{
+    assert(lanes);
+
+    hash_t hash = Rotl(lanes[0], 1) + Rotl(lanes[1], 7) + Rotl(lanes[2], 12) + Rotl(lanes[3], 18);
+
+    for (size_t i = 0; i < 4; i++)
+        hash = HashMerge(hash, lanes[i]);
 
-        hash *= m;
-        hash ^= k;
+    return hash;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline hash_t FinishHash(hash_t hash, const unsigned char* data, size_t size)
+{
+    while (size >= 8)
+    {
+        hash ^= HashRound(0, Read64(data));
+        hash  = Rotl(hash, 27) * PRIME_1 + PRIME_4;
+
+        data += 8;
+        size -= 8;
+    }
+
+    if (size >= 4)
+    {
+        hash ^= Read32(data) * PRIME_1;
+        hash  = Rotl(hash, 23) * PRIME_2 + PRIME_3;
 
         data += 4;
         size -= 4;
     }
 
-    switch (size)
+    while (size > 0)
     {
-        case 3:         hash ^= data[2] << 16;
-        // fall through
-        case 2:         hash ^= data[8] << 8;
-        // fall through
-        default:        hash ^= data[0];
-                        hash *= m;
+        hash ^= (*data) * PRIME_5;
+        hash  = Rotl(hash, 11) * PRIME_1;
+
+        data++;
+        size--;
     }
 
-    hash ^= hash >> 13;
-    hash *= m;
-    hash ^= hash >> 15;
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
 
     return hash;
 }
+
+//-----------------------------------------------------------------------------------------------------
+
+static Crc32cLookup MakeCrc32cLookup()
+{
+    Crc32cLookup lookup = {};
+
+    for (unsigned i = 0; i < 256; i++)
+    {
+        unsigned value = i;
+
+        for (int bit = 0; bit < 8; bit++)
+            value = (value & 1) ? (value >> 1) ^ CRC32C_POLY : value >> 1;
+
+        lookup.table[i] = value;
+    }
+
+    return lookup;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static unsigned Crc32cTable(const unsigned char* data, size_t size, unsigned crc)
+{
+    static const Crc32cLookup LOOKUP = MakeCrc32cLookup();
+
+    for (size_t i = 0; i < size; i++)
+        crc = LOOKUP.table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static unsigned Crc32cSse42(const unsigned char* data, size_t size, unsigned crc)
+{
+    unsigned long long wide_crc = crc;
+
+    while (size >= 8)
+    {
+        wide_crc = _mm_crc32_u64(wide_crc, Read64(data));
+
+        data += 8;
+        size -= 8;
+    }
+
+    crc = (unsigned) wide_crc;
+
+    while (size > 0)
+    {
+        crc = _mm_crc32_u8(crc, *data);
+
+        data++;
+        size--;
+    }
+
+    return crc;
+}
+#endif
@@ -9,13 +9,78 @@
 
 #include "types.h"
 
+/// amount of bytes, that Hash64 processes at once
+static const size_t HASH_STRIPE_LEN = 32;
+
+/// @brief state of streaming hash (gives same hash as Hash64 over all bytes)
+struct HashState
+{
+    /// stripe accumulators
+    hash_t lanes[4];
+    /// bytes, that do not fill whole stripe yet
+    unsigned char buf[HASH_STRIPE_LEN];
+    /// amount of bytes in buf
+    size_t buf_len;
+    /// amount of all bytes
+    size_t total_len;
+    /// hash seed
+    hash_t seed;
+};
+
+/************************************************************//**
+ * @brief Counts 64-bit hash (XXH64 algorithm). Long inputs are processed
+ * by 32-byte stripes in four independent 64-bit lanes
+ *
+ * @param[in] obj object
+ * @param[in] size object size
+ * @return hash_t object's hash
+ *************************************************************/
+hash_t Hash64(const void* obj, size_t size);
+
 /************************************************************//**
- * @brief Counts hash by MurmurHash function
+ * @brief Counts 64-bit hash with seed
  *
  * @param[in] obj object
  * @param[in] size object size
+ * @param[in] seed hash seed
  * @return hash_t object's hash
  *************************************************************/
-hash_t MurmurHash (const void* obj, size_t size);
+hash_t Hash64Seed(const void* obj, size_t size, const hash_t seed);
+
+/************************************************************//**
+ * @brief Starts streaming hash
+ *
+ * @param[out] state hash state
+ * @param[in] seed hash seed
+ *************************************************************/
+void HashStart(HashState* state, const hash_t seed = 0);
+
+/************************************************************//**
+ * @brief Adds bytes to streaming hash
+ *
+ * @param[in] state hash state
+ * @param[in] obj bytes
+ * @param[in] size amount of bytes
+ *************************************************************/
+void HashUpdate(HashState* state, const void* obj, size_t size);
+
+/************************************************************//**
+ * @brief Returns hash of all added bytes (state is not changed)
+ *
+ * @param[in] state hash state
+ * @return hash_t hash
+ *************************************************************/
+hash_t HashFinish(const HashState* state);
+
+/************************************************************//**
+ * @brief Counts CRC32C (Castagnoli). Uses SSE4.2 crc32 instruction if CPU has it,
+ * table otherwise. Checksums of parts can be chained through crc argument
+ *
+ * @param[in] obj object
+ * @param[in] size object size
+ * @param[in] crc checksum of previous bytes (0 for start)
+ * @return unsigned checksum
+ *************************************************************/
+unsigned Crc32c(const void* obj, size_t size, const unsigned crc = 0);
 
 #endif
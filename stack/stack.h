@@ -2,13 +2,17 @@
 #define __STACK_H_
 
 #include <stdio.h>
+#include <string.h>
+#include <type_traits>
 
 #include "common/errors.h"
 #include "common/logs.h"
+#include "common/memory.h"
 #include "types.h"
+#include "hash.h"
 
 /*! \file
-* \brief Contains hash functions
+* \brief Contains stack template with small buffer and C-style functions for Stack_t
 */
 
 #ifndef CANARY_PROTECT
@@ -49,48 +53,44 @@
 #define ON_HASH(...) ;
 #endif
 
-#ifdef STACK_DUMP
-#undef STACK_DUMP
+/// @brief how much of stack is verified by every operation
+enum StackCheckMode
+{
+    /// stack is never verified
+    STACK_CHECK_OFF     = 0,
+    /// O(1) checks on every operation, full verification every max(sample period, capacity) operations
+    STACK_CHECK_SAMPLED = 1,
+    /// full verification (O(capacity)) on every operation
+    STACK_CHECK_FULL    = 2
+};
+
+#ifndef STACK_CHECK_MODE
+/************************************************************//**
+ * @brief Stack check mode, that program starts with (StackCheckMode)
+ ************************************************************/
+#define STACK_CHECK_MODE STACK_CHECK_SAMPLED
 
 #endif
-#define STACK_DUMP(stk)     LogDump(StackDump, stk, __func__, __FILE__, __LINE__)
 
-static const size_t MIN_CAPACITY = 16;
+#ifdef STACK_DUMP
+#undef STACK_DUMP
 
-/// @brief Stack structure
-struct Stack
-{
-    ON_CANARY
-    (
-        /// stack prefix canary
-        canary_t stack_prefix;
-    )
+#endif
+#define STACK_DUMP(stk)     ON_DUMP_LOGS((stk)->dump(__func__, __FILE__, __LINE__))
 
-    /// stack data
-    elem_t* data;
-    /// stack size
-    size_t size;
-    /// stack capacity
-    size_t capacity;
-    /// stack status (0 if everything is fine)
-    int status;
+/// smallest heap capacity
+static const size_t MIN_CAPACITY          = 16;
+/// default amount of elements, that are stored inside stack without heap allocation
+static const size_t STACK_INLINE_CAPACITY = 32;
 
-    ON_HASH
-    (
-        /// hash function
-        hash_f hash_func;
-        /// data hash
-        hash_t data_hash;
-        /// stack hash
-        hash_t stack_hash;
-    )
+/// default amount of operations between full verifications in sampled mode
+static const size_t STACK_CHECK_SAMPLE_PERIOD = 1024;
+/// amount of unused elements, that are scrubbed for poison by one O(1) check
+static const size_t STACK_SCRUB_STEP          = 4;
 
-    ON_CANARY
-    (
-        /// stack postfix canary
-        canary_t stack_postfix;
-    )
-};
+static const canary_t STACK_CANARY = 0xD07ADEAD;
+static const elem_t   POISON       = -123456789;
+static const int      POISON_BYTE  = 0xBD;
 
 /// @brief list of stack conditions
 enum StackCondition
@@ -124,6 +124,130 @@ enum StackCondition
     DESTRUCTED           = 1 << 11
 };
 
+/************************************************************//**
+ * @brief Stack of T. First INLINE_CAPACITY elements are kept inside
+ * of stack itself, heap is used only for deeper stacks
+ *
+ * @tparam T element type (trivially copyable)
+ * @tparam INLINE_CAPACITY amount of inline elements
+ * @tparam CHECKED false turns off verification, poison and hashes whatever
+ * check mode is set (see UncheckedStack)
+ ************************************************************/
+template <typename T, size_t INLINE_CAPACITY = STACK_INLINE_CAPACITY, bool CHECKED = true>
+struct Stack
+{
+    static_assert(std::is_trivially_copyable<T>::value, "stack elements are copied bytewise");
+    static_assert(INLINE_CAPACITY > 0, "stack needs inline buffer");
+
+    ON_CANARY
+    (
+        /// stack prefix canary
+        canary_t stack_prefix = STACK_CANARY;
+    )
+
+    /// stack data (inline buffer or heap)
+    T* data = inline_data;
+    /// stack size
+    size_t size = 0;
+    /// stack capacity
+    size_t capacity = INLINE_CAPACITY;
+    /// capacity, that stack never shrinks below
+    size_t min_capacity = INLINE_CAPACITY;
+    /// stack status (0 if everything is fine)
+    mutable int status = OK;
+    /// operations since last full verification (sampled mode)
+    mutable size_t unchecked_ops = 0;
+    /// next unused element to be scrubbed for poison
+    mutable size_t scrub_pos = 0;
+
+    ON_HASH
+    (
+        /// hash function
+        hash_f hash_func = nullptr;
+        /// data hash: sum of hashes of (index, element) pairs, updated by every push and pop
+        hash_t data_hash = 0;
+        /// stack hash
+        hash_t stack_hash = 0;
+    )
+
+    ON_CANARY
+    (
+        /// inline data prefix canary
+        canary_t inline_prefix = STACK_CANARY;
+    )
+
+    /// inline buffer
+    T inline_data[INLINE_CAPACITY] = {};
+
+    ON_CANARY
+    (
+        /// inline data postfix canary
+        canary_t inline_postfix = STACK_CANARY;
+
+        /// stack postfix canary
+        canary_t stack_postfix = STACK_CANARY;
+    )
+
+    Stack();
+    ~Stack();
+
+    Stack(Stack&& other);
+    Stack& operator=(Stack&& other);
+
+    Stack(const Stack&)            = delete;
+    Stack& operator=(const Stack&) = delete;
+
+    /// @brief (re)initializes stack, heap is allocated only if capacity > INLINE_CAPACITY
+    int  init(size_t start_capacity = INLINE_CAPACITY);
+    /// @brief frees heap memory, stack becomes DESTRUCTED
+    int  destroy();
+
+    int  push(const T value);
+    int  pop(T* ret_value = nullptr);
+    /// @brief makes capacity at least new_capacity and never shrinks below it
+    int  reserve(size_t new_capacity);
+
+    /// @brief verifies whole stack (poison of every unused element too), returns status
+    int  verify() const;
+    /// @brief O(1) verification: fields, canaries, top element and next scrubbed elements
+    int  verify_fast() const;
+    /// @brief dumps stack in log
+    int  dump(const char* func, const char* file, const int line) const;
+
+    bool is_inline() const { return data == inline_data; }
+
+    canary_t* prefix_data_canary() const;
+    canary_t* postfix_data_canary() const;
+
+    /// @brief counts data hash from scratch (O(size))
+    hash_t count_data_hash() const;
+    /// @brief hash of one element at its index, data hash is sum of them
+    hash_t elem_hash(const size_t index, const T& value) const;
+    hash_t count_stack_hash() const;
+
+    T&       operator[](const size_t index)       { return data[index]; }
+    const T& operator[](const size_t index) const { return data[index]; }
+
+private:
+    /// @brief frees heap buffer (if data is not inline), data points to inline buffer after it
+    void release_heap();
+    /// @brief push and pop with checks, reallocation and hashes (all pushes and pops of checked stack)
+    int  push_slow(const T value);
+    int  pop_slow(T* ret_value);
+    int  realloc_data(size_t new_capacity);
+    void reset();
+    void rehash();
+    bool is_valid(const char* func, const char* file, const int line) const;
+};
+
+/// stack of long long elements, that is used through C-style functions
+typedef Stack<elem_t> Stack_t;
+
+/// stack, that is never verified: for internal stacks of hot loops (tree walks, diff, rebuild),
+/// where only own code pushes and pops and every operation must cost as little as plain array
+template <typename T, size_t INLINE_CAPACITY = STACK_INLINE_CAPACITY>
+using UncheckedStack = Stack<T, INLINE_CAPACITY, false>;
+
 /************************************************************//**
  * @brief Creates stack
  *
@@ -159,6 +283,15 @@ int StackPush(Stack_t* stk, elem_t value);
  ************************************************************/
 int StackPop(Stack_t* stk, elem_t* ret_value = nullptr);
 
+/************************************************************//**
+ * @brief Makes stack capacity at least capacity
+ *
+ * @param[in] stk stack pointer
+ * @param[in] capacity needed capacity
+ * @return int error code
+ ************************************************************/
+int StackReserve(Stack_t* stk, size_t capacity);
+
 /************************************************************//**
  * @brief Prints info about stack in output stream
  *
@@ -172,11 +305,39 @@ int StackPop(Stack_t* stk, elem_t* ret_value = nullptr);
 int StackDump(FILE* fp, const void* stk, const char* func, const char* file, const int line);
 
 /************************************************************//**
- * @brief Verifies stack
+ * @brief Verifies whole stack, including poison of every unused element (O(capacity))
  *
  * @param[in] stk stack pointer
  * @return int stack condition code
  ************************************************************/
 int StackOk(const Stack_t* stk);
 
+/************************************************************//**
+ * @brief Sets how much of every stack is verified by stack operations
+ *
+ * @param[in] mode check mode
+ * @param[in] sample_period operations between full verifications in sampled mode
+ ************************************************************/
+void SetStackCheckMode(const StackCheckMode mode, const size_t sample_period = STACK_CHECK_SAMPLE_PERIOD);
+
+/************************************************************//**
+ * @brief Returns current stack check mode
+ *
+ * @param[out] sample_period operations between full verifications in sampled mode
+ * @return StackCheckMode check mode
+ ************************************************************/
+StackCheckMode GetStackCheckMode(size_t* sample_period);
+
+/************************************************************//**
+ * @brief Prints stack conditions in log
+ *
+ * @param[in] status stack status
+ * @param[in] size stack size
+ * @param[in] capacity stack capacity
+ * @param[in] data stack data
+ ************************************************************/
+void PrintStackCondition(const int status, const size_t size, const size_t capacity, const void* data);
+
+#include "stack_impl.h"
+
 #endif
@@ -0,0 +1,800 @@
+#ifndef __STACK_IMPL_H_
+#define __STACK_IMPL_H_
+
+/*! \file
+* \brief Contains Stack template definitions (included from stack.h only)
+*/
+
+#include <assert.h>
+
+#ifdef CHECK_STACK
+#undef CHECK_STACK
+
+#endif
+#define CHECK_STACK(stk)    do                                                          \
+                            {                                                           \
+                                if (!(stk)->is_valid(__func__, __FILE__, __LINE__))     \
+                                    return (int) ERRORS::INVALID_STACK;                 \
+                            } while(0)
+
+// ============= ELEMENT HELPERS ===============
+
+// Elements are written into stack only by StoreStackElem and PoisonStackElem. Struct assignment
+// does not have to copy padding bytes, and poison checks and data hash read all sizeof(T) bytes,
+// so every byte of slot is written by memcpy/memset.
+
+template <typename T>
+inline void StoreStackElem(T* slot, const T& value)
+{
+    memcpy((void*) slot, (const void*) &value, sizeof(T));
+}
+
+template <typename T>
+inline void PoisonStackElem(T* slot)
+{
+    memset((void*) slot, POISON_BYTE, sizeof(T));
+}
+
+template <>
+inline void PoisonStackElem<elem_t>(elem_t* slot)
+{
+    *slot = POISON;
+}
+
+template <typename T>
+inline bool IsStackElemPoisoned(const T& value)
+{
+    // poison is never copied, so its padding bytes are poison bytes too
+    T poison;
+    PoisonStackElem(&poison);
+
+    return memcmp((const void*) &value, (const void*) &poison, sizeof(T)) == 0;
+}
+
+template <>
+inline bool IsStackElemPoisoned<elem_t>(const elem_t& value)
+{
+    return value == POISON;
+}
+
+template <typename T>
+inline void PrintStackElem(FILE* fp, const T& value)
+{
+    if constexpr (std::is_pointer<T>::value)
+        fprintf(fp, "[%p]", (const void*) value);
+    else if constexpr (std::is_integral<T>::value || std::is_enum<T>::value)
+        fprintf(fp, "%lld", (long long) value);
+    else
+    {
+        const unsigned char* bytes = (const unsigned char*) &value;
+        for (size_t i = 0; i < sizeof(T); i++)
+            fprintf(fp, "%02X", bytes[i]);
+    }
+}
+
+template <typename T>
+inline void PoisonStackData(T* left_border, T* right_border)
+{
+    assert(left_border);
+    assert(right_border);
+
+    for (T* iterator = left_border; iterator < right_border; iterator++)
+        PoisonStackElem(iterator);
+}
+
+/// @brief size of elements rounded up, so postfix canary is aligned
+inline size_t AlignToCanary(const size_t bytes)
+{
+    return (bytes + sizeof(canary_t) - 1) / sizeof(canary_t) * sizeof(canary_t);
+}
+
+template <typename T>
+inline size_t CountStackDataSize(const size_t capacity)
+{
+    size_t size = capacity * sizeof(T);
+
+    ON_CANARY
+    (
+        size = AlignToCanary(size) + 2 * sizeof(canary_t)
+    );
+
+    return size;
+}
+
+// ============= STACK ===============
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+Stack<T, INLINE_CAPACITY, CHECKED>::Stack()
+{
+    reset();
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+Stack<T, INLINE_CAPACITY, CHECKED>::~Stack()
+{
+    release_heap();
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+void Stack<T, INLINE_CAPACITY, CHECKED>::release_heap()
+{
+    if (data != nullptr && !is_inline())
+    {
+        OFF_CANARY(MemFree(data));
+        ON_CANARY(MemFree((char*) data - sizeof(canary_t)));
+    }
+
+    data = inline_data;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+Stack<T, INLINE_CAPACITY, CHECKED>::Stack(Stack&& other)
+{
+    reset();
+    *this = (Stack&&) other;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+Stack<T, INLINE_CAPACITY, CHECKED>& Stack<T, INLINE_CAPACITY, CHECKED>::operator=(Stack&& other)
+{
+    if (this == &other)
+        return *this;
+
+    release_heap();
+
+    if (other.is_inline())
+    {
+        memcpy((void*) inline_data, (const void*) other.inline_data, sizeof(inline_data));
+        data = inline_data;
+    }
+    else
+        data = other.data;
+
+    size         = other.size;
+    capacity     = other.capacity;
+    min_capacity = other.min_capacity;
+    status       = other.status;
+
+    ON_HASH
+    (
+        data_hash = other.data_hash
+    );
+
+    // heap buffer now belongs to this stack
+    other.reset();
+
+    rehash();
+
+    return *this;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+void Stack<T, INLINE_CAPACITY, CHECKED>::reset()
+{
+    data         = inline_data;
+    size         = 0;
+    capacity     = INLINE_CAPACITY;
+    min_capacity = INLINE_CAPACITY;
+    status       = OK;
+
+    ON_CANARY
+    (
+        stack_prefix   = STACK_CANARY;
+        stack_postfix  = STACK_CANARY;
+        inline_prefix  = STACK_CANARY;
+        inline_postfix = STACK_CANARY
+    );
+
+    ON_HASH
+    (
+        hash_func = Hash64
+    );
+
+    if constexpr (CHECKED)
+        PoisonStackData(inline_data, inline_data + INLINE_CAPACITY);
+
+    ON_HASH
+    (
+        data_hash = count_data_hash()
+    );
+
+    rehash();
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+int Stack<T, INLINE_CAPACITY, CHECKED>::init(size_t start_capacity)
+{
+    release_heap();
+    reset();
+
+    if (start_capacity > INLINE_CAPACITY)
+        return reserve(start_capacity);
+
+    CHECK_STACK(this);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+int Stack<T, INLINE_CAPACITY, CHECKED>::destroy()
+{
+    CHECK_STACK(this);
+
+    release_heap();
+
+    data         = nullptr;
+    size         = 0;
+    capacity     = 0;
+    min_capacity = 0;
+    status       = DESTRUCTED;
+
+    ON_CANARY
+    (
+        stack_prefix  = 0;
+        stack_postfix = 0
+    );
+
+    ON_HASH
+    (
+        hash_func  = nullptr;
+        stack_hash = 0;
+        data_hash  = 0
+    );
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+inline int Stack<T, INLINE_CAPACITY, CHECKED>::push(const T value)
+{
+    assert(data);
+
+    // unchecked stack pays only for store while it has space, the rest is not inlined into hot loops
+    if constexpr (!CHECKED)
+    {
+        if (size < capacity)
+        {
+            StoreStackElem(&data[size++], value);
+            return (int) ERRORS::NONE;
+        }
+    }
+
+    return push_slow(value);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+int Stack<T, INLINE_CAPACITY, CHECKED>::push_slow(const T value)
+{
+    CHECK_STACK(this);
+
+    if (capacity == size)
+    {
+        size_t new_capacity = (capacity < MIN_CAPACITY) ? MIN_CAPACITY : capacity << 1;
+
+        if (realloc_data(new_capacity) != (int) ERRORS::NONE)
+            return (int) ERRORS::ALLOCATE_MEMORY;
+    }
+
+    ON_HASH
+    (
+        if constexpr (CHECKED)
+            data_hash += elem_hash(size, value)
+    );
+
+    StoreStackElem(&data[size++], value);
+
+    rehash();
+
+    CHECK_STACK(this);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+inline int Stack<T, INLINE_CAPACITY, CHECKED>::pop(T* ret_value)
+{
+    assert(data);
+
+    if constexpr (!CHECKED)
+    {
+        // buffer is shrunk only by pop, that leaves quarter of it or less
+        if (size > 0 && (is_inline() || size - 1 > capacity >> 2))
+        {
+            size--;
+
+            if (ret_value != nullptr)
+                *ret_value = data[size];
+
+            return (int) ERRORS::NONE;
+        }
+    }
+
+    return pop_slow(ret_value);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+int Stack<T, INLINE_CAPACITY, CHECKED>::pop_slow(T* ret_value)
+{
+    if (size == 0)
+    {
+        status |= EMPTY_STACK;
+        STACK_DUMP(this);
+        return (int) ERRORS::INVALID_STACK;
+    }
+
+    CHECK_STACK(this);
+
+    size--;
+
+    ON_HASH
+    (
+        if constexpr (CHECKED)
+            data_hash -= elem_hash(size, data[size])
+    );
+
+    if (ret_value != nullptr)
+        *ret_value = data[size];
+
+    if constexpr (CHECKED)
+        PoisonStackElem(&data[size]);
+
+    rehash();
+
+    if (!is_inline() && capacity > min_capacity && size <= capacity >> 2)
+    {
+        int realloc_error = realloc_data(capacity >> 1);
+        if (realloc_error != (int) ERRORS::NONE)
+            return realloc_error;
+    }
+
+    CHECK_STACK(this);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+int Stack<T, INLINE_CAPACITY, CHECKED>::reserve(size_t new_capacity)
+{
+    CHECK_STACK(this);
+
+    if (new_capacity > min_capacity)
+        min_capacity = new_capacity;
+
+    rehash();
+
+    if (new_capacity <= capacity)
+        return (int) ERRORS::NONE;
+
+    return realloc_data(new_capacity);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+int Stack<T, INLINE_CAPACITY, CHECKED>::realloc_data(size_t new_capacity)
+{
+    CHECK_STACK(this);
+
+    if (new_capacity < min_capacity)
+        new_capacity = min_capacity;
+    if (new_capacity < size)
+        new_capacity = size;
+
+    if (new_capacity == capacity)
+        return (int) ERRORS::NONE;
+
+    if (new_capacity <= INLINE_CAPACITY)
+    {
+        // stack is small again, heap is not needed
+        if (!is_inline())
+        {
+            T* heap_data = data;
+
+            memcpy((void*) inline_data, (const void*) heap_data, size * sizeof(T));
+
+            OFF_CANARY(MemFree(heap_data));
+            ON_CANARY(MemFree((char*) heap_data - sizeof(canary_t)));
+
+            data     = inline_data;
+            capacity = INLINE_CAPACITY;
+
+            if constexpr (CHECKED)
+                PoisonStackData(inline_data + size, inline_data + INLINE_CAPACITY);
+        }
+
+        rehash();
+
+        CHECK_STACK(this);
+
+        return (int) ERRORS::NONE;
+    }
+
+    char* block = nullptr;
+
+    if (is_inline())
+    {
+        block = (char*) MemCalloc(MEM_STACKS, CountStackDataSize<T>(new_capacity), 1);
+        if (block == nullptr)
+            return (int) ERRORS::ALLOCATE_MEMORY;
+
+        ON_CANARY(block += sizeof(canary_t));
+
+        memcpy((void*) block, (const void*) inline_data, size * sizeof(T));
+    }
+    else
+    {
+        block = (char*) data;
+        ON_CANARY(block -= sizeof(canary_t));
+
+        block = (char*) MemRealloc(MEM_STACKS, block, CountStackDataSize<T>(new_capacity));
+        if (block == nullptr)
+        {
+            destroy();
+            return (int) ERRORS::ALLOCATE_MEMORY;
+        }
+
+        ON_CANARY(block += sizeof(canary_t));
+    }
+
+    data     = (T*) block;
+    capacity = new_capacity;
+
+    ON_CANARY
+    (
+        *prefix_data_canary()  = STACK_CANARY;
+        *postfix_data_canary() = STACK_CANARY
+    );
+
+    if constexpr (CHECKED)
+        PoisonStackData(data + size, data + capacity);
+
+    rehash();
+
+    CHECK_STACK(this);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+int Stack<T, INLINE_CAPACITY, CHECKED>::verify() const
+{
+    ON_CANARY
+    (
+        if (*prefix_data_canary()  != STACK_CANARY ||
+            *postfix_data_canary() != STACK_CANARY)                 status |= DATA_CANARY_TRIGGER;
+        if (stack_prefix  != STACK_CANARY ||
+            stack_postfix != STACK_CANARY)                          status |= STACK_CANARY_TRIGGER
+    );
+
+    if (capacity == 0)                                              status |= INVALID_CAPACITY;
+    if (size > capacity)                                            status |= INVALID_SIZE;
+    if (data == nullptr)                                            status |= INVALID_DATA;
+
+    // unchecked stack keeps neither poison nor hashes
+    if (status != OK || !CHECKED)
+        return status;
+
+    for (size_t i = size; i < capacity; i++)
+    {
+        if (!IsStackElemPoisoned(data[i]))
+        {
+            status |= POISON_ACCESS;
+            break;
+        }
+    }
+
+    ON_HASH
+    (
+        if (!hash_func)                                             status |= INVALID_HASH_FUNC;
+        else
+        {
+            if (data_hash  != count_data_hash())                    status |= INCORRECT_DATA_HASH;
+            if (stack_hash != count_stack_hash())                   status |= INCORRECT_STACK_HASH;
+        }
+    );
+
+    return status;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+int Stack<T, INLINE_CAPACITY, CHECKED>::verify_fast() const
+{
+    ON_CANARY
+    (
+        if (*prefix_data_canary()  != STACK_CANARY ||
+            *postfix_data_canary() != STACK_CANARY)                 status |= DATA_CANARY_TRIGGER;
+        if (stack_prefix  != STACK_CANARY ||
+            stack_postfix != STACK_CANARY)                          status |= STACK_CANARY_TRIGGER
+    );
+
+    if (capacity == 0)                                              status |= INVALID_CAPACITY;
+    if (size > capacity)                                            status |= INVALID_SIZE;
+    if (data == nullptr)                                            status |= INVALID_DATA;
+
+    if (status != OK || !CHECKED)
+        return status;
+
+    // writes right above top are the most common, so this element is checked every time
+    if (size < capacity && !IsStackElemPoisoned(data[size]))        status |= POISON_ACCESS;
+
+    // rest of unused elements are scrubbed by small steps, cursor wraps around
+    for (size_t i = 0; i < STACK_SCRUB_STEP && size < capacity; i++, scrub_pos++)
+    {
+        if (scrub_pos < size || scrub_pos >= capacity)
+            scrub_pos = size;
+
+        if (!IsStackElemPoisoned(data[scrub_pos]))
+        {
+            status |= POISON_ACCESS;
+            break;
+        }
+    }
+
+    ON_HASH
+    (
+        if (!hash_func)                                             status |= INVALID_HASH_FUNC;
+        else if (stack_hash != count_stack_hash())                  status |= INCORRECT_STACK_HASH
+    );
+
+    return status;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+bool Stack<T, INLINE_CAPACITY, CHECKED>::is_valid(const char* func, const char* file, const int line) const
+{
+    if constexpr (!CHECKED)
+        return true;
+
+    size_t sample_period = 0;
+    int    stack_status  = OK;
+
+    switch (GetStackCheckMode(&sample_period))
+    {
+        case STACK_CHECK_OFF:
+            return true;
+
+        case STACK_CHECK_SAMPLED:
+            // full check costs O(capacity), so it is never done more often than once per
+            // capacity operations and stays O(1) per operation on average
+            if (++unchecked_ops < sample_period || unchecked_ops < capacity)
+            {
+                stack_status = verify_fast();
+                break;
+            }
+
+            unchecked_ops = 0;
+            stack_status  = verify();
+            break;
+
+        case STACK_CHECK_FULL:
+            stack_status = verify();
+            break;
+
+        default:
+            stack_status = verify();
+            break;
+    }
+
+    if (stack_status != OK)
+    {
+        ON_DUMP_LOGS(dump(func, file, line));
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+canary_t* Stack<T, INLINE_CAPACITY, CHECKED>::prefix_data_canary() const
+{
+    #if CANARY_PROTECT
+    if (is_inline())
+        return (canary_t*) &inline_prefix;
+
+    return (canary_t*) ((char*) data - sizeof(canary_t));
+    #else
+    return nullptr;
+    #endif
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+canary_t* Stack<T, INLINE_CAPACITY, CHECKED>::postfix_data_canary() const
+{
+    #if CANARY_PROTECT
+    if (is_inline())
+        return (canary_t*) &inline_postfix;
+
+    return (canary_t*) ((char*) data + AlignToCanary(capacity * sizeof(T)));
+    #else
+    return nullptr;
+    #endif
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+void Stack<T, INLINE_CAPACITY, CHECKED>::rehash()
+{
+    ON_HASH
+    (
+        if constexpr (CHECKED)
+            stack_hash = count_stack_hash()
+    );
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+hash_t Stack<T, INLINE_CAPACITY, CHECKED>::count_data_hash() const
+{
+    hash_t new_hash = 0;
+
+    ON_HASH
+    (
+        for (size_t i = 0; i < size; i++)
+            new_hash += elem_hash(i, data[i])
+    );
+
+    return new_hash;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+hash_t Stack<T, INLINE_CAPACITY, CHECKED>::elem_hash(const size_t index, const T& value) const
+{
+    hash_t new_hash = 0;
+
+    ON_HASH
+    (
+        // no padding between index and element; padding inside element is hashed too, but slots
+        // are written bytewise (StoreStackElem), so it is the same in stack and in hashed value
+        unsigned char key[sizeof(size_t) + sizeof(T)] = {};
+
+        memcpy(key,                  &index, sizeof(size_t));
+        memcpy(key + sizeof(size_t), &value, sizeof(T));
+
+        new_hash = hash_func(key, sizeof(key))
+    );
+
+    return new_hash;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+hash_t Stack<T, INLINE_CAPACITY, CHECKED>::count_stack_hash() const
+{
+    hash_t new_hash = 0;
+
+    ON_HASH
+    (
+        // fields are hashed one by one, padding bytes of struct are not stable
+        const size_t fields[] = {(size_t) data, size, capacity, min_capacity,
+                                 (size_t) hash_func, (size_t) data_hash};
+
+        new_hash = hash_func(fields, sizeof(fields))
+    );
+
+    return new_hash;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+int StackTemplateDump(FILE* fp, const void* stack, const char* func, const char* file, const int line)
+{
+    assert(stack);
+    assert(func);
+    assert(file);
+
+    const Stack<T, INLINE_CAPACITY, CHECKED>* stk = (const Stack<T, INLINE_CAPACITY, CHECKED>*) stack;
+
+    LOG_START_DUMP(func, file, line);
+
+    fprintf(fp, "Stack                > [%p]\n"
+                "size                 > %zu\n"
+                "capacity             > %zu\n"
+                "min capacity         > %zu\n"
+                "data place           > [%p] (%s)\n",
+                stk, stk->size, stk->capacity, stk->min_capacity, stk->data,
+                stk->is_inline() ? "inline" : "heap");
+
+    ON_CANARY
+    (
+        fprintf(fp, "STACK PREFIX CANARY  > %llX\n"
+                    "STACK POSTFIX CANARY > %llX\n",
+                    stk->stack_prefix, stk->stack_postfix)
+    );
+
+    ON_HASH
+    (
+        fprintf(fp, "HASH FUNCTION        > [%p]\n"
+                    "::::::EXPECTED HASH::::::\n"
+                    "STACK HASH           > %llX\n"
+                    "DATA HASH            > %llX\n"
+                    "::::::CURRENT HASH::::::\n"
+                    "STACK CURRENT        > %llX\n"
+                    "DATA CURRENT         > %llX\n",
+                    stk->hash_func, stk->stack_hash, stk->data_hash,
+                    stk->hash_func ? stk->count_stack_hash() : 0,
+                    stk->hash_func ? stk->count_data_hash()  : 0)
+    );
+
+    fprintf(fp, "ELEMENTS: \n\n");
+
+    for (size_t i = 0; stk->data != nullptr && i < stk->capacity; i++)
+    {
+        if (i == stk->size)
+            fprintf(fp, "clear elements\n");
+
+        fprintf(fp, "%c[%zu] > ", (i < stk->size) ? '*' : ' ', i);
+        PrintStackElem(fp, stk->data[i]);
+
+        if (CHECKED && i >= stk->size && IsStackElemPoisoned(stk->data[i]))
+            fprintf(fp, " (POISONED)");
+
+        fprintf(fp, "\n");
+    }
+
+    ON_CANARY
+    (
+        if (stk->data != nullptr)
+            fprintf(fp, "PREFIX DATA CANARY   > %llX\n"
+                        "POSTFIX DATA CANARY  > %llX\n",
+                        *stk->prefix_data_canary(), *stk->postfix_data_canary())
+    );
+
+    if (stk->verify() != OK)
+        PrintStackCondition(stk->status, stk->size, stk->capacity, stk->data);
+
+    LOG_END();
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename T, size_t INLINE_CAPACITY, bool CHECKED>
+int Stack<T, INLINE_CAPACITY, CHECKED>::dump(const char* func, const char* file, const int line) const
+{
+    return LogDump(StackTemplateDump<T, INLINE_CAPACITY, CHECKED>, this, func, file, line);
+}
+
+#undef CHECK_STACK
+
+#endif
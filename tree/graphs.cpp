@@ -1,11 +1,60 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <time.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "graphs.h"
 #include "common/logs.h"
+#include "common/trace.h"
 
 static size_t      IMG_CNT        = 1;
+static size_t      DOT_CNT        = 1;
 static const char* IMG_FOLDER_DIR = "img/";
+static const char* DOT_FILE       = "tmp";
+
+struct RenderJob
+{
+    char   dot_file[MAX_DOT_FILE_LEN];
+    char   img_name[MAX_IMG_FILE_LEN];
+    hash_t graph_key;
+
+    RenderJob* next;
+};
+
+struct RenderedGraph
+{
+    hash_t graph_key;
+    char   img_name[MAX_IMG_FILE_LEN];
+};
+
+struct RenderQueue
+{
+    std::mutex              lock;
+    std::condition_variable has_job;
+
+    RenderJob* head;
+    RenderJob* tail;
+    bool       stop;
+
+    std::thread workers[RENDER_WORKERS_AMT];
+    bool        started;
+
+    RenderedGraph rendered[RENDERED_GRAPHS_AMT];
+    size_t        rendered_amt;
+};
+
+static RenderQueue RENDER_QUEUE = {};
+
+static void StartRenderWorkers();
+static void StopRenderWorkers();
+static void RenderWorker();
+static void RenderImg(const RenderJob* job);
+static void RememberGraph(const hash_t graph_key, const char* img_name);
 
 //---------------------------------------------------------------------------------------
 
@@ -27,14 +76,173 @@ void StartGraph(FILE* dotf)
 
 //---------------------------------------------------------------------------------------
 
-void MakeImgFromDot(const char* dot_file)
+void GetDotFileName(char* dot_file, const size_t len)
+{
+    assert(dot_file);
+
+    std::lock_guard<std::mutex> guard(RENDER_QUEUE.lock);
+
+    snprintf(dot_file, len, "%s_%d_%zu.dot", DOT_FILE, getpid(), DOT_CNT++);
+}
+
+//---------------------------------------------------------------------------------------
+
+bool LogRenderedGraph(const hash_t graph_key)
 {
+    std::lock_guard<std::mutex> guard(RENDER_QUEUE.lock);
+
+    size_t amt = (RENDER_QUEUE.rendered_amt < RENDERED_GRAPHS_AMT) ?
+                  RENDER_QUEUE.rendered_amt : RENDERED_GRAPHS_AMT;
+
+    for (size_t i = 0; i < amt; i++)
+    {
+        if (RENDER_QUEUE.rendered[i].graph_key == graph_key)
+        {
+            PrintLog("<img src=\"%s\"><br>\n"
+                     "TREE NOT CHANGED, IMAGE REUSED<br>\n", RENDER_QUEUE.rendered[i].img_name);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+
+void MakeImgFromDot(const char* dot_file, const hash_t graph_key)
+{
+    assert(dot_file);
+
+    TRACE_SPAN("MakeImgFromDot");
+
+    RenderJob* job = (RenderJob*) calloc(1, sizeof(RenderJob));
+    if (job == nullptr)
+        return;
+
+    snprintf(job->dot_file, MAX_DOT_FILE_LEN, "%s", dot_file);
+    job->graph_key = graph_key;
+
     char img_name[MAX_IMG_FILE_LEN] = {};
-    snprintf(img_name, MAX_IMG_FILE_LEN, "%simg%lu_%lu.png", IMG_FOLDER_DIR, IMG_CNT++, clock());
+
+    {
+        std::lock_guard<std::mutex> guard(RENDER_QUEUE.lock);
+
+        snprintf(img_name, MAX_IMG_FILE_LEN, "%simg%zu_%d.png", IMG_FOLDER_DIR, IMG_CNT++, getpid());
+        snprintf(job->img_name, MAX_IMG_FILE_LEN, "%s", img_name);
+
+        RememberGraph(graph_key, job->img_name);
+
+        if (RENDER_QUEUE.tail == nullptr)
+            RENDER_QUEUE.head = job;
+        else
+            RENDER_QUEUE.tail->next = job;
+        RENDER_QUEUE.tail = job;
+
+        if (!RENDER_QUEUE.started)
+            StartRenderWorkers();
+    }
+
+    RENDER_QUEUE.has_job.notify_one();
+
+    // image appears in log as soon as worker finishes it
+    PrintLog("<img src=\"%s\" alt=\"rendering %s\"><br>\n", img_name, img_name);
+}
+
+//---------------------------------------------------------------------------------------
+
+static void RememberGraph(const hash_t graph_key, const char* img_name)
+{
+    assert(img_name);
+
+    RenderedGraph* graph = &RENDER_QUEUE.rendered[RENDER_QUEUE.rendered_amt++ % RENDERED_GRAPHS_AMT];
+
+    graph->graph_key = graph_key;
+    snprintf(graph->img_name, MAX_IMG_FILE_LEN, "%s", img_name);
+}
+
+//---------------------------------------------------------------------------------------
+
+static void StartRenderWorkers()
+{
+    for (size_t i = 0; i < RENDER_WORKERS_AMT; i++)
+        RENDER_QUEUE.workers[i] = std::thread(RenderWorker);
+
+    RENDER_QUEUE.started = true;
+
+    atexit(StopRenderWorkers);
+}
+
+//---------------------------------------------------------------------------------------
+
+static void StopRenderWorkers()
+{
+    {
+        std::lock_guard<std::mutex> guard(RENDER_QUEUE.lock);
+        RENDER_QUEUE.stop = true;
+    }
+
+    RENDER_QUEUE.has_job.notify_all();
+
+    for (size_t i = 0; i < RENDER_WORKERS_AMT; i++)
+    {
+        if (RENDER_QUEUE.workers[i].joinable())
+            RENDER_QUEUE.workers[i].join();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+static void RenderWorker()
+{
+    TraceThreadName("render worker");
+
+    while (true)
+    {
+        RenderJob* job = nullptr;
+
+        {
+            std::unique_lock<std::mutex> guard(RENDER_QUEUE.lock);
+
+            RENDER_QUEUE.has_job.wait(guard, []{ return RENDER_QUEUE.head != nullptr || RENDER_QUEUE.stop; });
+
+            // queue is drained before stopping, so no dump loses its image
+            if (RENDER_QUEUE.head == nullptr)
+                return;
+
+            job = RENDER_QUEUE.head;
+            RENDER_QUEUE.head = job->next;
+            if (RENDER_QUEUE.head == nullptr)
+                RENDER_QUEUE.tail = nullptr;
+        }
+
+        RenderImg(job);
+        free(job);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+
+static void RenderImg(const RenderJob* job)
+{
+    assert(job);
+
+    TRACE_SPAN("MakeImgFromDot render");
+
+    struct timespec start = {};
+    struct timespec end   = {};
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
     char dot_command[MAX_DOT_CMD_LEN] = {};
-    snprintf(dot_command, MAX_DOT_CMD_LEN, "dot %s -T png -o %s", dot_file, img_name);
-    system(dot_command);
+    snprintf(dot_command, MAX_DOT_CMD_LEN, "dot %s -T png -o %s", job->dot_file, job->img_name);
+    int status = system(dot_command);
+
+    remove(job->dot_file);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ms = (double) (end.tv_sec - start.tv_sec) * 1e3 + (double) (end.tv_nsec - start.tv_nsec) / 1e6;
 
-    PrintLog("<img src=\"%s\"><br>", img_name);
+    if (status == 0)
+        PrintLog("IMAGE \"%s\" READY (%.1lf ms)<br>\n", job->img_name, ms);
+    else
+        PrintLog("FAILED TO RENDER IMAGE \"%s\" (dot returned %d)<br>\n", job->img_name, status);
 }
@@ -3,13 +3,41 @@
 
 #include <stdio.h>
 
-static const size_t MAX_DOT_CMD_LEN  = 200;
-static const size_t MAX_IMG_FILE_LEN = 100;
-static const char*  DOT_FILE         = "tmp.dot";
+#include "types.h"
+
+static const size_t MAX_DOT_CMD_LEN     = 300;
+static const size_t MAX_IMG_FILE_LEN    = 100;
+static const size_t MAX_DOT_FILE_LEN    = 100;
+
+static const size_t RENDER_WORKERS_AMT  = 2;
+static const size_t RENDERED_GRAPHS_AMT = 64;
 
 void StartGraph(FILE* dotf);
 void EndGraph(FILE* dotf);
 
-void MakeImgFromDot(const char* dot_file);
+/************************************************************//**
+ * @brief Makes unique dot file name, so dumps never share one file
+ *
+ * @param[out] dot_file buffer for name
+ * @param[in] len buffer length
+ ************************************************************/
+void GetDotFileName(char* dot_file, const size_t len);
+
+/************************************************************//**
+ * @brief Logs image of graph if it was already rendered (or queued)
+ *
+ * @param[in] graph_key graph version hash
+ * @return true if image was logged and graph must not be drawn again
+ ************************************************************/
+bool LogRenderedGraph(const hash_t graph_key);
+
+/************************************************************//**
+ * @brief Queues rendering of dot file to render workers and logs image.
+ * Dot file is deleted by worker when image is ready
+ *
+ * @param[in] dot_file dot file name
+ * @param[in] graph_key graph version hash
+ ************************************************************/
+void MakeImgFromDot(const char* dot_file, const hash_t graph_key);
 
 #endif
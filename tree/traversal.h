@@ -0,0 +1,238 @@
+#ifndef __TRAVERSAL_H_
+#define __TRAVERSAL_H_
+
+#include "tree/tree.h"
+#include "stack/stack.h"
+
+// Non-recursive tree walk. Depth of tree is limited only by heap, not by call stack.
+//
+// Visitor is a struct derived from TreeVisitor<NodeT>. It redefines callbacks it needs and
+// turns them on with VISIT_* constants, so unused events cost nothing:
+//
+//     pre  (node, pos) - before children, may return TRAVERSE_SKIP or TRAVERSE_STOP
+//     in   (node, pos) - between left and right children  (VISIT_IN)
+//     post (node, pos) - after children                    (VISIT_POST)
+//     nil  (pos)       - instead of missing child          (VISIT_NIL)
+//
+// Print and destruction by engine cost as much as recursive ones (bench/walk_bench). Walk, that
+// does only a few instructions per node (hash of one byte), is still about 1.2 times slower than
+// recursion: a recursive walk of small tree, that runs in a loop, may stay recursive.
+
+enum TraverseAction
+{
+    TRAVERSE_CONTINUE = 0,
+    // children of node are not visited (and its in/post callbacks are not called)
+    TRAVERSE_SKIP     = 1,
+    // walk ends at once
+    TRAVERSE_STOP     = 2
+};
+
+struct TraversePos
+{
+    size_t depth;
+    bool   is_left;
+};
+
+template <typename NodeT>
+struct TreeVisitor
+{
+    static const bool VISIT_IN   = false;
+    static const bool VISIT_POST = false;
+    static const bool VISIT_NIL  = false;
+
+    TraverseAction pre (NodeT*, const TraversePos*) { return TRAVERSE_CONTINUE; }
+    TraverseAction in  (NodeT*, const TraversePos*) { return TRAVERSE_CONTINUE; }
+    TraverseAction post(NodeT*, const TraversePos*) { return TRAVERSE_CONTINUE; }
+    TraverseAction nil (const TraversePos*)         { return TRAVERSE_CONTINUE; }
+};
+
+enum TraverseEvent
+{
+    // left subtree is being walked, in and right subtree are next
+    EVENT_IN   = 0,
+    // right subtree is being walked, post is next
+    EVENT_POST = 1
+};
+
+template <typename NodeT>
+struct TraverseFrame
+{
+    NodeT*        node;
+    TraversePos   pos;
+    TraverseEvent event;
+};
+
+// frame of walk with pre only: only right children wait in stack, so they need only depth
+template <typename NodeT>
+struct PreOrderFrame
+{
+    NodeT* node;
+    size_t depth;
+};
+
+static const size_t TRAVERSE_INLINE_DEPTH = 64;
+
+//-----------------------------------------------------------------------------------------------------
+
+// the most common walk (search, hash, count): no frames for events, missing children are never pushed
+template <typename NodeT, typename Visitor>
+static inline TreeErrors TraversePreOrder(NodeT* root, Visitor* visitor)
+{
+    assert(visitor);
+
+    UncheckedStack<PreOrderFrame<NodeT>, TRAVERSE_INLINE_DEPTH> rights;
+    rights.init();
+
+    TreeErrors  error = TreeErrors::NONE;
+    NodeT*      node  = root;
+    TraversePos pos   = {0, false};
+
+    while (node != nullptr)
+    {
+        const TraverseAction action = visitor->pre(node, &pos);
+
+        if (action == TRAVERSE_STOP)
+            break;
+
+        NodeT* next = nullptr;
+
+        if (action == TRAVERSE_CONTINUE && node->left == nullptr)
+        {
+            // right child is the only one, it does not need to wait
+            next = node->right;
+            pos  = {pos.depth + 1, false};
+        }
+        else if (action == TRAVERSE_CONTINUE)
+        {
+            if (node->right != nullptr && rights.push({node->right, pos.depth + 1}) != (int) ERRORS::NONE)
+            {
+                error = TreeErrors::ALLOCATE_MEMORY;
+                break;
+            }
+
+            next = node->left;
+            pos  = {pos.depth + 1, true};
+        }
+
+        if (next == nullptr && rights.size > 0)
+        {
+            PreOrderFrame<NodeT> frame = {};
+            rights.pop(&frame);
+
+            next = frame.node;
+            pos  = {frame.depth, false};
+        }
+
+        node = next;
+    }
+
+    rights.destroy();
+
+    return error;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename NodeT, typename Visitor>
+TreeErrors TraverseNodes(NodeT* root, Visitor* visitor)
+{
+    assert(visitor);
+
+    if constexpr (!Visitor::VISIT_IN && !Visitor::VISIT_POST && !Visitor::VISIT_NIL)
+        return TraversePreOrder(root, visitor);
+
+    typedef TraverseFrame<NodeT> frame_t;
+
+    // only nodes with children wait in stack, once each: their in and post are called from top of stack
+    UncheckedStack<frame_t, TRAVERSE_INLINE_DEPTH> frames;
+    frames.init();
+
+    TreeErrors     error  = TreeErrors::NONE;
+    TraverseAction action = TRAVERSE_CONTINUE;
+
+    // node to enter next, left child is entered right after its parent
+    NodeT*      node     = root;
+    TraversePos pos      = {0, false};
+    bool        has_node = (root != nullptr || Visitor::VISIT_NIL);
+
+    while (action != TRAVERSE_STOP)
+    {
+        if (has_node)
+        {
+            has_node = false;
+
+            if (node == nullptr)
+            {
+                if constexpr (Visitor::VISIT_NIL)
+                    action = visitor->nil(&pos);
+
+                continue;
+            }
+
+            action = visitor->pre(node, &pos);
+            if (action != TRAVERSE_CONTINUE)
+                continue;
+
+            // leaf gets its in and post at once, half of nodes never go through the stack
+            if (node->left == nullptr && node->right == nullptr && !Visitor::VISIT_NIL)
+            {
+                if constexpr (Visitor::VISIT_IN)
+                    action = visitor->in(node, &pos);
+
+                if constexpr (Visitor::VISIT_POST)
+                    if (action != TRAVERSE_STOP)
+                        action = visitor->post(node, &pos);
+
+                continue;
+            }
+
+            if (frames.push({node, pos, EVENT_IN}) != (int) ERRORS::NONE)
+            {
+                error = TreeErrors::ALLOCATE_MEMORY;
+                break;
+            }
+
+            if (node->left != nullptr || Visitor::VISIT_NIL)
+            {
+                node     = node->left;
+                pos      = {pos.depth + 1, true};
+                has_node = true;
+            }
+
+            continue;
+        }
+
+        if (frames.size == 0)
+            break;
+
+        frame_t* top = &frames.data[frames.size - 1];
+
+        if (top->event == EVENT_IN)
+        {
+            if constexpr (Visitor::VISIT_IN)
+                action = visitor->in(top->node, &top->pos);
+
+            top->event = EVENT_POST;
+
+            if (top->node->right != nullptr || Visitor::VISIT_NIL)
+            {
+                node     = top->node->right;
+                pos      = {top->pos.depth + 1, false};
+                has_node = true;
+            }
+
+            continue;
+        }
+
+        if constexpr (Visitor::VISIT_POST)
+            action = visitor->post(top->node, &top->pos);
+
+        frames.pop();
+    }
+
+    frames.destroy();
+
+    return error;
+}
+
+#endif
@@ -1,12 +1,53 @@
 #include <assert.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdlib.h>
 
 #include "tree.h"
+#include "traversal.h"
 #include "graphs.h"
 #include "common/input_and_output.h"
+#include "stack/hash.h"
+#include "common/trace.h"
+#include "common/metrics.h"
+#include "common/memory.h"
+#include "common/tasks.h"
 
 static void DestructNodes(Node* root);
+static void DestructSharedNodes(Node* root);
+
+// ======== HASH-CONSING =========
+
+// set of nodes by hash, open addressing
+struct NodeTable
+{
+    Node** slots;
+    size_t capacity;
+};
+
+static TreeErrors NodeTableCtor(NodeTable* table, const size_t nodes_amt);
+static size_t     NodeTableFind(const NodeTable* table, const Node* node, const bool same_node);
+static Node*      ShareNode(NodeTable* table, Node* child, const Node* sibling);
+static size_t     CountUniqueNodes(Node* root);
+
+// ======== PARALLEL WALKS =========
+
+static size_t ParallelSplitDepth(const Node* root);
+static size_t SplitDepthForSize(const size_t nodes_amt);
+static size_t CountNodesUpTo(const Node* root, const size_t limit);
+
+template <typename Job>
+static void RunChildJobs(Job* left, Job* right, task_f task);
+
+static void DestructTask(void* arg);
+static void StatsTask(void* arg);
+static void MerkleTask(void* arg);
+static void PrintChunkTask(void* arg);
+
+static bool   NodesPrefixPrintChunked(FILE* fp, const Node* root, const size_t split_depth);
+static hash_t CountNodeHash(const Node* node);
+
+// =================================
 
 static void NodesPrefixPrint(FILE* fp, const Node* node);
 static void NodesPostfixPrint(FILE* fp, const Node* node);
@@ -27,6 +68,7 @@ static TreeErrors VerifyNodes(const Node* node, error_t* error);
 // ======== GRAPHS =========
 
 static void DrawTreeGraph(const tree_t* tree);
+static void UpdateNodesHash(HashState* state, const Node* node);
 
 static inline void DrawNodes(FILE* dotf, const Node* node, const int rank);
 
@@ -34,13 +76,47 @@ static inline void DrawNodes(FILE* dotf, const Node* node, const int rank);
 
 static const char* NIL = "nil";
 
+static const size_t HISTOGRAM_BAR_LEN = 40;
+
+// subtrees deeper than split_depth are walked by one thread
+struct DestructJob
+{
+    Node*  node;
+    size_t depth;
+    size_t split_depth;
+};
+
+struct StatsJob
+{
+    Node*  node;
+    size_t depth;
+    size_t split_depth;
+};
+
+struct MerkleJob
+{
+    Node*  node;
+    size_t depth;
+    size_t split_depth;
+};
+
+struct PrintChunk
+{
+    const Node* subtree;
+    // position of subtree text in text of top levels
+    size_t      offset;
+
+    char*  text;
+    size_t len;
+};
+
 //-----------------------------------------------------------------------------------------------------
 
 Node* NodeCtor(const node_data_t data, Node* left, Node* right, error_t* error)
 {
     assert(error);
 
-    Node* node = (Node*) calloc(1, sizeof(Node));
+    Node* node = (Node*) MemCalloc(MEM_NODES, 1, sizeof(Node));
     if (node == nullptr)
     {
         error->code = (int) TreeErrors::ALLOCATE_MEMORY;
@@ -51,6 +127,9 @@ Node* NodeCtor(const node_data_t data, Node* left, Node* right, error_t* error)
     node->data  = data;
     node->left  = left;
     node->right = right;
+    node->refs  = 1;
+
+    NodeUpdateStats(node);
 
     return node;
 }
@@ -61,17 +140,55 @@ void NodeDtor(Node* node)
 {
     assert(node);
 
-    free(node);
+    MemFree(node->data);
+    MemFree(node);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void NodeUpdateStats(Node* node)
+{
+    assert(node);
+
+    TreeStats* stats = &node->subtree;
+
+    if (node->left == nullptr && node->right == nullptr)
+    {
+        *stats = {1, 1, 1, 0, 0};
+        return;
+    }
+
+    *stats = {1, 0, 0, 0, 0};
+
+    const Node* children[2] = {node->left, node->right};
+
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (children[i] == nullptr)
+            continue;
+
+        const TreeStats* child = &children[i]->subtree;
+
+        // every node of child subtree is one level deeper in subtree of node
+        stats->nodes          += child->nodes;
+        stats->leaves         += child->leaves;
+        stats->depth_sum      += child->depth_sum + child->nodes;
+        stats->leaf_depth_sum += child->leaf_depth_sum + child->leaves;
+
+        if (stats->height < child->height + 1)
+            stats->height = child->height + 1;
+    }
 }
 
 //-----------------------------------------------------------------------------------------------------
 
 TreeErrors TreeCtor(tree_t* tree, error_t* error)
 {
-    Node* root = NodeCtor(ROOT_DATA, nullptr, nullptr, error);
+    Node* root = NodeCtor(MemStrdup(MEM_STRINGS, ROOT_DATA), nullptr, nullptr, error);
     RETURN_IF_TREE_ERROR((TreeErrors) error->code);
 
-    tree->root = root;
+    tree->root   = root;
+    tree->hashed = false;
 
     return TreeErrors::NONE;
 }
@@ -80,22 +197,60 @@ TreeErrors TreeCtor(tree_t* tree, error_t* error)
 
 void TreeDtor(tree_t* tree)
 {
-    DestructNodes(tree->root);
+    if (tree->root != nullptr && tree->shared)
+    {
+        DestructSharedNodes(tree->root);
+    }
+    else if (tree->root != nullptr)
+    {
+        DestructJob job = {tree->root, 0, ParallelSplitDepth(tree->root)};
+        DestructTask(&job);
+    }
 
-    tree->root = nullptr;
+    tree->root   = nullptr;
+    tree->shared = false;
+    tree->hashed = false;
 }
 
 //-----------------------------------------------------------------------------------------------------
 
+struct DestructVisitor : TreeVisitor<Node>
+{
+    static const bool VISIT_POST = true;
+
+    TraverseAction post(Node* node, const TraversePos*)
+    {
+        NodeDtor(node);
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
 static void DestructNodes(Node* root)
 {
-    if (root->left != nullptr)
-        DestructNodes(root->left);
+    DestructVisitor visitor = {};
+    TraverseNodes(root, &visitor);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+struct SharedDestructVisitor : DestructVisitor
+{
+    TraverseAction pre(Node* node, const TraversePos*)
+    {
+        // shared node is freed by its last parent
+        node->refs--;
+        return (node->refs == 0) ? TRAVERSE_CONTINUE : TRAVERSE_SKIP;
+    }
+};
 
-    if (root->right != nullptr)
-        DestructNodes(root->right);
+//-----------------------------------------------------------------------------------------------------
 
-    NodeDtor(root);
+static void DestructSharedNodes(Node* root)
+{
+    SharedDestructVisitor visitor = {};
+    TraverseNodes(root, &visitor);
 }
 
 //-----------------------------------------------------------------------------------------------------
@@ -156,7 +311,11 @@ void TreePrefixPrint(FILE* fp, const tree_t* tree)
 {
     assert(tree);
 
-    NodesPrefixPrint(fp, tree->root);
+    const size_t split_depth = ParallelSplitDepth(tree->root);
+
+    if (split_depth == 0 || !NodesPrefixPrintChunked(fp, tree->root, split_depth))
+        NodesPrefixPrint(fp, tree->root);
+
     fprintf(fp, "\n");
 }
 
@@ -182,45 +341,101 @@ void TreeInfixPrint(FILE* fp, const tree_t* tree)
 
 //-----------------------------------------------------------------------------------------------------
 
-static void NodesPrefixPrint(FILE* fp, const Node* node)
+struct PrintVisitor : TreeVisitor<const Node>
+{
+    static const bool VISIT_POST = true;
+    static const bool VISIT_NIL  = true;
+
+    FILE* fp = nullptr;
+
+    TraverseAction nil(const TraversePos*)
+    {
+        fprintf(fp, " %s ", NIL);
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+struct PrefixPrintVisitor : PrintVisitor
 {
-    if (!node) { fprintf(fp, " %s ", NIL); return; }
+    TraverseAction pre(const Node* node, const TraversePos*)
+    {
+        fprintf(fp, "\n(" PRINT_NODE "\n", node->data);
+        return TRAVERSE_CONTINUE;
+    }
 
-    fprintf(fp, "\n(" PRINT_NODE "\n", node->data);
+    TraverseAction post(const Node*, const TraversePos*)
+    {
+        fprintf(fp, ")");
+        return TRAVERSE_CONTINUE;
+    }
+};
 
-    NodesPrefixPrint(fp, node->left);
-    NodesPrefixPrint(fp, node->right);
+struct InfixPrintVisitor : PrintVisitor
+{
+    static const bool VISIT_IN = true;
 
-    fprintf(fp, ")");
-}
+    TraverseAction pre(const Node*, const TraversePos*)
+    {
+        fprintf(fp, "(");
+        return TRAVERSE_CONTINUE;
+    }
 
-//-----------------------------------------------------------------------------------------------------
+    TraverseAction in(const Node* node, const TraversePos*)
+    {
+        fprintf(fp, PRINT_NODE, node->data);
+        return TRAVERSE_CONTINUE;
+    }
 
-static void NodesInfixPrint(FILE* fp, const Node* node)
+    TraverseAction post(const Node*, const TraversePos*)
+    {
+        fprintf(fp, ")");
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+struct PostfixPrintVisitor : PrintVisitor
 {
-    if (!node) { fprintf(fp, " %s ", NIL); return; }
+    TraverseAction pre(const Node*, const TraversePos*)
+    {
+        fprintf(fp, "(");
+        return TRAVERSE_CONTINUE;
+    }
+
+    TraverseAction post(const Node* node, const TraversePos*)
+    {
+        fprintf(fp, PRINT_NODE ")", node->data);
+        return TRAVERSE_CONTINUE;
+    }
+};
 
-    fprintf(fp, "(");
+//-----------------------------------------------------------------------------------------------------
 
-    NodesInfixPrint(fp, node->left);
-    fprintf(fp, PRINT_NODE, node->data);
-    NodesInfixPrint(fp, node->right);
+static void NodesPrefixPrint(FILE* fp, const Node* node)
+{
+    PrefixPrintVisitor visitor = {};
+    visitor.fp = fp;
 
-    fprintf(fp, ")");
+    TraverseNodes(node, &visitor);
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-static void NodesPostfixPrint(FILE* fp, const Node* node)
+static void NodesInfixPrint(FILE* fp, const Node* node)
 {
-    if (!node) { fprintf(fp, " %s ", NIL); return; }
+    InfixPrintVisitor visitor = {};
+    visitor.fp = fp;
+
+    TraverseNodes(node, &visitor);
+}
 
-    fprintf(fp, "(");
+//-----------------------------------------------------------------------------------------------------
 
-    NodesPostfixPrint(fp, node->left);
-    NodesPostfixPrint(fp, node->right);
+static void NodesPostfixPrint(FILE* fp, const Node* node)
+{
+    PostfixPrintVisitor visitor = {};
+    visitor.fp = fp;
 
-    fprintf(fp, PRINT_NODE ")", node->data);
+    TraverseNodes(node, &visitor);
 }
 
 //-----------------------------------------------------------------------------------------------------
@@ -229,20 +444,25 @@ void TreePrefixRead(FILE* fp, tree_t* tree, error_t* error)
 {
     assert(tree);
 
+    TRACE_SPAN("TreePrefixRead");
+    METRIC_TIMER(PARSE_TIME);
+
     SkipSpaces(fp);
     int ch = getc(fp);
 
     Node* root = nullptr;
 
     if (ch == EOF)
-        root = NodeCtor("something unknown", 0, 0, error);
+        root = NodeCtor(MemStrdup(MEM_STRINGS, UNKNOWN_DATA), 0, 0, error);
     else
     {
         ungetc(ch, fp);
         root = NodesPrefixRead(fp, error);
     }
 
-    tree->root = root;
+    tree->root   = root;
+    tree->shared = false;
+    tree->hashed = false;
 }
 
 //-----------------------------------------------------------------------------------------------------
@@ -271,6 +491,9 @@ static Node* NodesPrefixRead(FILE* fp, error_t* error)
         char closing_bracket_check = getc(fp);
         if (closing_bracket_check != ')')
         {
+            // node is not linked to parent yet, so nobody else frees it and its read children
+            DestructNodes(new_node);
+
             error->code = (int) TreeErrors::INVALID_SYNTAX;
             return nullptr;
         }
@@ -298,15 +521,23 @@ static Node* NodesPrefixRead(FILE* fp, error_t* error)
 static Node* ReadNewNode(FILE* fp, error_t* error)
 {
     Node* node = NodeCtor(0, 0, 0, error);
+    if (node == nullptr)
+        return nullptr;
 
     node_data_t data = ReadNodeData(fp, error);
     if (error->code != (int) TreeErrors::NONE)
+    {
+        NodeDtor(node);
         return nullptr;
+    }
 
     node->data  = data;
     node->left  = NodesPrefixRead(fp, error);
     node->right = NodesPrefixRead(fp, error);
 
+    // children are read already, so stats go bottom-up without extra walk
+    NodeUpdateStats(node);
+
     SkipSpaces(fp);
 
     return node;
@@ -318,7 +549,7 @@ node_data_t ReadNodeData(FILE* fp, error_t* error)
 {
     assert(error);
 
-    node_data_t data = (node_data_t) calloc(MAX_STRING_LEN, sizeof(char));
+    node_data_t data = (node_data_t) MemCalloc(MEM_STRINGS, MAX_STRING_LEN, sizeof(char));
     if (data == nullptr)
     {
         error->code = (int) TreeErrors::ALLOCATE_MEMORY;
@@ -327,7 +558,10 @@ node_data_t ReadNodeData(FILE* fp, error_t* error)
 
     ReadTextInQuotes(fp, data, error);
     if (error->code != (int) TreeErrors::NONE)
+    {
+        MemFree(data);
         return nullptr;
+    }
 
     return data;
 }
@@ -345,7 +579,7 @@ TreeErrors NodeVerify(const Node* node, error_t* error)
         error->data = node;
         return TreeErrors::CYCLED_NODE;
     }
-    if (node->left == node->right)
+    if (node->left == node->right && node->left != nullptr)
     {
         error->code = (int) TreeErrors::COMMON_HEIR;
         error->data = node;
@@ -458,24 +692,32 @@ TreeErrors TreeVerify(const tree_t* tree, error_t* error)
 
 //-----------------------------------------------------------------------------------------------------
 
-static TreeErrors VerifyNodes(const Node* node, error_t* error)
+struct VerifyVisitor : TreeVisitor<const Node>
 {
-    assert(node);
-    assert(error);
+    error_t* error = nullptr;
 
-    if (node->left != nullptr)
+    TraverseAction pre(const Node* node, const TraversePos*)
     {
-        NodeVerify(node->left, error);
-        RETURN_IF_TREE_ERROR((TreeErrors) error->code);
-    }
+        if (NodeVerify(node, error) != TreeErrors::NONE)
+            return TRAVERSE_STOP;
 
-    if (node->right != nullptr)
-    {
-        NodeVerify(node->right, error);
-        RETURN_IF_TREE_ERROR((TreeErrors) error->code);
+        return TRAVERSE_CONTINUE;
     }
+};
 
-    NodeVerify(node, error);
+//-----------------------------------------------------------------------------------------------------
+
+static TreeErrors VerifyNodes(const Node* node, error_t* error)
+{
+    assert(node);
+    assert(error);
+
+    VerifyVisitor visitor = {};
+    visitor.error = error;
+
+    TreeErrors traverse_error = TraverseNodes(node, &visitor);
+    if (traverse_error != TreeErrors::NONE)
+        error->code = (int) traverse_error;
 
     return (TreeErrors) error->code;
 }
@@ -493,6 +735,10 @@ int TreeDump(FILE* fp, const void* nodes, const char* func, const char* file, co
     TextTreeDump(fp, tree);
     DrawTreeGraph(tree);
 
+    fprintf(fp, "<pre>");
+    PrintMemoryStats(fp);
+    fprintf(fp, "</pre>");
+
     LOG_END();
 
     return (int) TreeErrors::NONE;
@@ -512,6 +758,8 @@ static void TextTreeDump(FILE* fp, const tree_t* tree)
     TreePostfixPrint(fp, tree);
     TreeInfixPrint(fp, tree);
 
+    TreePrintDepthHistogram(fp, tree);
+
     fprintf(fp, "</pre>");
 }
 
@@ -521,7 +769,17 @@ static void DrawTreeGraph(const tree_t* tree)
 {
     assert(tree);
 
-    FILE* dotf = fopen(DOT_FILE, "w");
+    hash_t tree_hash = TreeHash(tree);
+
+    if (LogRenderedGraph(tree_hash))
+        return;
+
+    char dot_file[MAX_DOT_FILE_LEN] = {};
+    GetDotFileName(dot_file, MAX_DOT_FILE_LEN);
+
+    FILE* dotf = fopen(dot_file, "w");
+    if (dotf == nullptr)
+        return;
 
     StartGraph(dotf);
     DrawNodes(dotf, tree->root, 1);
@@ -529,29 +787,824 @@ static void DrawTreeGraph(const tree_t* tree)
 
     fclose(dotf);
 
-    MakeImgFromDot(DOT_FILE);
+    MakeImgFromDot(dot_file, tree_hash);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+hash_t TreeHash(const tree_t* tree)
+{
+    assert(tree);
+
+    HashState state = {};
+    HashStart(&state);
+
+    UpdateNodesHash(&state, tree->root);
+
+    return HashFinish(&state);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+struct HashVisitor : TreeVisitor<const Node>
+{
+    static const bool VISIT_NIL = true;
+
+    HashState* state = nullptr;
+
+    TraverseAction pre(const Node* node, const TraversePos*)
+    {
+        // terminator is hashed, so texts of neighbour nodes can not be glued together
+        HashUpdate(state, node->data, strlen(node->data) + 1);
+
+        return TRAVERSE_CONTINUE;
+    }
+
+    TraverseAction nil(const TraversePos*)
+    {
+        static const char NIL_MARK = 0;
+
+        HashUpdate(state, &NIL_MARK, sizeof(NIL_MARK));
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
+static void UpdateNodesHash(HashState* state, const Node* node)
+{
+    assert(state);
+
+    HashVisitor visitor = {};
+    visitor.state = state;
+
+    TraverseNodes(node, &visitor);
 }
 
 //:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::;::::::::::::::::::::::::::
 
+struct DrawVisitor : TreeVisitor<const Node>
+{
+    static const bool VISIT_POST = true;
+
+    FILE* dotf = nullptr;
+    int   rank = 0;
+
+    // nodes are named by prefix numbers, not addresses: same tree gives same picture,
+    // and nodes shared by TreeHashCons are drawn once for every parent
+    size_t                 next_id = 0;
+    UncheckedStack<size_t> ids     = {};
+
+    TraverseAction pre(const Node* node, const TraversePos* pos)
+    {
+        const size_t id = next_id++;
+
+        fprintf(dotf, "%zu [shape=Mrecord, style=filled, fillcolor=\"lightblue\", color = darkblue, rank = %d, label=\" "
+                      "{ node: %zu | data: %s }\"]\n",
+                      id, rank + (int) pos->depth, id, node->data);
+
+        if (pos->depth > 0)
+            fprintf(dotf, "%zu->%zu [fontcolor = black, label = \"%s\"]\n",
+                          ids.data[ids.size - 1], id, pos->is_left ? "yes" : "no");
+
+        if (ids.push(id) != (int) ERRORS::NONE)
+            return TRAVERSE_STOP;
+
+        return TRAVERSE_CONTINUE;
+    }
+
+    TraverseAction post(const Node*, const TraversePos*)
+    {
+        ids.pop();
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
 static inline void DrawNodes(FILE* dotf, const Node* node, const int rank)
 {
-    if (!node) return;
+    DrawVisitor visitor = {};
+    visitor.dotf = dotf;
+    visitor.rank = rank;
+    visitor.ids.init();
+
+    TraverseNodes(node, &visitor);
+
+    visitor.ids.destroy();
+}
+
+
+
+
+//:::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+static size_t ParallelSplitDepth(const Node* root)
+{
+    return (root != nullptr) ? SplitDepthForSize(root->subtree.nodes) : 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static size_t SplitDepthForSize(const size_t nodes_amt)
+{
+    const size_t threads_amt = TaskThreadsAmt();
+
+    if (threads_amt < 2 || nodes_amt < PARALLEL_TREE_MIN_NODES)
+        return 0;
+
+    // about 8 subtrees for every thread, so thieves have something to take when walks are uneven
+    size_t split_depth = 3;
+    for (size_t amt = 1; amt < threads_amt; amt *= 2)
+        split_depth++;
+
+    return split_depth;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+struct CountLimitVisitor : TreeVisitor<const Node>
+{
+    size_t amt   = 0;
+    size_t limit = 0;
+
+    TraverseAction pre(const Node*, const TraversePos*)
+    {
+        amt++;
+        return (amt < limit) ? TRAVERSE_CONTINUE : TRAVERSE_STOP;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
+// for trees, whose stats are not counted yet
+static size_t CountNodesUpTo(const Node* root, const size_t limit)
+{
+    CountLimitVisitor visitor = {};
+    visitor.limit = limit;
+
+    TraverseNodes(root, &visitor);
+
+    return visitor.amt;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+template <typename Job>
+static void RunChildJobs(Job* left, Job* right, task_f task)
+{
+    assert(left);
+    assert(right);
+
+    TaskGroup group = {};
+
+    // right subtree is walked by this thread, left one waits to be stolen
+    if (left->node != nullptr)
+        TaskSpawn(&group, task, left);
+
+    if (right->node != nullptr)
+        task(right);
+
+    TaskWait(&group);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void DestructTask(void* arg)
+{
+    assert(arg);
+
+    DestructJob* job = (DestructJob*) arg;
+
+    if (job->depth >= job->split_depth)
+    {
+        DestructNodes(job->node);
+        return;
+    }
+
+    DestructJob left  = {job->node->left,  job->depth + 1, job->split_depth};
+    DestructJob right = {job->node->right, job->depth + 1, job->split_depth};
+
+    NodeDtor(job->node);
+
+    RunChildJobs(&left, &right, DestructTask);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void TreeCountStats(const tree_t* tree, TreeStats* stats)
+{
+    assert(tree);
+    assert(stats);
+
+    TRACE_SPAN("TreeCountStats");
+
+    *stats = {};
 
-    fprintf(dotf, "%lld [shape=Mrecord, style=filled, fillcolor=\"lightblue\", color = darkblue, rank = %d, label=\" "
-                  "{ node: %p | data: %s | { left: %p| right: %p } }\"]\n",
-                  node, rank, node, node->data, node->left, node->right);
+    if (tree->root == nullptr)
+        return;
 
-    DrawNodes(dotf, node->left, rank + 1);
-    DrawNodes(dotf, node->right, rank + 1);
+    *stats = tree->root->subtree;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void TreeRecountStats(tree_t* tree)
+{
+    assert(tree);
 
-    if (node->left != nullptr)
-        fprintf(dotf, "%lld->%lld [fontcolor = black, label = \"yes\"]\n", node, node->left);
+    TRACE_SPAN("TreeRecountStats");
 
-    if (node->right != nullptr)
-        fprintf(dotf, "%lld->%lld [fontcolor = black, label = \"no\"]\n", node, node->right);
+    if (tree->root == nullptr)
+        return;
 
+    // shared subtree would be counted by two threads at once
+    const size_t split_depth = tree->shared ? 0 :
+                               SplitDepthForSize(CountNodesUpTo(tree->root, PARALLEL_TREE_MIN_NODES));
+
+    StatsJob job = {tree->root, 0, split_depth};
+    StatsTask(&job);
 }
 
+//-----------------------------------------------------------------------------------------------------
+
+struct StatsVisitor : TreeVisitor<Node>
+{
+    static const bool VISIT_POST = true;
+
+    TraverseAction post(Node* node, const TraversePos*)
+    {
+        NodeUpdateStats(node);
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
+static void StatsTask(void* arg)
+{
+    assert(arg);
+
+    StatsJob* job = (StatsJob*) arg;
+
+    if (job->depth >= job->split_depth)
+    {
+        StatsVisitor visitor = {};
+        TraverseNodes(job->node, &visitor);
+        return;
+    }
+
+    StatsJob left  = {job->node->left,  job->depth + 1, job->split_depth};
+    StatsJob right = {job->node->right, job->depth + 1, job->split_depth};
 
+    RunChildJobs(&left, &right, StatsTask);
+
+    NodeUpdateStats(job->node);
+}
 
+//-----------------------------------------------------------------------------------------------------
+
+void TreePrintStats(FILE* fp, tree_t* tree)
+{
+    assert(tree);
+
+    TreeStats stats = {};
+    TreeCountStats(tree, &stats);
+
+    const hash_t content_hash = TreeRootHash(tree);
+    const double avg_depth    = (stats.nodes == 0) ? 0 : (double) stats.depth_sum / (double) stats.nodes;
+    const double avg_game     = (stats.leaves == 0) ? 0 : (double) stats.leaf_depth_sum / (double) stats.leaves;
+
+    fprintf(fp, "============================ TREE ============================\n"
+                "nodes:         %zu\n"
+                "leaves:        %zu\n"
+                "height:        %zu\n"
+                "average depth: %.2lf\n"
+                "average game:  %.2lf questions\n"
+                "content hash:  %016llX\n",
+                stats.nodes, stats.leaves, stats.height, avg_depth, avg_game, content_hash);
+
+    if (tree->shared)
+    {
+        const size_t unique_nodes = CountUniqueNodes(tree->root);
+
+        fprintf(fp, "unique nodes:  %zu (dedup ratio %.2lf)\n",
+                unique_nodes, (unique_nodes == 0) ? 0 : (double) stats.nodes / (double) unique_nodes);
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+struct DepthHistogramVisitor : TreeVisitor<const Node>
+{
+    size_t* leaves_amt = nullptr;
+
+    TraverseAction pre(const Node* node, const TraversePos* pos)
+    {
+        if (node->left == nullptr && node->right == nullptr)
+            leaves_amt[pos->depth]++;
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
+void TreePrintDepthHistogram(FILE* fp, const tree_t* tree)
+{
+    assert(tree);
+
+    if (tree->root == nullptr)
+        return;
+
+    const TreeStats* stats = &tree->root->subtree;
+
+    DepthHistogramVisitor visitor = {};
+    visitor.leaves_amt = (size_t*) MemCalloc(MEM_INDEXES, stats->height, sizeof(size_t));
+    if (visitor.leaves_amt == nullptr)
+        return;
+
+    TraverseNodes(tree->root, &visitor);
+
+    size_t max_amt = 0;
+    for (size_t depth = 0; depth < stats->height; depth++)
+    {
+        if (max_amt < visitor.leaves_amt[depth])
+            max_amt = visitor.leaves_amt[depth];
+    }
+
+    fprintf(fp, "======================= OBJECTS BY DEPTH =====================\n");
+
+    for (size_t depth = 0; depth < stats->height; depth++)
+    {
+        if (visitor.leaves_amt[depth] == 0)
+            continue;
+
+        // bars are scaled to the most common depth, non-empty depth always gets one mark
+        const size_t bar_len = (visitor.leaves_amt[depth] * HISTOGRAM_BAR_LEN + max_amt - 1) / max_amt;
+
+        fprintf(fp, "%4zu | %8zu | ", depth, visitor.leaves_amt[depth]);
+
+        for (size_t i = 0; i < bar_len; i++)
+            putc('#', fp);
+
+        putc('\n', fp);
+    }
+
+    MemFree(visitor.leaves_amt);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+hash_t TreeMerkleHash(tree_t* tree)
+{
+    assert(tree);
+
+    TRACE_SPAN("TreeMerkleHash");
+
+    if (tree->root == nullptr)
+        return 0;
+
+    // shared subtree would be hashed by two threads at once
+    MerkleJob job = {tree->root, 0, tree->shared ? 0 : ParallelSplitDepth(tree->root)};
+    MerkleTask(&job);
+
+    tree->hashed = true;
+
+    return tree->root->hash;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+hash_t TreeRootHash(tree_t* tree)
+{
+    assert(tree);
+
+    if (tree->root == nullptr)
+        return 0;
+
+    return tree->hashed ? tree->root->hash : TreeMerkleHash(tree);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+struct MerkleVisitor : TreeVisitor<Node>
+{
+    static const bool VISIT_POST = true;
+
+    TraverseAction post(Node* node, const TraversePos*)
+    {
+        node->hash = CountNodeHash(node);
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
+static void MerkleTask(void* arg)
+{
+    assert(arg);
+
+    MerkleJob* job = (MerkleJob*) arg;
+
+    if (job->depth >= job->split_depth)
+    {
+        MerkleVisitor visitor = {};
+        TraverseNodes(job->node, &visitor);
+        return;
+    }
+
+    MerkleJob left  = {job->node->left,  job->depth + 1, job->split_depth};
+    MerkleJob right = {job->node->right, job->depth + 1, job->split_depth};
+
+    RunChildJobs(&left, &right, MerkleTask);
+
+    job->node->hash = CountNodeHash(job->node);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static hash_t CountNodeHash(const Node* node)
+{
+    assert(node);
+
+    // hashes of children instead of their texts: equal subtrees get equal hashes
+    const hash_t children[2] = {(node->left  != nullptr) ? node->left->hash  : 0,
+                                (node->right != nullptr) ? node->right->hash : 0};
+
+    HashState state = {};
+    HashStart(&state);
+
+    HashUpdate(&state, node->data, strlen(node->data) + 1);
+    HashUpdate(&state, children, sizeof(children));
+
+    return HashFinish(&state);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+struct TopLevelsPrintVisitor : PrefixPrintVisitor
+{
+    size_t      split_depth = 0;
+    PrintChunk* chunks      = nullptr;
+    size_t      chunks_amt  = 0;
+    size_t      capacity    = 0;
+    bool        failed      = false;
+
+    TraverseAction pre(const Node* node, const TraversePos* pos)
+    {
+        if (pos->depth < split_depth || (node->left == nullptr && node->right == nullptr))
+            return PrefixPrintVisitor::pre(node, pos);
+
+        if (chunks_amt == capacity)
+        {
+            size_t new_capacity = (capacity == 0) ? 64 : capacity * 2;
+
+            PrintChunk* new_chunks = (PrintChunk*) MemRealloc(MEM_TASKS, chunks, new_capacity * sizeof(PrintChunk));
+            if (new_chunks == nullptr)
+            {
+                failed = true;
+                return TRAVERSE_STOP;
+            }
+
+            chunks   = new_chunks;
+            capacity = new_capacity;
+        }
+
+        // subtree is printed by task later, text of top levels gets a gap here
+        chunks[chunks_amt++] = {node, (size_t) ftell(fp), nullptr, 0};
+
+        return TRAVERSE_SKIP;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool NodesPrefixPrintChunked(FILE* fp, const Node* root, const size_t split_depth)
+{
+    assert(root);
+
+    char*  top_text = nullptr;
+    size_t top_len  = 0;
+
+    FILE* top_fp = open_memstream(&top_text, &top_len);
+    if (top_fp == nullptr)
+        return false;
+
+    TopLevelsPrintVisitor visitor = {};
+    visitor.fp          = top_fp;
+    visitor.split_depth = split_depth;
+
+    TreeErrors error = TraverseNodes(root, &visitor);
+    fclose(top_fp);
+
+    const bool printed = (error == TreeErrors::NONE && !visitor.failed);
+
+    if (printed)
+    {
+        TaskGroup group = {};
+
+        for (size_t i = 0; i < visitor.chunks_amt; i++)
+            TaskSpawn(&group, PrintChunkTask, &visitor.chunks[i]);
+
+        TaskWait(&group);
+
+        // chunks are glued in order, so text is same as one-thread walk gives
+        size_t offset = 0;
+
+        for (size_t i = 0; i < visitor.chunks_amt; i++)
+        {
+            PrintChunk* chunk = &visitor.chunks[i];
+
+            fwrite(top_text + offset, sizeof(char), chunk->offset - offset, fp);
+            offset = chunk->offset;
+
+            if (chunk->text != nullptr)
+                fwrite(chunk->text, sizeof(char), chunk->len, fp);
+            else
+                NodesPrefixPrint(fp, chunk->subtree);
+
+            free(chunk->text);
+        }
+
+        fwrite(top_text + offset, sizeof(char), top_len - offset, fp);
+    }
+
+    free(top_text);
+    MemFree(visitor.chunks);
+
+    return printed;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PrintChunkTask(void* arg)
+{
+    assert(arg);
+
+    TRACE_SPAN("TreePrefixPrint chunk");
+
+    PrintChunk* chunk = (PrintChunk*) arg;
+
+    FILE* chunk_fp = open_memstream(&chunk->text, &chunk->len);
+    if (chunk_fp == nullptr)
+        return;
+
+    NodesPrefixPrint(chunk_fp, chunk->subtree);
+
+    fclose(chunk_fp);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+struct HashConsVisitor : TreeVisitor<Node>
+{
+    static const bool VISIT_POST = true;
+
+    NodeTable* table = nullptr;
+
+    TraverseAction post(Node* node, const TraversePos*)
+    {
+        // children are walked before node, so their subtrees are shared already
+        node->left  = ShareNode(table, node->left,  nullptr);
+        node->right = ShareNode(table, node->right, node->left);
+
+        node->hash = CountNodeHash(node);
+
+        const size_t slot = NodeTableFind(table, node, false);
+        if (table->slots[slot] == nullptr)
+            table->slots[slot] = node;
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
+TreeErrors TreeHashCons(tree_t* tree, HashConsStats* stats, error_t* error)
+{
+    assert(tree);
+    assert(stats);
+    assert(error);
+
+    TRACE_SPAN("TreeHashCons");
+
+    *stats = {};
+
+    if (tree->root == nullptr)
+        return TreeErrors::NONE;
+
+    stats->nodes = tree->root->subtree.nodes;
+
+    NodeTable table = {};
+
+    if (NodeTableCtor(&table, stats->nodes) != TreeErrors::NONE)
+    {
+        error->code = (int) TreeErrors::ALLOCATE_MEMORY;
+        return TreeErrors::ALLOCATE_MEMORY;
+    }
+
+    HashConsVisitor visitor = {};
+    visitor.table = &table;
+
+    // nodes are freed while walk is in progress, so it is done by one thread
+    if (TraverseNodes(tree->root, &visitor) != TreeErrors::NONE)
+        error->code = (int) TreeErrors::ALLOCATE_MEMORY;
+
+    MemFree(table.slots);
+
+    // some subtrees may be shared already, even if walk has failed
+    tree->shared = true;
+
+    RETURN_IF_TREE_ERROR((TreeErrors) error->code);
+
+    stats->unique_nodes = CountUniqueNodes(tree->root);
+
+    // every node was hashed by walk
+    tree->hashed = true;
+
+    return TreeErrors::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+TreeErrors TreeUnsharePath(tree_t* tree, Node** ancestors, const size_t ancestors_amt, Node** node,
+                           error_t* error)
+{
+    assert(tree);
+    assert(node);
+    assert(*node);
+    assert(error);
+
+    if (!tree->shared)
+        return TreeErrors::NONE;
+
+    // nodes from root to node, root is never shared
+    size_t first_shared = ancestors_amt + 1;
+
+    for (size_t i = 0; i <= ancestors_amt && first_shared > ancestors_amt; i++)
+    {
+        const Node* path_node = (i < ancestors_amt) ? ancestors[i] : *node;
+
+        if (path_node->refs > 1)
+            first_shared = i;
+    }
+
+    if (first_shared > ancestors_amt)
+        return TreeErrors::NONE;
+
+    assert(first_shared > 0);
+
+    Node* parent = ancestors[first_shared - 1];
+
+    for (size_t i = first_shared; i <= ancestors_amt; i++)
+    {
+        Node** path_node = (i < ancestors_amt) ? &ancestors[i] : node;
+        Node*  old_node  = *path_node;
+
+        char* data = MemStrdup(MEM_STRINGS, old_node->data);
+        if (data == nullptr)
+        {
+            error->code = (int) TreeErrors::ALLOCATE_MEMORY;
+            return TreeErrors::ALLOCATE_MEMORY;
+        }
+
+        Node* copy = NodeCtor(data, old_node->left, old_node->right, error);
+        if (copy == nullptr)
+        {
+            MemFree(data);
+            return TreeErrors::ALLOCATE_MEMORY;
+        }
+
+        copy->hash = old_node->hash;
+
+        // children are shared by old node and its copy, until next copy takes place of one of them
+        if (copy->left  != nullptr) copy->left->refs++;
+        if (copy->right != nullptr) copy->right->refs++;
+
+        if (parent->left == old_node)
+            parent->left  = copy;
+        else
+            parent->right = copy;
+
+        old_node->refs--;
+
+        *path_node = copy;
+        parent     = copy;
+    }
+
+    return TreeErrors::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static TreeErrors NodeTableCtor(NodeTable* table, const size_t nodes_amt)
+{
+    assert(table);
+
+    // table is at most half full
+    size_t capacity = 1;
+    while (capacity < 2 * nodes_amt)
+        capacity *= 2;
+
+    table->slots    = (Node**) MemCalloc(MEM_TASKS, capacity, sizeof(Node*));
+    table->capacity = capacity;
+
+    return (table->slots != nullptr) ? TreeErrors::NONE : TreeErrors::ALLOCATE_MEMORY;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+// slot of node equal to this one (or of this very node, if same_node), or free slot for it
+static size_t NodeTableFind(const NodeTable* table, const Node* node, const bool same_node)
+{
+    assert(table);
+    assert(node);
+
+    size_t slot = node->hash & (table->capacity - 1);
+
+    while (table->slots[slot] != nullptr)
+    {
+        const Node* other = table->slots[slot];
+
+        if (same_node ? other == node :
+            other->hash == node->hash && other->left == node->left && other->right == node->right &&
+            !strcmp(other->data, node->data))
+            break;
+
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+
+    return slot;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+// node, that takes place of child: equal node from table (child is freed then) or child itself
+static Node* ShareNode(NodeTable* table, Node* child, const Node* sibling)
+{
+    assert(table);
+
+    if (child == nullptr)
+        return nullptr;
+
+    Node* equal = table->slots[NodeTableFind(table, child, false)];
+
+    // equal children of one node stay two nodes
+    if (equal == nullptr || equal == child || equal == sibling)
+        return child;
+
+    equal->refs++;
+
+    // children of child are the same nodes as children of equal one
+    if (child->left  != nullptr) child->left->refs--;
+    if (child->right != nullptr) child->right->refs--;
+
+    NodeDtor(child);
+
+    return equal;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+struct UniqueNodesVisitor : TreeVisitor<Node>
+{
+    NodeTable* table = nullptr;
+    size_t     amt   = 0;
+
+    TraverseAction pre(Node* node, const TraversePos*)
+    {
+        const size_t slot = NodeTableFind(table, node, true);
+
+        if (table->slots[slot] != nullptr)
+            return TRAVERSE_SKIP;
+
+        table->slots[slot] = node;
+        amt++;
+
+        return TRAVERSE_CONTINUE;
+    }
+};
+
+//-----------------------------------------------------------------------------------------------------
+
+// nodes in memory: shared ones are counted once (0 if memory is over)
+static size_t CountUniqueNodes(Node* root)
+{
+    if (root == nullptr)
+        return 0;
+
+    NodeTable table = {};
+
+    if (NodeTableCtor(&table, root->subtree.nodes) != TreeErrors::NONE)
+        return 0;
+
+    UniqueNodesVisitor visitor = {};
+    visitor.table = &table;
+
+    TraverseNodes(root, &visitor);
+
+    MemFree(table.slots);
+
+    return visitor.amt;
+}
@@ -11,7 +11,23 @@ typedef char* node_data_t;
 #endif
 #define PRINT_NODE "\"%s\""
 
-static const node_data_t ROOT_DATA = "unknown";
+static const char* const ROOT_DATA    = "unknown";
+static const char* const UNKNOWN_DATA = "something unknown";
+
+// identical subtrees of tree are shared after every reading, if this variable is set (and is not "0")
+static const char* const HASH_CONS_ENV_VAR = "AKINATOR_HASH_CONS";
+
+struct TreeStats
+{
+    size_t nodes;
+    size_t leaves;
+    // amount of levels (0 for empty tree)
+    size_t height;
+    // sum of node depths (root depth is 0)
+    size_t depth_sum;
+    // sum of leaf depths: questions asked before every guess
+    size_t leaf_depth_sum;
+};
 
 struct Node
 {
@@ -19,14 +35,31 @@ struct Node
 
     Node* left;
     Node* right;
+
+    // hash of node text and hashes of its children (counted by TreeMerkleHash)
+    hash_t hash;
+
+    // stats of subtree of node, depths are counted from node (kept by NodeUpdateStats)
+    TreeStats subtree;
+
+    // parents of node, more than one only for subtrees shared by TreeHashCons
+    size_t refs;
 };
 
 struct Tree
 {
     Node* root;
+    // tree is DAG after TreeHashCons: shared nodes are freed by the last parent, and subtrees are
+    // changed only by one thread
+    bool  shared;
+    // merkle hashes of nodes match their texts: set by TreeMerkleHash, cleared when nodes are changed
+    bool  hashed;
 };
 typedef struct Tree tree_t;
 
+// trees with less nodes are walked by one thread: splitting them costs more than it gives
+static const size_t PARALLEL_TREE_MIN_NODES = 1 << 15;
+
 enum class TreeErrors
 {
     NONE = 0,
@@ -65,6 +98,9 @@ int PrintTreeError(FILE* fp, const void* err, const char* func, const char* file
 
 Node* NodeCtor(const node_data_t data, Node* left, Node* right, error_t* error);
 void  NodeDtor(Node* node);
+// counts subtree stats of node from stats of its children, so after node is changed it must be
+// called for node and all its ancestors bottom-up
+void  NodeUpdateStats(Node* node);
 int   NodeDump(FILE* fp, const void* dumping_node, const char* func, const char* file, const int line);
 
 #ifdef DUMP_NODE
@@ -72,7 +108,7 @@ int   NodeDump(FILE* fp, const void* dumping_node, const char* func, const char*
 #endif
 #define DUMP_NODE(node)     do                                                              \
                             {                                                               \
-                                LogDump(NodeDump, (node), __func__, __FILE__, __LINE__);    \
+                                ON_DUMP_LOGS(LogDump(NodeDump, (node), __func__, __FILE__, __LINE__));  \
                             } while(0)
 
 TreeErrors NodeVerify(const Node* node, error_t* error);
@@ -96,13 +132,41 @@ void       TreePostfixPrint(FILE* fp, const tree_t* tree);
 void       TreeInfixPrint(FILE* fp, const tree_t* tree);
 void       TreePrefixRead(FILE* fp, tree_t* tree, error_t* error);
 int        TreeDump(FILE* fp, const void* nodes, const char* func, const char* file, const int line);
+// hash of texts and shape only, so tree read again from the same file has the same hash
+hash_t     TreeHash(const tree_t* tree);
+hash_t     TreeMerkleHash(tree_t* tree);
+// merkle hash of root, nodes are hashed again only if tree is not hashed yet
+hash_t     TreeRootHash(tree_t* tree);
+// O(1): stats are kept in root
+void       TreeCountStats(const tree_t* tree, TreeStats* stats);
+// counts subtree stats of every node again (for trees built top-down)
+void       TreeRecountStats(tree_t* tree);
+void       TreePrintStats(FILE* fp, tree_t* tree);
+// amount of objects (leaves) on every depth
+void       TreePrintDepthHistogram(FILE* fp, const tree_t* tree);
+
+struct HashConsStats
+{
+    // nodes of tree (shared ones are counted for every place) and nodes in memory
+    size_t nodes;
+    size_t unique_nodes;
+};
+
+// Hash-consing: subtrees are compared bottom-up by merkle hash, text and already shared children, and
+// equal ones become one node. Node never gets one node as both children (NodeVerify forbids it).
+// Merkle hash of tree is counted too. Walks of tree see the same nodes in the same order
+TreeErrors TreeHashCons(tree_t* tree, HashConsStats* stats, error_t* error);
+// copy on write: node and its ancestors (root first) get own copies from the highest shared one,
+// so change of node is seen only in this place of tree. Pointers in ancestors and node are replaced
+TreeErrors TreeUnsharePath(tree_t* tree, Node** ancestors, const size_t ancestors_amt, Node** node,
+                           error_t* error);
 
 #ifdef DUMP_TREE
 #undef DUMP_TREE
 #endif
 #define DUMP_TREE(tree)  do                                                                 \
                             {                                                               \
-                                LogDump(TreeDump, (tree), __func__, __FILE__, __LINE__);    \
+                                ON_DUMP_LOGS(LogDump(TreeDump, (tree), __func__, __FILE__, __LINE__));  \
                             } while(0)
 
 TreeErrors TreeVerify(const tree_t* tree, error_t* error);
@@ -7,11 +7,9 @@
 
 /// stack element type
 typedef long long elem_t;
-/// stack type
-typedef struct Stack Stack_t;
 
 /// hash type
-typedef unsigned int hash_t;
+typedef long long unsigned int hash_t;
 /// hash function type
 typedef hash_t (*hash_f) (const void* obj, size_t size);
 /// canary type